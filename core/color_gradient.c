@@ -89,12 +89,14 @@ void de_color_gradient_add_point(de_color_gradient_t* gradient, float location,
 	const de_color_gradient_point_t point = { .location = location, .color = *color };
 	DE_ARRAY_APPEND(gradient->points, point);
 	DE_ARRAY_QSORT(gradient->points, de_color_gradient_point_sort);
+	++gradient->revision;
 }
 
 void de_color_gradient_clear(de_color_gradient_t* gradient)
 {
 	DE_ASSERT(gradient);
 	DE_ARRAY_CLEAR(gradient->points);
+	++gradient->revision;
 }
 
 void de_color_gradient_free(de_color_gradient_t* gradient)
@@ -119,6 +121,9 @@ bool de_color_gradient_visit(de_object_visitor_t* visitor, de_color_gradient_t*
 {
 	bool result = true;
 	result &= DE_OBJECT_VISITOR_VISIT_ARRAY(visitor, "Points", gradient->points, de_color_gradient_point_visit);
+	if (visitor->is_reading) {
+		++gradient->revision;
+	}
 	return result;
 }
 
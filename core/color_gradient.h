@@ -29,6 +29,7 @@ typedef struct de_color_gradient_point_t {
 */
 typedef struct de_color_gradient_t {
 	DE_ARRAY_DECLARE(de_color_gradient_point_t, points);
+	uint32_t revision; /**< Incremented on each modification, can be used to invalidate values precomputed from gradient. */
 } de_color_gradient_t;
 
 void de_color_gradient_init(de_color_gradient_t* gradient);
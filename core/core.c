@@ -24,6 +24,7 @@ struct de_core_t {
 	de_renderer_t* renderer;
 	de_sound_context_t* sound_context;
 	de_gui_t* gui;
+	de_thread_pool_t* thread_pool;
 	DE_LINKED_LIST_DECLARE(de_scene_t, scenes);
 	DE_LINKED_LIST_DECLARE(de_font_t, fonts);
 	de_core_config_t params;
@@ -118,6 +119,10 @@ de_core_t* de_core_init(const de_core_config_t* params)
 	de_core_platform_init(core);
 	de_log("platform initialized in %f seconds", de_time_get_seconds() - last_time);
 	
+	/* calling thread participates in parallel work too, so leave one hardware thread for it */
+	core->thread_pool = de_thread_pool_create(de_get_hardware_thread_count() - 1);
+	de_log("thread pool initialized with %d worker threads", (int)de_thread_pool_get_worker_count(core->thread_pool));
+
 	last_time = de_time_get_seconds();
 	core->sound_context = de_sound_context_create(core);
 	de_log("sound context initialized in %f seconds", de_time_get_seconds() - last_time);
@@ -149,6 +154,7 @@ void de_core_shutdown(de_core_t* core)
 	DE_ARRAY_FREE(core->resources);
 	DE_ARRAY_FREE(core->events_queue);
 	de_renderer_free(core->renderer);
+	de_thread_pool_free(core->thread_pool);
 	de_core_platform_shutdown(core);
 	de_free(core);
 	de_log("Engine shutdown successful!");
@@ -190,6 +196,11 @@ de_renderer_t* de_core_get_renderer(de_core_t* core)
 	return core->renderer;
 }
 
+de_thread_pool_t* de_core_get_thread_pool(de_core_t* core)
+{
+	return core->thread_pool;
+}
+
 de_gui_t* de_core_get_gui(de_core_t* core)
 {
 	return core->gui;
@@ -78,6 +78,12 @@ void* de_core_get_user_pointer(de_core_t* core);
 
 void de_core_set_user_pointer(de_core_t* core, void* ptr);
 
+/**
+ * @brief Returns pool of worker threads of the core. Engine uses it for parallel
+ * work (i.e. animation), but you can use it for your own tasks too.
+ */
+de_thread_pool_t* de_core_get_thread_pool(de_core_t* core);
+
 /**
  * @brief Returns current gui subsystem of the core.
  */
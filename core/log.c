@@ -31,14 +31,18 @@ void de_log_open(const char* filename)
 static void de_write_log(const char* message, bool error)
 {
 	time_t rawtime;
-	struct tm* timeinfo;
+	struct tm timeinfo;
 
-	/* Get time stamp */
+	/* Get time stamp, reentrant version is used because log is written from worker threads */
 	time(&rawtime);
-	timeinfo = localtime(&rawtime);
+#ifdef _MSC_VER
+	localtime_s(&timeinfo, &rawtime);
+#else
+	localtime_r(&rawtime, &timeinfo);
+#endif
 
 	if (de_log_file) {
-		fprintf(de_log_file, "[%dh:%dm:%ds] %s\n", timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec, message);
+		fprintf(de_log_file, "[%dh:%dm:%ds] %s\n", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec, message);
 		fflush(de_log_file);
 	}
 
@@ -51,24 +55,44 @@ static void de_write_log(const char* message, bool error)
 	}
 }
 
+/**
+ * @brief Formats message and writes it to log. Buffer is on stack, so log can be written from
+ * worker threads, longer messages (shader compilation logs for example) are formatted on heap.
+ * Plain malloc is used, de_malloc reports failures through log.
+ */
+static void de_write_log_v(const char* message, va_list argument_list, bool error)
+{
+	char format_buffer[4096];
+	va_list argument_list_copy;
+	va_copy(argument_list_copy, argument_list);
+	const int length = vsnprintf(format_buffer, sizeof(format_buffer), message, argument_list_copy);
+	va_end(argument_list_copy);
+	if (length >= (int)sizeof(format_buffer)) {
+		char* long_buffer = malloc((size_t)length + 1);
+		if (long_buffer) {
+			vsnprintf(long_buffer, (size_t)length + 1, message, argument_list);
+			de_write_log(long_buffer, error);
+			free(long_buffer);
+			return;
+		}
+	}
+	de_write_log(format_buffer, error);
+}
+
 void de_log(const char* message, ...)
 {
-	static char format_buffer[32768];
 	va_list argument_list;
 	va_start(argument_list, message);
-	vsprintf(format_buffer, message, argument_list);
+	de_write_log_v(message, argument_list, false);
 	va_end(argument_list);
-	de_write_log(format_buffer, false);
 }
 
 void de_fatal_error(const char* message, ...)
 {
-	static char format_buffer[32768];
 	va_list argument_list;
 	va_start(argument_list, message);
-	vsprintf(format_buffer, message, argument_list);
+	de_write_log_v(message, argument_list, true);
 	va_end(argument_list);
-	de_write_log(format_buffer, true);
 #ifdef _MSC_VER
 	__debugbreak();
 #else
@@ -19,7 +19,16 @@
 * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
-static int de_alloc_count;
+/* Counter is modified atomically, so memory can be allocated from any thread. */
+static volatile long de_alloc_count;
+
+#ifdef _MSC_VER
+#  define DE_ALLOC_COUNT_INC() _InterlockedIncrement(&de_alloc_count)
+#  define DE_ALLOC_COUNT_DEC() _InterlockedDecrement(&de_alloc_count)
+#else
+#  define DE_ALLOC_COUNT_INC() __sync_add_and_fetch(&de_alloc_count, 1)
+#  define DE_ALLOC_COUNT_DEC() __sync_sub_and_fetch(&de_alloc_count, 1)
+#endif
 
 void* de_malloc(size_t size)
 {
@@ -31,7 +40,7 @@ void* de_malloc(size_t size)
 		de_fatal_error("Failed to allocate %d bytes of memory!", size);
 	}
 
-	++de_alloc_count;
+	DE_ALLOC_COUNT_INC();
 
 	return mem;
 }
@@ -46,7 +55,7 @@ void* de_calloc(size_t count, size_t size)
 		de_fatal_error("Failed to allocate %d bytes of clean memory!", count * size);
 	}
 
-	++de_alloc_count;
+	DE_ALLOC_COUNT_INC();
 
 	return mem;
 }
@@ -56,7 +65,7 @@ void* de_realloc(void* ptr, size_t size)
 	void* mem;
 
 	if (ptr == NULL && size > 0) {
-		++de_alloc_count;
+		DE_ALLOC_COUNT_INC();
 	}
 
 	mem = realloc(ptr, size);
@@ -66,7 +75,7 @@ void* de_realloc(void* ptr, size_t size)
 			de_fatal_error("Failed to reallocate %d bytes of memory!", size);
 		}
 	} else {
-		--de_alloc_count;
+		DE_ALLOC_COUNT_DEC();
 	}
 
 	return mem;
@@ -75,14 +84,14 @@ void* de_realloc(void* ptr, size_t size)
 void de_free(void* ptr)
 {
 	if (ptr) {
-		--de_alloc_count;
+		DE_ALLOC_COUNT_DEC();
 	}
 	free(ptr);
 }
 
 size_t de_get_alloc_count()
 {
-	return de_alloc_count;
+	return (size_t)de_alloc_count;
 }
 
 void de_zero(void* data, size_t size)
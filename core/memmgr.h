@@ -19,6 +19,11 @@
 * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
+/**
+ * Thin wrappers over standard allocation functions which keep track of active allocations.
+ * Every function is thread-safe.
+ */
+
 /**
  * @brief Allocates raw memory. On failure raises error
  * @param size requested size
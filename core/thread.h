@@ -59,6 +59,11 @@ typedef int(*de_thrd_start_t)(void*);
  */
 void de_sleep(int milliseconds);
 
+/**
+ * @brief Returns amount of hardware threads (logical processors) available in system.
+ */
+size_t de_get_hardware_thread_count(void);
+
 /**
  * @brief Creates new suspended thread.
  */
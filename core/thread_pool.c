@@ -0,0 +1,152 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+struct de_thread_pool_t {
+	DE_ARRAY_DECLARE(de_thrd_t, threads);
+	de_mtx_t mutex;
+	de_cnd_t work_cnd;  /**< Signalled when new work is submitted or pool is shutting down */
+	de_cnd_t done_cnd;  /**< Signalled when every index of current work is processed */
+	de_thread_pool_task_t task;
+	void* arg;
+	size_t count;       /**< Total amount of indices of current work */
+	size_t next;        /**< First index which is not taken by any thread */
+	size_t finished;    /**< Amount of processed indices */
+	size_t chunk_size;
+	uint32_t generation; /**< Incremented each time new work is submitted */
+	bool shutdown;
+};
+
+/**
+ * @brief Takes chunks of current work until nothing left. Mutex must be locked on entry,
+ * will be locked on exit.
+ */
+static void de_thread_pool_process(de_thread_pool_t* pool)
+{
+	while (pool->next < pool->count) {
+		const size_t begin = pool->next;
+		const size_t end = begin + pool->chunk_size < pool->count ? begin + pool->chunk_size : pool->count;
+		de_thread_pool_task_t task = pool->task;
+		void* arg = pool->arg;
+
+		pool->next = end;
+
+		de_mtx_unlock(&pool->mutex);
+		for (size_t i = begin; i < end; ++i) {
+			task(arg, i);
+		}
+		de_mtx_lock(&pool->mutex);
+
+		pool->finished += end - begin;
+		if (pool->finished == pool->count) {
+			de_cnd_broadcast(&pool->done_cnd);
+		}
+	}
+}
+
+static int de_thread_pool_worker(void* arg)
+{
+	de_thread_pool_t* pool = (de_thread_pool_t*)arg;
+	uint32_t generation = 0;
+
+	de_mtx_lock(&pool->mutex);
+	for (;;) {
+		while (!pool->shutdown && pool->generation == generation) {
+			de_cnd_wait(&pool->work_cnd, &pool->mutex);
+		}
+		if (pool->shutdown) {
+			break;
+		}
+		generation = pool->generation;
+		de_thread_pool_process(pool);
+	}
+	de_mtx_unlock(&pool->mutex);
+
+	return 0;
+}
+
+de_thread_pool_t* de_thread_pool_create(size_t worker_count)
+{
+	de_thread_pool_t* pool = DE_NEW(de_thread_pool_t);
+	de_mtx_init(&pool->mutex);
+	de_cnd_init(&pool->work_cnd);
+	de_cnd_init(&pool->done_cnd);
+	DE_ARRAY_GROW(pool->threads, worker_count);
+	for (size_t i = 0; i < worker_count; ++i) {
+		de_thrd_create(&pool->threads.data[i], de_thread_pool_worker, pool);
+	}
+	return pool;
+}
+
+void de_thread_pool_free(de_thread_pool_t* pool)
+{
+	DE_ASSERT(pool);
+	de_mtx_lock(&pool->mutex);
+	pool->shutdown = true;
+	de_cnd_broadcast(&pool->work_cnd);
+	de_mtx_unlock(&pool->mutex);
+	for (size_t i = 0; i < pool->threads.size; ++i) {
+		de_thrd_join(&pool->threads.data[i]);
+	}
+	DE_ARRAY_FREE(pool->threads);
+	de_cnd_destroy(&pool->done_cnd);
+	de_cnd_destroy(&pool->work_cnd);
+	de_mtx_destroy(&pool->mutex);
+	de_free(pool);
+}
+
+void de_thread_pool_parallel_for(de_thread_pool_t* pool, size_t count, de_thread_pool_task_t task, void* arg)
+{
+	DE_ASSERT(task);
+
+	if (!pool || !pool->threads.size || count < 2) {
+		for (size_t i = 0; i < count; ++i) {
+			task(arg, i);
+		}
+		return;
+	}
+
+	de_mtx_lock(&pool->mutex);
+	pool->task = task;
+	pool->arg = arg;
+	pool->count = count;
+	pool->next = 0;
+	pool->finished = 0;
+	/* Few chunks per thread gives good balance between load balancing and locking overhead */
+	pool->chunk_size = count / ((pool->threads.size + 1) * 4);
+	if (pool->chunk_size == 0) {
+		pool->chunk_size = 1;
+	}
+	++pool->generation;
+	de_cnd_broadcast(&pool->work_cnd);
+
+	/* Calling thread helps workers */
+	de_thread_pool_process(pool);
+
+	while (pool->finished < pool->count) {
+		de_cnd_wait(&pool->done_cnd, &pool->mutex);
+	}
+	de_mtx_unlock(&pool->mutex);
+}
+
+size_t de_thread_pool_get_worker_count(const de_thread_pool_t* pool)
+{
+	return pool ? pool->threads.size : 0;
+}
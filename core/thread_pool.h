@@ -0,0 +1,64 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+/**
+ * Pool of worker threads for data-parallel work.
+ *
+ * Work is submitted as a "parallel for": callback is called once per each index in
+ * [0; count) on worker threads and on calling thread, call returns when every index is
+ * processed. Indices are distributed in small chunks, so callback should not rely on
+ * any order of execution.
+ *
+ * Important notes:
+ * - Pool must be used from one thread at a time (normally main thread), nested calls
+ *   from within callback are not allowed.
+ * - Callbacks should not allocate memory, because allocations serialize on system
+ *   allocator. Prepare all required memory before submitting work.
+ */
+
+typedef struct de_thread_pool_t de_thread_pool_t;
+
+/**
+ * @brief Callback which is called for each index of parallel for.
+ */
+typedef void(*de_thread_pool_task_t)(void* arg, size_t index);
+
+/**
+ * @brief Creates new pool with specified amount of worker threads. Zero count is allowed,
+ * in this case every work will be done on calling thread.
+ */
+de_thread_pool_t* de_thread_pool_create(size_t worker_count);
+
+/**
+ * @brief Stops and joins worker threads, frees memory.
+ */
+void de_thread_pool_free(de_thread_pool_t* pool);
+
+/**
+ * @brief Calls task(arg, i) for each i in [0; count) using worker threads and calling thread.
+ * Blocks until all calls are finished. Pool can be NULL, then work is done serially.
+ */
+void de_thread_pool_parallel_for(de_thread_pool_t* pool, size_t count, de_thread_pool_task_t task, void* arg);
+
+/**
+ * @brief Returns amount of worker threads in pool. Calling thread is not counted.
+ */
+size_t de_thread_pool_get_worker_count(const de_thread_pool_t* pool);
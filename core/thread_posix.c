@@ -19,6 +19,12 @@
 * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
+size_t de_get_hardware_thread_count(void)
+{
+	const long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (size_t)count : 1;
+}
+
 int de_thrd_create(de_thrd_t* thr, de_thrd_start_t func, void* arg)
 {
 	pthread_create(thr, NULL, (void*(*)(void*)) func, arg);
@@ -19,6 +19,13 @@
 * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
+size_t de_get_hardware_thread_count(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors : 1;
+}
+
 int de_thrd_create(de_thrd_t* thr, de_thrd_start_t func, void* arg)
 {
 	thr->handle = (intptr_t)_beginthreadex(NULL, 0, (_beginthreadex_proc_type)func, arg, 0, 0);
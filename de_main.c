@@ -46,6 +46,7 @@
 #include "math/mathlib.c"
 #include "math/triangulator.c"
 #include "scene/animation.c"
+#include "scene/animation_compression.c"
 #include "scene/camera.c"
 #include "scene/light.c"
 #include "scene/mesh.c"
@@ -54,12 +55,15 @@
 #include "scene/scene.c"
 #include "renderer/renderer.c"
 #include "renderer/surface.c"
+#include "renderer/static_batch.c"
 #include "resources/texture.c"
 #include "gui/gui.c" 
 #include "vg/vgraster.c"
 #include "core/thread.c"
+#include "core/thread_pool.c"
 #include "sound/sound.c"
 #include "resources/resource.c"
+#include "scene/world_streamer.c"
 
 #if DE_EDITOR_ENABLED
 #include "editor/editor.c"
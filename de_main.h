@@ -102,6 +102,20 @@ extern "C" {
 #define M_PI 3.14159265358979323846
 #endif
 
+/* SIMD instruction sets available at compile time */
+#if defined(__AVX__)
+#  define DE_AVX 1
+#  include <immintrin.h>
+#else
+#  define DE_AVX 0
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define DE_SSE 1
+#  include <emmintrin.h>
+#else
+#  define DE_SSE 0
+#endif
+
 /* Platform-specific */
 #ifdef _WIN32
 #  define WIN32_LEAN_AND_MEAN
@@ -143,11 +157,16 @@ typedef struct de_renderer_t de_renderer_t;
 typedef struct de_node_t de_node_t;
 typedef struct de_surface_t de_surface_t;
 typedef struct de_animation_track_t de_animation_track_t;
+typedef struct de_animation_track_data_t de_animation_track_data_t;
+typedef struct de_keyframe_t de_keyframe_t;
 typedef struct de_texture_t de_texture_t;
 typedef struct de_static_triangle_t de_static_triangle_t;
 typedef struct de_static_geometry_t de_static_geometry_t;
+typedef struct de_static_batch_t de_static_batch_t;
 typedef struct de_mesh_t de_mesh_t;
 typedef struct de_body_t de_body_t;
+typedef struct de_broadphase_t de_broadphase_t;
+typedef struct de_static_geometry_tree_t de_static_geometry_tree_t;
 typedef struct de_light_t de_light_t;
 typedef struct de_gui_t de_gui_t;
 typedef struct de_core_t de_core_t;
@@ -170,6 +189,7 @@ typedef struct de_object_visitor_t de_object_visitor_t;
 #include "core/array.h"
 #include "core/base64.h"
 #include "core/thread.h"
+#include "core/thread_pool.h"
 #include "core/string.h"
 #include "core/string_utils.h"
 #include "core/path.h"
@@ -195,12 +215,14 @@ typedef struct de_object_visitor_t de_object_visitor_t;
 #include "scene/light.h"
 #include "scene/particle_system.h"
 #include "scene/node.h"
+#include "scene/animation_compression.h"
 #include "scene/animation.h"
 #include "scene/scene.h"
 #include "physics/physics.h"
 #include "renderer/surface.h"
 #include "fbx/fbx.h"
 #include "renderer/renderer.h"
+#include "renderer/static_batch.h"
 #include "resources/resource_fdecl.h"
 #include "resources/texture.h"
 #include "font/font.h"
@@ -209,6 +231,7 @@ typedef struct de_object_visitor_t de_object_visitor_t;
 #include "sound/sound.h"
 #include "resources/resource.h"
 #include "core/core.h" 
+#include "scene/world_streamer.h"
 #include "external/miniz_tinfl.h"
 
 #if DE_EDITOR_ENABLED
@@ -189,9 +189,10 @@ typedef struct de_fbx_component_t {
 	} s;
 } de_fbx_component_t;
 
-typedef struct de_fbx_t {
+struct de_fbx_t {
 	DE_ARRAY_DECLARE(de_fbx_component_t*, components);
-} de_fbx_t;
+	de_fbx_buffer_t data_buf; /**< Memory block of parsed properties, components may reference it */
+};
 
 #include "fbx/fbx_node.c"
 #include "fbx/fbx_ascii.c"
@@ -860,11 +861,7 @@ static de_fbx_t* de_fbx_read(de_fbx_node_t* root)
 }
 
 
-/**
- * @brief Frees resources associated with fbx structure
- * @param fbx pointer
- */
-static void de_fbx_free(de_fbx_t* fbx)
+void de_fbx_free(de_fbx_t* fbx)
 {
 	size_t i;
 	for (i = 0; i < fbx->components.size; ++i) {
@@ -901,6 +898,7 @@ static void de_fbx_free(de_fbx_t* fbx)
 		de_free(comp);
 	}
 	DE_ARRAY_FREE(fbx->components);
+	de_fbx_buffer_free(&fbx->data_buf);
 	de_free(fbx);
 }
 
@@ -1254,7 +1252,7 @@ static de_surface_t* de_fbx_create_surface(de_renderer_t* renderer, de_fbx_geom_
  * @param fbx
  * @return
  */
-static de_node_t* de_fbx_to_scene(de_scene_t* scene, de_fbx_t* fbx)
+de_node_t* de_fbx_to_scene(de_scene_t* scene, de_fbx_t* fbx)
 {
 	size_t i, k, j;
 	int n, m;
@@ -1701,11 +1699,10 @@ static de_node_t* de_fbx_to_scene(de_scene_t* scene, de_fbx_t* fbx)
 }
 
 
-de_node_t* de_fbx_load_to_scene(de_scene_t* scene, const char* file)
+de_fbx_t* de_fbx_load_file(const char* file)
 {
 	de_fbx_node_t* root;
 	de_fbx_t* fbx;
-	de_node_t* root_node;
 	double last_time;
 	de_fbx_buffer_t data_buf;
 
@@ -1726,19 +1723,37 @@ de_node_t* de_fbx_load_to_scene(de_scene_t* scene, const char* file)
 
 	fbx = de_fbx_read(root);
 
+	de_fbx_node_free(root);
+
+	if (!fbx) {
+		de_fbx_buffer_free(&data_buf);
+		return NULL;
+	}
+
+	fbx->data_buf = data_buf;
+
+	return fbx;
+}
+
+de_node_t* de_fbx_load_to_scene(de_scene_t* scene, const char* file)
+{
+	de_fbx_t* fbx;
+	de_node_t* root_node;
+	double last_time;
+
+	last_time = de_time_get_seconds();
+
+	fbx = de_fbx_load_file(file);
+
 	if (!fbx) {
-		de_fbx_node_free(root);
 		return NULL;
 	}
 
-	de_fbx_node_free(root);
 	root_node = de_fbx_to_scene(scene, fbx);
 	de_fbx_free(fbx);
 
 	de_log("FBX: %s is loaded in %f seconds!", file, de_time_get_seconds() - last_time);
 
-	de_fbx_buffer_free(&data_buf);
-
 	return root_node;
 }
 
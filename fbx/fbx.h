@@ -73,6 +73,11 @@ typedef enum de_fbx_reference_t {
 #include "fbx/fbx_ascii.h"
 #include "fbx/fbx_binary.h"
 
+/**
+ * @brief Intermediate representation of FBX file, does not depend on any scene.
+ */
+typedef struct de_fbx_t de_fbx_t;
+
 /**
 * @brief
 * @param file
@@ -80,4 +85,21 @@ typedef enum de_fbx_reference_t {
 */
 de_node_t* de_fbx_load_to_scene(de_scene_t* scene, const char* file);
 
+/**
+ * @brief Parses FBX file into intermediate representation. Does not touch any scene or core,
+ * so it is safe to call from worker thread. Returns NULL on failure.
+ */
+de_fbx_t* de_fbx_load_file(const char* file);
+
+/**
+ * @brief Converts intermediate representation into scene nodes. Must be called from main
+ * thread, because it requests texture resources from core.
+ */
+de_node_t* de_fbx_to_scene(de_scene_t* scene, de_fbx_t* fbx);
+
+/**
+ * @brief Frees intermediate representation returned by de_fbx_load_file.
+ */
+void de_fbx_free(de_fbx_t* fbx);
+
 bool de_fbx_is_binary(const char* filename);
\ No newline at end of file
@@ -1081,10 +1081,10 @@ de_quat_t* de_quat_mul(de_quat_t* out, const de_quat_t* a, const de_quat_t* b)
 de_quat_t* de_quat_normalize(de_quat_t* out, de_quat_t* a)
 {
 	float k = 1.0f / de_quat_len(a);
-	out->x *= k;
-	out->y *= k;
-	out->z *= k;
-	out->w *= k;
+	out->x = a->x * k;
+	out->y = a->y * k;
+	out->z = a->z * k;
+	out->w = a->w * k;
 	return out;
 }
 
@@ -90,29 +90,184 @@ static bool de_body_point_intersection(const de_vec3_t* point, const de_vec3_t*
 	return false;
 }
 
-static bool de_sphere_triangle_intersection(const de_vec3_t* sphere_pos, float sphere_radius, const de_static_triangle_t* triangle, de_vec3_t* intersection_pt)
+/**
+ * @brief Barycentric "point-in-triangle" test using dot products precalculated in pack.
+ */
+static bool de_static_triangle_pack_contains_point(const de_static_triangle_pack_t* pack, int lane, const de_vec3_t* point)
+{
+	const de_vec3_t a = { pack->a_x[lane], pack->a_y[lane], pack->a_z[lane] };
+	const de_vec3_t ba = { pack->ba_x[lane], pack->ba_y[lane], pack->ba_z[lane] };
+	const de_vec3_t ca = { pack->ca_x[lane], pack->ca_y[lane], pack->ca_z[lane] };
+	de_vec3_t vp;
+	de_vec3_sub(&vp, point, &a);
+	const float dot02 = de_vec3_dot(&ca, &vp);
+	const float dot12 = de_vec3_dot(&ba, &vp);
+	const float u = (pack->ba_dot_ba[lane] * dot02 - pack->ca_dot_ba[lane] * dot12) * pack->inv_denom[lane];
+	const float v = (pack->ca_dot_ca[lane] * dot12 - pack->ca_dot_ba[lane] * dot02) * pack->inv_denom[lane];
+	return (u >= 0.0f) && (v >= 0.0f) && (u + v < 1.0f);
+}
+
+/**
+ * @brief Exact sphere test for one triangle of pack. Edge rays are (a, b - a), (b, c - b) and
+ * (c, a - c), direction of last one is negated edge c - a.
+ */
+static bool de_sphere_triangle_intersection(const de_vec3_t* sphere_pos, float sphere_radius, const de_static_triangle_pack_t* pack, int lane, de_vec3_t* intersection_pt)
 {
 	de_plane_t plane;
 	float distance;
 
-	de_plane_set(&plane, &triangle->normal, triangle->distance);
+	plane.n = (de_vec3_t) { pack->n_x[lane], pack->n_y[lane], pack->n_z[lane] };
+	plane.d = pack->distance[lane];
 
 	distance = de_plane_distance(&plane, sphere_pos);
 	if (distance <= sphere_radius) {
 		de_vec3_t offset;
 		de_vec3_scale(&offset, &plane.n, distance);
 		de_vec3_sub(intersection_pt, sphere_pos, &offset);
-		return de_static_triangle_contains_point(triangle, intersection_pt) ||
-			de_body_sphere_intersection(&triangle->ab_ray, sphere_pos, sphere_radius, intersection_pt) ||
-			de_body_sphere_intersection(&triangle->bc_ray, sphere_pos, sphere_radius, intersection_pt) ||
-			de_body_sphere_intersection(&triangle->ca_ray, sphere_pos, sphere_radius, intersection_pt) ||
-			de_body_point_intersection(&triangle->a, sphere_pos, sphere_radius, intersection_pt) ||
-			de_body_point_intersection(&triangle->b, sphere_pos, sphere_radius, intersection_pt) ||
-			de_body_point_intersection(&triangle->c, sphere_pos, sphere_radius, intersection_pt);
+		if (de_static_triangle_pack_contains_point(pack, lane, intersection_pt)) {
+			return true;
+		}
+		const de_vec3_t a = { pack->a_x[lane], pack->a_y[lane], pack->a_z[lane] };
+		const de_vec3_t b = { pack->b_x[lane], pack->b_y[lane], pack->b_z[lane] };
+		const de_vec3_t c = { pack->c_x[lane], pack->c_y[lane], pack->c_z[lane] };
+		const de_ray_t ab_ray = { a, { pack->ba_x[lane], pack->ba_y[lane], pack->ba_z[lane] } };
+		const de_ray_t bc_ray = { b, { pack->cb_x[lane], pack->cb_y[lane], pack->cb_z[lane] } };
+		const de_ray_t ca_ray = { c, { -pack->ca_x[lane], -pack->ca_y[lane], -pack->ca_z[lane] } };
+		return de_body_sphere_intersection(&ab_ray, sphere_pos, sphere_radius, intersection_pt) ||
+			de_body_sphere_intersection(&bc_ray, sphere_pos, sphere_radius, intersection_pt) ||
+			de_body_sphere_intersection(&ca_ray, sphere_pos, sphere_radius, intersection_pt) ||
+			de_body_point_intersection(&a, sphere_pos, sphere_radius, intersection_pt) ||
+			de_body_point_intersection(&b, sphere_pos, sphere_radius, intersection_pt) ||
+			de_body_point_intersection(&c, sphere_pos, sphere_radius, intersection_pt);
 	}
 	return false;
 }
 
+#if DE_SSE
+static __m128 de_dot_sse(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+static __m128 de_select_sse(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/**
+ * @brief de_body_sphere_intersection for four edge rays.
+ */
+static __m128 de_body_sphere_intersection_sse(__m128 ox, __m128 oy, __m128 oz, __m128 ex, __m128 ey, __m128 ez,
+	__m128 px, __m128 py, __m128 pz, __m128 sqr_radius, __m128* ix, __m128* iy, __m128* iz)
+{
+	/* de_ray_sphere_intersection */
+	const __m128 dx = _mm_sub_ps(ox, px), dy = _mm_sub_ps(oy, py), dz = _mm_sub_ps(oz, pz);
+	const __m128 sqr_len = de_dot_sse(ex, ey, ez, ex, ey, ez);
+	const __m128 b = _mm_mul_ps(_mm_set1_ps(2.0f), de_dot_sse(ex, ey, ez, dx, dy, dz));
+	const __m128 c = _mm_sub_ps(de_dot_sse(dx, dy, dz, dx, dy, dz), sqr_radius);
+	const __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.0f), sqr_len), c));
+	const __m128 hit = _mm_cmpnlt_ps(discriminant, _mm_setzero_ps());
+	/* de_project_point_on_line */
+	const __m128 pax = _mm_sub_ps(px, ox), pay = _mm_sub_ps(py, oy), paz = _mm_sub_ps(pz, oz);
+	const __m128 t = _mm_div_ps(de_dot_sse(pax, pay, paz, ex, ey, ez), sqr_len);
+	*ix = _mm_add_ps(ox, _mm_mul_ps(ex, t));
+	*iy = _mm_add_ps(oy, _mm_mul_ps(ey, t));
+	*iz = _mm_add_ps(oz, _mm_mul_ps(ez, t));
+	/* de_is_point_on_line_segment */
+	const __m128 end_x = _mm_add_ps(ox, ex), end_y = _mm_add_ps(oy, ey), end_z = _mm_add_ps(oz, ez);
+	__m128 outside = _mm_cmpgt_ps(*ix, _mm_max_ps(ox, end_x));
+	outside = _mm_or_ps(outside, _mm_cmpgt_ps(*iy, _mm_max_ps(oy, end_y)));
+	outside = _mm_or_ps(outside, _mm_cmpgt_ps(*iz, _mm_max_ps(oz, end_z)));
+	outside = _mm_or_ps(outside, _mm_cmplt_ps(*ix, _mm_min_ps(ox, end_x)));
+	outside = _mm_or_ps(outside, _mm_cmplt_ps(*iy, _mm_min_ps(oy, end_y)));
+	outside = _mm_or_ps(outside, _mm_cmplt_ps(*iz, _mm_min_ps(oz, end_z)));
+	return _mm_andnot_ps(outside, hit);
+}
+
+/**
+ * @brief de_body_point_intersection for four points.
+ */
+static __m128 de_body_point_intersection_sse(__m128 vx, __m128 vy, __m128 vz, __m128 px, __m128 py, __m128 pz, __m128 sqr_radius)
+{
+	const __m128 dx = _mm_sub_ps(vx, px), dy = _mm_sub_ps(vy, py), dz = _mm_sub_ps(vz, pz);
+	return _mm_cmplt_ps(de_dot_sse(dx, dy, dz, dx, dy, dz), sqr_radius);
+}
+
+/**
+ * @brief de_sphere_triangle_intersection for four triangles of pack. Performs the same float
+ * operations in the same order, so result is bit-identical to scalar test. Returns mask of
+ * triangles which intersect sphere, intersection points are written to SoA arrays.
+ */
+static int de_sphere_triangle_pack_intersection_sse(const de_vec3_t* sphere_pos, float sphere_radius, const de_static_triangle_pack_t* pack,
+	float* intersection_x, float* intersection_y, float* intersection_z)
+{
+	const __m128 px = _mm_set1_ps(sphere_pos->x);
+	const __m128 py = _mm_set1_ps(sphere_pos->y);
+	const __m128 pz = _mm_set1_ps(sphere_pos->z);
+	const __m128 radius = _mm_set1_ps(sphere_radius);
+	const __m128 sqr_radius = _mm_set1_ps(sphere_radius * sphere_radius);
+
+	/* distance to plane */
+	const __m128 nx = _mm_loadu_ps(pack->n_x), ny = _mm_loadu_ps(pack->n_y), nz = _mm_loadu_ps(pack->n_z);
+	const __m128 distance = _mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_add_ps(de_dot_sse(nx, ny, nz, px, py, pz), _mm_loadu_ps(pack->distance)));
+	const __m128 near_plane = _mm_cmple_ps(distance, radius);
+	if (!_mm_movemask_ps(near_plane)) {
+		return 0;
+	}
+
+	/* projection of center on plane inside of triangle */
+	const __m128 ax = _mm_loadu_ps(pack->a_x), ay = _mm_loadu_ps(pack->a_y), az = _mm_loadu_ps(pack->a_z);
+	const __m128 bax = _mm_loadu_ps(pack->ba_x), bay = _mm_loadu_ps(pack->ba_y), baz = _mm_loadu_ps(pack->ba_z);
+	const __m128 cax = _mm_loadu_ps(pack->ca_x), cay = _mm_loadu_ps(pack->ca_y), caz = _mm_loadu_ps(pack->ca_z);
+	__m128 ix = _mm_sub_ps(px, _mm_mul_ps(nx, distance));
+	__m128 iy = _mm_sub_ps(py, _mm_mul_ps(ny, distance));
+	__m128 iz = _mm_sub_ps(pz, _mm_mul_ps(nz, distance));
+	const __m128 vpx = _mm_sub_ps(ix, ax), vpy = _mm_sub_ps(iy, ay), vpz = _mm_sub_ps(iz, az);
+	const __m128 dot02 = de_dot_sse(cax, cay, caz, vpx, vpy, vpz);
+	const __m128 dot12 = de_dot_sse(bax, bay, baz, vpx, vpy, vpz);
+	const __m128 ba_dot_ba = _mm_loadu_ps(pack->ba_dot_ba);
+	const __m128 ca_dot_ba = _mm_loadu_ps(pack->ca_dot_ba);
+	const __m128 ca_dot_ca = _mm_loadu_ps(pack->ca_dot_ca);
+	const __m128 inv_denom = _mm_loadu_ps(pack->inv_denom);
+	const __m128 u = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(ba_dot_ba, dot02), _mm_mul_ps(ca_dot_ba, dot12)), inv_denom);
+	const __m128 v = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(ca_dot_ca, dot12), _mm_mul_ps(ca_dot_ba, dot02)), inv_denom);
+	const __m128 zero = _mm_setzero_ps();
+	__m128 found = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)), _mm_cmplt_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+
+	/* edges and vertices in order of scalar test, first passed test gives intersection point */
+	const __m128 bx = _mm_loadu_ps(pack->b_x), by = _mm_loadu_ps(pack->b_y), bz = _mm_loadu_ps(pack->b_z);
+	const __m128 cx = _mm_loadu_ps(pack->c_x), cy = _mm_loadu_ps(pack->c_y), cz = _mm_loadu_ps(pack->c_z);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 hit, hx, hy, hz;
+	hit = de_body_sphere_intersection_sse(ax, ay, az, bax, bay, baz, px, py, pz, sqr_radius, &hx, &hy, &hz);
+	hit = _mm_andnot_ps(found, hit);
+	ix = de_select_sse(hit, hx, ix), iy = de_select_sse(hit, hy, iy), iz = de_select_sse(hit, hz, iz);
+	found = _mm_or_ps(found, hit);
+	hit = de_body_sphere_intersection_sse(bx, by, bz, _mm_loadu_ps(pack->cb_x), _mm_loadu_ps(pack->cb_y), _mm_loadu_ps(pack->cb_z), px, py, pz, sqr_radius, &hx, &hy, &hz);
+	hit = _mm_andnot_ps(found, hit);
+	ix = de_select_sse(hit, hx, ix), iy = de_select_sse(hit, hy, iy), iz = de_select_sse(hit, hz, iz);
+	found = _mm_or_ps(found, hit);
+	hit = de_body_sphere_intersection_sse(cx, cy, cz, _mm_xor_ps(cax, sign), _mm_xor_ps(cay, sign), _mm_xor_ps(caz, sign), px, py, pz, sqr_radius, &hx, &hy, &hz);
+	hit = _mm_andnot_ps(found, hit);
+	ix = de_select_sse(hit, hx, ix), iy = de_select_sse(hit, hy, iy), iz = de_select_sse(hit, hz, iz);
+	found = _mm_or_ps(found, hit);
+	hit = _mm_andnot_ps(found, de_body_point_intersection_sse(ax, ay, az, px, py, pz, sqr_radius));
+	ix = de_select_sse(hit, ax, ix), iy = de_select_sse(hit, ay, iy), iz = de_select_sse(hit, az, iz);
+	found = _mm_or_ps(found, hit);
+	hit = _mm_andnot_ps(found, de_body_point_intersection_sse(bx, by, bz, px, py, pz, sqr_radius));
+	ix = de_select_sse(hit, bx, ix), iy = de_select_sse(hit, by, iy), iz = de_select_sse(hit, bz, iz);
+	found = _mm_or_ps(found, hit);
+	hit = _mm_andnot_ps(found, de_body_point_intersection_sse(cx, cy, cz, px, py, pz, sqr_radius));
+	ix = de_select_sse(hit, cx, ix), iy = de_select_sse(hit, cy, iy), iz = de_select_sse(hit, cz, iz);
+	found = _mm_or_ps(found, hit);
+
+	_mm_storeu_ps(intersection_x, ix);
+	_mm_storeu_ps(intersection_y, iy);
+	_mm_storeu_ps(intersection_z, iz);
+	return _mm_movemask_ps(_mm_and_ps(near_plane, found));
+}
+#endif
+
 static void de_body_verlet(de_body_t* body, float dt2)
 {
 	de_vec3_t last_position;
@@ -150,6 +305,15 @@ static void de_body_verlet(de_body_t* body, float dt2)
 	}
 }
 
+void de_body_update_broadphase(de_body_t* body)
+{
+	de_scene_t* scene = body->scene;
+	if (!scene->broadphase) {
+		scene->broadphase = de_broadphase_create(DE_BROADPHASE_DEFAULT_CELL_SIZE);
+	}
+	de_broadphase_update_body(scene->broadphase, body);
+}
+
 static de_contact_t* de_body_add_contact(de_body_t* body)
 {
 	if (body->contact_count < DE_MAX_CONTACTS) {
@@ -158,42 +322,51 @@ static de_contact_t* de_body_add_contact(de_body_t* body)
 	return NULL;
 }
 
-void de_body_triangle_collision(de_static_triangle_t* triangle, de_body_t* sphere)
+/**
+ * @brief Pushes sphere out of triangle using intersection point found by exact sphere test.
+ */
+static void de_body_triangle_contact(de_static_triangle_t* triangle, de_body_t* sphere, const de_vec3_t* intersection_pt)
 {
-	de_vec3_t intersectionPoint;
 	de_vec3_t middle, orientation, offset;
 	float length, penetrationDepth;
 	de_contact_t* contact;
 
-	if (de_sphere_triangle_intersection(&sphere->position, sphere->radius, triangle, &intersectionPoint)) {
-		length = 0.0f;
+	length = 0.0f;
 
-		/* Calculate penetration depth and push vector */
-		de_vec3_sub(&middle, &sphere->position, &intersectionPoint);
-		de_vec3_normalize_ex(&orientation, &middle, &length);
-		penetrationDepth = sphere->radius - length;
+	/* Calculate penetration depth and push vector */
+	de_vec3_sub(&middle, &sphere->position, intersection_pt);
+	de_vec3_normalize_ex(&orientation, &middle, &length);
+	penetrationDepth = sphere->radius - length;
 
-		/* Degenerated case, ignore */
-		if (penetrationDepth < 0.0f) {
-			return;
-		}
+	/* Degenerated case, ignore */
+	if (penetrationDepth < 0.0f) {
+		return;
+	}
 
-		/* Push sphere outside of triangle */
-		de_vec3_add(&sphere->position, &sphere->position, de_vec3_scale(&offset, &orientation, penetrationDepth));
+	/* Push sphere outside of triangle */
+	de_vec3_add(&sphere->position, &sphere->position, de_vec3_scale(&offset, &orientation, penetrationDepth));
 
-		/* Write contact info */
-		contact = de_body_add_contact(sphere);
+	/* Write contact info */
+	contact = de_body_add_contact(sphere);
 
-		if (contact) {
-			contact->body = NULL;
-			contact->normal = orientation;
-			contact->position = intersectionPoint;
-			contact->triangle = triangle;
-		}
+	if (contact) {
+		contact->body = NULL;
+		contact->normal = orientation;
+		contact->position = *intersection_pt;
+		contact->triangle = triangle;
+	}
+}
+
+void de_body_triangle_collision(de_static_triangle_t* triangle, const de_static_triangle_pack_t* pack, int lane, de_body_t* sphere)
+{
+	de_vec3_t intersectionPoint;
+
+	if (de_sphere_triangle_intersection(&sphere->position, sphere->radius, pack, lane, &intersectionPoint)) {
+		de_body_triangle_contact(triangle, sphere, &intersectionPoint);
 	}
 }
 
-void de_body_body_collision(de_body_t* body, de_body_t* other)
+bool de_body_body_collision(de_body_t* body, de_body_t* other)
 {
 	de_vec3_t dir;
 	de_vec3_sub(&dir, &other->position, &body->position);
@@ -223,20 +396,123 @@ void de_body_body_collision(de_body_t* body, de_body_t* other)
 			contact->position = center;
 			contact->triangle = NULL;
 		}
+		return true;
 	}
+	return false;
+}
+
+void de_body_set_collision_layer(de_body_t* body, uint32_t layer)
+{
+	DE_ASSERT(body);
+	body->collision_layer = layer;
+	body->contact_cache.revision = 0;
+	de_body_wake_up(body);
+}
+
+uint32_t de_body_get_collision_layer(const de_body_t* body)
+{
+	DE_ASSERT(body);
+	return body->collision_layer;
+}
+
+void de_body_set_collision_mask(de_body_t* body, uint32_t mask)
+{
+	DE_ASSERT(body);
+	body->collision_mask = mask;
+	body->contact_cache.revision = 0;
+	de_body_wake_up(body);
+}
+
+uint32_t de_body_get_collision_mask(const de_body_t* body)
+{
+	DE_ASSERT(body);
+	return body->collision_mask;
+}
+
+bool de_body_is_sleeping(const de_body_t* body)
+{
+	DE_ASSERT(body);
+	return body->sleeping;
+}
+
+void de_body_wake_up(de_body_t* body)
+{
+	DE_ASSERT(body);
+	body->sleeping = false;
+	body->still_time = 0.0f;
+}
+
+/**
+ * @brief Returns true if other body has contact with body or touches it.
+ */
+static bool de_body_is_touching(const de_body_t* body, const de_body_t* other)
+{
+	for (int i = 0; i < other->contact_count; ++i) {
+		if (other->contacts[i].body == body) {
+			return true;
+		}
+	}
+	/* resolved pairs are separated exactly by sum of radii, so small slack is needed */
+	const float radius_sum = (body->radius + other->radius) * 1.01f;
+	return de_vec3_sqr_distance(&body->position, &other->position) <= radius_sum * radius_sum;
+}
+
+/**
+ * @brief Wakes sleeping bodies which touch body at its current position. Must be called before
+ * body is moved or removed, otherwise bodies resting on it would hang in the air: sleeping
+ * bodies are not integrated and pairs of sleeping bodies are not resolved.
+ * @param forget also remove contacts with body from nearby bodies, used when body is freed.
+ */
+static void de_body_wake_touching(de_body_t* body, bool forget)
+{
+	de_broadphase_t* bp = body->scene->broadphase;
+	if (!bp) {
+		return;
+	}
+	de_body_array_t candidates;
+	DE_ARRAY_INIT(candidates);
+	if (!de_broadphase_query_overlaps(bp, body, &candidates)) {
+		/* large body can touch anything */
+		DE_LINKED_LIST_FOR_EACH_T(de_body_t*, other, body->scene->bodies)
+		{
+			if (other != body) {
+				DE_ARRAY_APPEND(candidates, other);
+			}
+		}
+	}
+	for (size_t i = 0; i < candidates.size; ++i) {
+		de_body_t* other = candidates.data[i];
+		if (other->sleeping && de_body_is_touching(body, other)) {
+			de_body_wake_up(other);
+		}
+		if (forget) {
+			int count = 0;
+			for (int k = 0; k < other->contact_count; ++k) {
+				if (other->contacts[k].body != body) {
+					other->contacts[count++] = other->contacts[k];
+				}
+			}
+			other->contact_count = count;
+		}
+	}
+	DE_ARRAY_FREE(candidates);
 }
 
 void de_body_set_gravity(de_body_t* body, const de_vec3_t * gravity)
 {
 	DE_ASSERT(body);
 	body->gravity = *gravity;
+	de_body_wake_up(body);
 }
 
 void de_body_set_position(de_body_t* body, const de_vec3_t * pos)
 {
 	DE_ASSERT(body);
+	de_body_wake_touching(body, false);
 	body->position = *pos;
 	body->last_position = *pos;
+	de_body_wake_up(body);
+	de_body_update_broadphase(body);
 }
 
 void de_body_get_position(const de_body_t* body, de_vec3_t* pos)
@@ -249,6 +525,8 @@ void de_body_set_radius(de_body_t* body, float radius)
 {
 	DE_ASSERT(body);
 	body->radius = radius;
+	de_body_wake_up(body);
+	de_body_update_broadphase(body);
 }
 
 float de_body_get_radius(de_body_t* body)
@@ -276,6 +554,11 @@ de_contact_t* de_body_get_contact(de_body_t* body, size_t i)
 void de_body_free(de_body_t* body)
 {
 	DE_ASSERT(body);
+	/* bodies of scene being destroyed are freed after broadphase, nothing to wake then */
+	de_body_wake_touching(body, true);
+	if (body->scene->broadphase) {
+		de_broadphase_remove_body(body->scene->broadphase, body);
+	}
 	DE_LINKED_LIST_REMOVE(body->scene->bodies, body);
 	de_free(body);
 }
@@ -283,7 +566,10 @@ void de_body_free(de_body_t* body)
 void de_body_move(de_body_t* body, const de_vec3_t* velocity)
 {
 	DE_ASSERT(body);
+	de_body_wake_touching(body, false);
 	de_vec3_add(&body->position, &body->position, velocity);
+	de_body_wake_up(body);
+	de_body_update_broadphase(body);
 }
 
 void de_body_set_velocity(de_body_t* body, const de_vec3_t* velocity)
@@ -291,24 +577,28 @@ void de_body_set_velocity(de_body_t* body, const de_vec3_t* velocity)
 	DE_ASSERT(body);
 	body->last_position = body->position;
 	de_vec3_sub(&body->last_position, &body->last_position, velocity);
+	de_body_wake_up(body);
 }
 
 void de_body_set_y_velocity(de_body_t* body, float y_velocity)
 {
 	DE_ASSERT(body);
 	body->last_position.y = body->position.y - y_velocity;
+	de_body_wake_up(body);
 }
 
 void de_body_set_x_velocity(de_body_t* body, float x_velocity)
 {
 	DE_ASSERT(body);
 	body->last_position.x = body->position.x - x_velocity;
+	de_body_wake_up(body);
 }
 
 void de_body_set_z_velocity(de_body_t* body, float z_velocity)
 {
 	DE_ASSERT(body);
 	body->last_position.z = body->position.z - z_velocity;
+	de_body_wake_up(body);
 }
 
 void de_body_get_velocity(de_body_t* body, de_vec3_t * velocity)
@@ -327,6 +617,9 @@ de_body_t* de_body_create(de_scene_t* s)
 	body->friction = 0.985f;
 	body->scale = (de_vec3_t) { 1, 1, 1 };
 	body->gravity = (de_vec3_t) { 0, -9.81f, 0 };
+	body->collision_layer = DE_COLLISION_LAYER_DEFAULT;
+	body->collision_mask = DE_COLLISION_MASK_ALL;
+	de_body_update_broadphase(body);
 	return body;
 }
 
@@ -341,6 +634,12 @@ bool de_body_visit(de_object_visitor_t* visitor, de_body_t* body)
 	result &= de_object_visitor_visit_float(visitor, "Radius", &body->radius);
 	result &= de_object_visitor_visit_float(visitor, "Friction", &body->friction);
 	result &= de_object_visitor_visit_vec3(visitor, "Scale", &body->scale);
+	/* layers are missing in older saves, defaults are used then */
+	if (!de_object_visitor_visit_uint32(visitor, "CollisionLayer", &body->collision_layer) ||
+		!de_object_visitor_visit_uint32(visitor, "CollisionMask", &body->collision_mask)) {
+		body->collision_layer = DE_COLLISION_LAYER_DEFAULT;
+		body->collision_mask = DE_COLLISION_MASK_ALL;
+	}
 	return result;
 }
 
@@ -357,5 +656,7 @@ de_body_t* de_body_copy(de_scene_t* dest_scene, de_body_t* body)
 	copy->radius = body->radius;
 	copy->friction = body->friction;
 	copy->scale = body->scale;
+	copy->collision_layer = body->collision_layer;
+	copy->collision_mask = body->collision_mask;
 	return copy;
 }
\ No newline at end of file
@@ -19,6 +19,20 @@
 * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
+/**
+ * @brief Leafs of static geometry found around body by last full query. While body stays
+ * within DE_BODY_CONTACT_CACHE_MARGIN of center, every leaf which touches body is among them,
+ * so query of top-level tree and BVHs of geometries is skipped. Private.
+ */
+typedef struct de_body_contact_cache_t {
+	de_vec3_t center;  /**< Position of body during last full query */
+	float radius;      /**< Radius of body during last full query */
+	uint32_t revision; /**< Revision of top-level tree, cache is valid only if it matches. Zero is never valid */
+	uint32_t count;
+	uint32_t geometries[DE_BODY_CONTACT_CACHE_SIZE]; /**< Indices in top-level tree, in order of scene list */
+	uint32_t leafs[DE_BODY_CONTACT_CACHE_SIZE];      /**< Leafs of geometries in depth-first order */
+} de_body_contact_cache_t;
+
 /**
 * @class de_body_s
 * @brief Body type for position-based physics.
@@ -36,6 +50,12 @@ struct de_body_t {
 	de_contact_t contacts[DE_MAX_CONTACTS]; /**< Array of contacts. */
 	int contact_count;                      /**< Actual count of physical contacts */
 	de_vec3_t scale;                        /**< Scaling coefficients. When != (1, 1, 1) - body is ellipsoid */
+	de_broadphase_proxy_t proxy;            /**< Private. Broadphase data */
+	uint32_t collision_layer;               /**< Bits of layers body belongs to */
+	uint32_t collision_mask;                /**< Bits of layers body collides with */
+	float still_time;                       /**< Private. Time during which body was almost still, in seconds */
+	bool sleeping;                          /**< Private. Sleeping body is not integrated and not collided with static geometry */
+	de_body_contact_cache_t contact_cache;  /**< Private. Static geometry near body */
 	DE_LINKED_LIST_ITEM(de_body_t);
 };
 
@@ -52,6 +72,11 @@ de_body_t* de_body_create(de_scene_t* s);
 
 bool de_body_visit(de_object_visitor_t* visitor, de_body_t* body);
 
+/**
+ * @brief Moves body into actual cells of broadphase of its scene. Internal.
+ */
+void de_body_update_broadphase(de_body_t* body);
+
 /**
 * @brief Changes actual position of a body by velocity vector. After this routine,
 * body will be moving with passed velocity.
@@ -92,6 +117,39 @@ void de_body_set_z_velocity(de_body_t* body, float z_velocity);
 */
 void de_body_get_velocity(de_body_t* body, de_vec3_t* velocity);
 
+/**
+* @brief Sets bits of layers body belongs to. See DE_COLLISION_LAYER_DEFAULT.
+*/
+void de_body_set_collision_layer(de_body_t* body, uint32_t layer);
+
+/**
+* @brief Returns bits of layers body belongs to.
+*/
+uint32_t de_body_get_collision_layer(const de_body_t* body);
+
+/**
+* @brief Sets bits of layers body collides with. Pairs of bodies and body-geometry pairs which
+* do not match are skipped before narrow phase.
+*/
+void de_body_set_collision_mask(de_body_t* body, uint32_t mask);
+
+/**
+* @brief Returns bits of layers body collides with.
+*/
+uint32_t de_body_get_collision_mask(const de_body_t* body);
+
+/**
+* @brief Returns true if body is sleeping. Body falls asleep when it and every body it touches
+* were still for DE_BODY_SLEEP_TIME. Sleeping body keeps its contacts.
+*/
+bool de_body_is_sleeping(const de_body_t* body);
+
+/**
+* @brief Wakes body up. Body is woken automatically when it is moved or its velocity is changed
+* via de_body_* functions, when awake body touches it, or when nearby static geometry is changed.
+*/
+void de_body_wake_up(de_body_t* body);
+
 /**
 * @brief Sets gravity vector for a body.
 */
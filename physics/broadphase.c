@@ -0,0 +1,453 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+#define DE_BROADPHASE_MAX_BODY_CELLS (64)
+#define DE_BROADPHASE_MIN_BUCKET_COUNT (64)
+#define DE_BROADPHASE_CELL_LIMIT (1 << 30)
+
+/* Bounds of bodies are slightly enlarged to make sure that precision loss on cell boundaries
+ * will never cause broadphase to skip a pair which narrow phase would accept */
+#define DE_BROADPHASE_MARGIN (0.01f)
+
+static int32_t de_broadphase_cell_coord(const de_broadphase_t* bp, float v)
+{
+	const float c = floorf(v * bp->inv_cell_size);
+	if (!(c > -DE_BROADPHASE_CELL_LIMIT)) {
+		/* also catches NaN */
+		return -DE_BROADPHASE_CELL_LIMIT;
+	}
+	if (c > DE_BROADPHASE_CELL_LIMIT) {
+		return DE_BROADPHASE_CELL_LIMIT;
+	}
+	return (int32_t)c;
+}
+
+static size_t de_broadphase_hash(const de_broadphase_t* bp, int32_t x, int32_t y, int32_t z)
+{
+	const uint32_t h = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+	return h & (bp->bucket_count - 1);
+}
+
+static uint64_t de_broadphase_proxy_cell_count(const de_broadphase_proxy_t* proxy)
+{
+	return (uint64_t)((int64_t)proxy->max[0] - proxy->min[0] + 1) *
+		(uint64_t)((int64_t)proxy->max[1] - proxy->min[1] + 1) *
+		(uint64_t)((int64_t)proxy->max[2] - proxy->min[2] + 1);
+}
+
+static bool de_broadphase_proxies_overlap(const de_broadphase_proxy_t* a, const de_broadphase_proxy_t* b)
+{
+	return a->min[0] <= b->max[0] && a->max[0] >= b->min[0] &&
+		a->min[1] <= b->max[1] && a->max[1] >= b->min[1] &&
+		a->min[2] <= b->max[2] && a->max[2] >= b->min[2];
+}
+
+static void de_broadphase_calculate_cells(const de_broadphase_t* bp, const de_body_t* body, de_broadphase_proxy_t* proxy)
+{
+	const float r = body->radius + DE_BROADPHASE_MARGIN;
+	proxy->min[0] = de_broadphase_cell_coord(bp, body->position.x - r);
+	proxy->min[1] = de_broadphase_cell_coord(bp, body->position.y - r);
+	proxy->min[2] = de_broadphase_cell_coord(bp, body->position.z - r);
+	proxy->max[0] = de_broadphase_cell_coord(bp, body->position.x + r);
+	proxy->max[1] = de_broadphase_cell_coord(bp, body->position.y + r);
+	proxy->max[2] = de_broadphase_cell_coord(bp, body->position.z + r);
+}
+
+static void de_broadphase_grow_bounds(de_broadphase_t* bp, const de_broadphase_proxy_t* proxy)
+{
+	for (int i = 0; i < 3; ++i) {
+		if (!bp->bounds_valid || proxy->min[i] < bp->bounds_min[i]) {
+			bp->bounds_min[i] = proxy->min[i];
+		}
+		if (!bp->bounds_valid || proxy->max[i] > bp->bounds_max[i]) {
+			bp->bounds_max[i] = proxy->max[i];
+		}
+	}
+	bp->bounds_valid = true;
+}
+
+static void de_broadphase_insert_cells(de_broadphase_t* bp, de_body_t* body)
+{
+	de_broadphase_proxy_t* proxy = &body->proxy;
+	if (proxy->large) {
+		DE_ARRAY_APPEND(bp->large_bodies, body);
+	} else {
+		for (int32_t z = proxy->min[2]; z <= proxy->max[2]; ++z) {
+			for (int32_t y = proxy->min[1]; y <= proxy->max[1]; ++y) {
+				for (int32_t x = proxy->min[0]; x <= proxy->max[0]; ++x) {
+					de_body_array_t* bucket = &bp->buckets[de_broadphase_hash(bp, x, y, z)];
+					DE_ARRAY_APPEND(*bucket, body);
+				}
+			}
+		}
+	}
+}
+
+static void de_broadphase_remove_from_array(de_body_array_t* array, de_body_t* body)
+{
+	for (size_t i = 0; i < array->size; ++i) {
+		if (array->data[i] == body) {
+			/* order inside bucket does not matter, candidates are sorted anyway */
+			array->data[i] = array->data[array->size - 1];
+			--array->size;
+			return;
+		}
+	}
+}
+
+static void de_broadphase_remove_cells(de_broadphase_t* bp, de_body_t* body)
+{
+	de_broadphase_proxy_t* proxy = &body->proxy;
+	if (proxy->large) {
+		de_broadphase_remove_from_array(&bp->large_bodies, body);
+	} else {
+		for (int32_t z = proxy->min[2]; z <= proxy->max[2]; ++z) {
+			for (int32_t y = proxy->min[1]; y <= proxy->max[1]; ++y) {
+				for (int32_t x = proxy->min[0]; x <= proxy->max[0]; ++x) {
+					de_broadphase_remove_from_array(&bp->buckets[de_broadphase_hash(bp, x, y, z)], body);
+				}
+			}
+		}
+	}
+}
+
+static void de_broadphase_rehash(de_broadphase_t* bp, size_t new_bucket_count)
+{
+	de_body_array_t* old_buckets = bp->buckets;
+	const size_t old_bucket_count = bp->bucket_count;
+
+	bp->buckets = de_calloc(new_bucket_count, sizeof(*bp->buckets));
+	bp->bucket_count = new_bucket_count;
+
+	/* every body is stored in each of its cells, insert it only once */
+	++bp->stamp;
+	for (size_t i = 0; i < old_bucket_count; ++i) {
+		de_body_array_t* bucket = &old_buckets[i];
+		for (size_t k = 0; k < bucket->size; ++k) {
+			de_body_t* body = bucket->data[k];
+			if (body->proxy.stamp != bp->stamp) {
+				body->proxy.stamp = bp->stamp;
+				de_broadphase_insert_cells(bp, body);
+			}
+		}
+		DE_ARRAY_FREE(*bucket);
+	}
+	de_free(old_buckets);
+}
+
+de_broadphase_t* de_broadphase_create(float cell_size)
+{
+	DE_ASSERT(cell_size > 0.0f);
+	de_broadphase_t* bp = DE_NEW(de_broadphase_t);
+	bp->cell_size = cell_size;
+	bp->inv_cell_size = 1.0f / cell_size;
+	bp->bucket_count = DE_BROADPHASE_MIN_BUCKET_COUNT;
+	bp->buckets = de_calloc(bp->bucket_count, sizeof(*bp->buckets));
+	return bp;
+}
+
+void de_broadphase_free(de_broadphase_t* bp)
+{
+	DE_ASSERT(bp);
+	for (size_t i = 0; i < bp->bucket_count; ++i) {
+		DE_ARRAY_FREE(bp->buckets[i]);
+	}
+	de_free(bp->buckets);
+	DE_ARRAY_FREE(bp->large_bodies);
+	de_free(bp);
+}
+
+bool de_broadphase_update_body(de_broadphase_t* bp, de_body_t* body)
+{
+	DE_ASSERT(bp);
+	DE_ASSERT(body);
+
+	de_broadphase_proxy_t cells;
+	de_broadphase_calculate_cells(bp, body, &cells);
+
+	de_broadphase_proxy_t* proxy = &body->proxy;
+	if (proxy->registered) {
+		if (memcmp(proxy->min, cells.min, sizeof(cells.min)) == 0 && memcmp(proxy->max, cells.max, sizeof(cells.max)) == 0) {
+			return false;
+		}
+		de_broadphase_remove_cells(bp, body);
+	} else {
+		proxy->registered = true;
+		proxy->order = bp->next_order++;
+		++bp->body_count;
+		if (bp->body_count > bp->bucket_count) {
+			de_broadphase_rehash(bp, 2 * bp->bucket_count);
+		}
+	}
+
+	memcpy(proxy->min, cells.min, sizeof(cells.min));
+	memcpy(proxy->max, cells.max, sizeof(cells.max));
+	proxy->large = de_broadphase_proxy_cell_count(proxy) > DE_BROADPHASE_MAX_BODY_CELLS;
+
+	de_broadphase_insert_cells(bp, body);
+	de_broadphase_grow_bounds(bp, proxy);
+
+	return true;
+}
+
+void de_broadphase_remove_body(de_broadphase_t* bp, de_body_t* body)
+{
+	DE_ASSERT(bp);
+	DE_ASSERT(body);
+	if (body->proxy.registered) {
+		de_broadphase_remove_cells(bp, body);
+		body->proxy.registered = false;
+		--bp->body_count;
+		if (!bp->body_count) {
+			bp->bounds_valid = false;
+		}
+	}
+}
+
+static int de_broadphase_order_comparer(const void* a, const void* b)
+{
+	const de_body_t* body_a = *(const de_body_t**)a;
+	const de_body_t* body_b = *(const de_body_t**)b;
+	if (body_a->proxy.order < body_b->proxy.order) {
+		return -1;
+	} else if (body_a->proxy.order > body_b->proxy.order) {
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Appends every body of array, duplicates are removed later - line query must not
+ * modify broadphase, so it can be done from many threads.
+ */
+static void de_broadphase_append_all(const de_body_array_t* array, de_body_array_t* candidates)
+{
+	for (size_t i = 0; i < array->size; ++i) {
+		DE_ARRAY_APPEND(*candidates, array->data[i]);
+	}
+}
+
+/**
+ * @brief Sorts candidates by order and removes duplicates.
+ */
+static void de_broadphase_sort_unique(de_body_array_t* candidates)
+{
+	DE_ARRAY_QSORT(*candidates, de_broadphase_order_comparer);
+	size_t count = 0;
+	for (size_t i = 0; i < candidates->size; ++i) {
+		if (!count || candidates->data[count - 1] != candidates->data[i]) {
+			candidates->data[count++] = candidates->data[i];
+		}
+	}
+	candidates->size = count;
+}
+
+void de_broadphase_query_pairs(const de_broadphase_t* bp, const de_body_t* body, const de_body_array_t* bodies, de_body_array_t* candidates)
+{
+	DE_ASSERT(bp);
+	DE_ASSERT(body);
+	DE_ASSERT(body->proxy.registered);
+
+	DE_ARRAY_CLEAR(*candidates);
+
+	const de_broadphase_proxy_t* proxy = &body->proxy;
+	if (proxy->large) {
+		/* large body is paired with every body after it */
+		DE_ASSERT(bodies->size > proxy->order && bodies->data[proxy->order] == body);
+		for (size_t i = proxy->order + 1; i < bodies->size; ++i) {
+			de_body_t* other = bodies->data[i];
+			if (de_broadphase_proxies_overlap(&other->proxy, proxy)) {
+				DE_ARRAY_APPEND(*candidates, other);
+			}
+		}
+		return;
+	}
+
+	for (int32_t z = proxy->min[2]; z <= proxy->max[2]; ++z) {
+		for (int32_t y = proxy->min[1]; y <= proxy->max[1]; ++y) {
+			for (int32_t x = proxy->min[0]; x <= proxy->max[0]; ++x) {
+				const de_body_array_t* bucket = &bp->buckets[de_broadphase_hash(bp, x, y, z)];
+				for (size_t i = 0; i < bucket->size; ++i) {
+					de_body_t* other = bucket->data[i];
+					/* bucket can contain bodies from other cells with same hash */
+					if (other->proxy.order > proxy->order && de_broadphase_proxies_overlap(&other->proxy, proxy)) {
+						DE_ARRAY_APPEND(*candidates, other);
+					}
+				}
+			}
+		}
+	}
+	/* pairs with large bodies before this body are reported by large bodies */
+	for (size_t i = 0; i < bp->large_bodies.size; ++i) {
+		de_body_t* other = bp->large_bodies.data[i];
+		if (other->proxy.order > proxy->order && de_broadphase_proxies_overlap(&other->proxy, proxy)) {
+			DE_ARRAY_APPEND(*candidates, other);
+		}
+	}
+
+	/* other body is met in every shared cell */
+	de_broadphase_sort_unique(candidates);
+}
+
+bool de_broadphase_query_overlaps(const de_broadphase_t* bp, const de_body_t* body, de_body_array_t* candidates)
+{
+	DE_ASSERT(bp);
+	DE_ASSERT(body);
+
+	DE_ARRAY_CLEAR(*candidates);
+
+	const de_broadphase_proxy_t* proxy = &body->proxy;
+	if (!proxy->registered) {
+		return true;
+	}
+	if (proxy->large) {
+		return false;
+	}
+
+	for (int32_t z = proxy->min[2]; z <= proxy->max[2]; ++z) {
+		for (int32_t y = proxy->min[1]; y <= proxy->max[1]; ++y) {
+			for (int32_t x = proxy->min[0]; x <= proxy->max[0]; ++x) {
+				const de_body_array_t* bucket = &bp->buckets[de_broadphase_hash(bp, x, y, z)];
+				for (size_t i = 0; i < bucket->size; ++i) {
+					de_body_t* other = bucket->data[i];
+					if (other != body && de_broadphase_proxies_overlap(&other->proxy, proxy)) {
+						DE_ARRAY_APPEND(*candidates, other);
+					}
+				}
+			}
+		}
+	}
+	for (size_t i = 0; i < bp->large_bodies.size; ++i) {
+		de_body_t* other = bp->large_bodies.data[i];
+		if (other != body && de_broadphase_proxies_overlap(&other->proxy, proxy)) {
+			DE_ARRAY_APPEND(*candidates, other);
+		}
+	}
+
+	de_broadphase_sort_unique(candidates);
+	return true;
+}
+
+bool de_broadphase_query_line(const de_broadphase_t* bp, const de_ray_t* ray, de_body_array_t* candidates)
+{
+	DE_ASSERT(bp);
+	DE_ASSERT(ray);
+
+	DE_ARRAY_CLEAR(*candidates);
+
+	de_broadphase_append_all(&bp->large_bodies, candidates);
+
+	if (!bp->bounds_valid) {
+		return true;
+	}
+
+	/* clip line by bounds of registered cells */
+	const float origin[3] = { ray->origin.x, ray->origin.y, ray->origin.z };
+	const float dir[3] = { ray->dir.x, ray->dir.y, ray->dir.z };
+	float t_min = -FLT_MAX;
+	float t_max = FLT_MAX;
+	for (int i = 0; i < 3; ++i) {
+		const float min = bp->bounds_min[i] * bp->cell_size;
+		const float max = (bp->bounds_max[i] + 1) * bp->cell_size;
+		if (dir[i] == 0.0f) {
+			if (origin[i] < min || origin[i] > max) {
+				de_broadphase_sort_unique(candidates);
+				return true;
+			}
+		} else {
+			float t0 = (min - origin[i]) / dir[i];
+			float t1 = (max - origin[i]) / dir[i];
+			if (t0 > t1) {
+				const float temp = t0;
+				t0 = t1;
+				t1 = temp;
+			}
+			t_min = de_maxf(t_min, t0);
+			t_max = de_minf(t_max, t1);
+		}
+	}
+	if (t_min > t_max) {
+		de_broadphase_sort_unique(candidates);
+		return true;
+	}
+
+	/* 3D-DDA over cells of clipped line */
+	int32_t cell[3], last[3], step[3];
+	float t_next[3], t_delta[3];
+	uint64_t cell_count = 1;
+	for (int i = 0; i < 3; ++i) {
+		cell[i] = de_broadphase_cell_coord(bp, origin[i] + dir[i] * t_min);
+		last[i] = de_broadphase_cell_coord(bp, origin[i] + dir[i] * t_max);
+		if (dir[i] > 0.0f) {
+			step[i] = 1;
+			t_delta[i] = bp->cell_size / dir[i];
+			t_next[i] = ((cell[i] + 1) * bp->cell_size - origin[i]) / dir[i];
+		} else if (dir[i] < 0.0f) {
+			step[i] = -1;
+			t_delta[i] = -bp->cell_size / dir[i];
+			t_next[i] = (cell[i] * bp->cell_size - origin[i]) / dir[i];
+		} else {
+			step[i] = 0;
+			t_delta[i] = FLT_MAX;
+			t_next[i] = FLT_MAX;
+		}
+		cell_count += (uint64_t)llabs((int64_t)last[i] - cell[i]);
+	}
+
+	if (cell_count > bp->body_count) {
+		return false;
+	}
+
+	for (uint64_t n = 0; n < cell_count; ++n) {
+		de_broadphase_append_all(&bp->buckets[de_broadphase_hash(bp, cell[0], cell[1], cell[2])], candidates);
+
+		/* step into next cell through closest boundary */
+		int axis = 0;
+		if (t_next[1] < t_next[axis]) {
+			axis = 1;
+		}
+		if (t_next[2] < t_next[axis]) {
+			axis = 2;
+		}
+		cell[axis] += step[axis];
+		t_next[axis] += t_delta[axis];
+	}
+
+	de_broadphase_sort_unique(candidates);
+
+	return true;
+}
+
+void de_physics_set_broadphase_cell_size(de_scene_t* scene, float cell_size)
+{
+	DE_ASSERT(scene);
+	DE_ASSERT(cell_size > 0.0f);
+	if (scene->broadphase) {
+		de_broadphase_free(scene->broadphase);
+	}
+	scene->broadphase = de_broadphase_create(cell_size);
+	/* register bodies again, in order of list */
+	DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
+	{
+		body->proxy.registered = false;
+		de_broadphase_update_body(scene->broadphase, body);
+	}
+}
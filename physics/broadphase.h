@@ -0,0 +1,112 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+/**
+ * Broadphase for bodies.
+ *
+ * Uniform spatial hash: each body is registered in every cell which is touched by its
+ * bounding box, cells are mapped into fixed-size array of buckets by hash of cell
+ * coordinates. Registration is updated incrementally - only when body moves into another
+ * set of cells - so hash is maintained across physics steps.
+ *
+ * Candidates are always returned in order of bodies in scene, so results of queries do not
+ * depend on layout of hash. Queries do not modify broadphase and can be done from many threads.
+ */
+
+#define DE_BROADPHASE_DEFAULT_CELL_SIZE (2.0f)
+
+/**
+ * @brief Per-body broadphase data. Fully internal.
+ */
+typedef struct de_broadphase_proxy_t {
+	int32_t min[3];  /**< Min cell coordinates */
+	int32_t max[3];  /**< Max cell coordinates */
+	uint32_t order;  /**< Index of body in list of bodies of scene, used to keep order of pairs */
+	uint32_t stamp;  /**< Stamp of last rehash that visited body, used to skip duplicates */
+	bool registered;
+	bool large;      /**< Body is too large for cells and stored separately */
+} de_broadphase_proxy_t;
+
+typedef DE_ARRAY_DECLARE(de_body_t*, de_body_array_t);
+
+struct de_broadphase_t {
+	float cell_size;
+	float inv_cell_size;
+	de_body_array_t* buckets; /**< Array of buckets, count is always power of two */
+	size_t bucket_count;
+	size_t body_count;        /**< Count of registered bodies */
+	de_body_array_t large_bodies;
+	uint32_t stamp;
+	uint32_t next_order;
+	bool bounds_valid;
+	int32_t bounds_min[3];    /**< Bounds of all registered cells, used to clip rays */
+	int32_t bounds_max[3];
+};
+
+/**
+ * @brief Creates empty broadphase with given cell size. Internal.
+ */
+de_broadphase_t* de_broadphase_create(float cell_size);
+
+/**
+ * @brief Frees broadphase. Bodies are not freed. Internal.
+ */
+void de_broadphase_free(de_broadphase_t* bp);
+
+/**
+ * @brief Registers body in cells touched by its bounds, or moves it into new cells.
+ * Returns true if set of cells of body was changed. Internal.
+ */
+bool de_broadphase_update_body(de_broadphase_t* bp, de_body_t* body);
+
+/**
+ * @brief Unregisters body. Internal.
+ */
+void de_broadphase_remove_body(de_broadphase_t* bp, de_body_t* body);
+
+/**
+ * @brief Collects bodies with order greater than order of given body, which can intersect with
+ * it. This way every pair of bodies is reported exactly once. Bodies must contain every registered
+ * body at index equal to its order, it is used to pair large bodies. Candidates are sorted by order.
+ * Does not modify broadphase, so can be used from many threads simultaneously. Internal.
+ */
+void de_broadphase_query_pairs(const de_broadphase_t* bp, const de_body_t* body, const de_body_array_t* bodies, de_body_array_t* candidates);
+
+/**
+ * @brief Collects bodies (except given one) which cells overlap cells of body, in any order
+ * relative to it. Candidates are sorted by order. Returns false for large bodies, in this case
+ * caller should check every body. Does not modify broadphase. Internal.
+ */
+bool de_broadphase_query_overlaps(const de_broadphase_t* bp, const de_body_t* body, de_body_array_t* candidates);
+
+/**
+ * @brief Collects bodies that can intersect with line that goes through ray (in both directions,
+ * as de_ray_sphere_intersection does). Candidates are sorted by order. Returns false if line
+ * crosses more cells than there are bodies, in this case caller should check every body. Does not
+ * modify broadphase, so can be used from many threads simultaneously. Internal.
+ */
+bool de_broadphase_query_line(const de_broadphase_t* bp, const de_ray_t* ray, de_body_array_t* candidates);
+
+/**
+ * @brief Changes cell size of broadphase of scene. Larger cells are better for large bodies,
+ * smaller cells are better for dense crowds of small bodies.
+ */
+void de_physics_set_broadphase_cell_size(de_scene_t* scene, float cell_size);
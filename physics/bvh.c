@@ -0,0 +1,840 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+#define DE_BVH_BIN_COUNT (12)
+#define DE_BVH_MIN_PARALLEL_TRIANGLES (4096)
+
+/**
+ * @brief Bounds and center of primitive used during build.
+ */
+typedef struct de_bvh_ref_t {
+	de_vec3_t min;
+	de_vec3_t max;
+	de_vec3_t center;
+} de_bvh_ref_t;
+
+/**
+ * @brief Temporary node, children are referenced explicitly.
+ */
+typedef struct de_bvh_build_node_t {
+	de_vec3_t min;
+	de_vec3_t max;
+	uint32_t left;
+	uint32_t right;
+	uint32_t begin;
+	uint32_t count; /**< Zero for branch */
+} de_bvh_build_node_t;
+
+/**
+ * @brief Subtree that is built on worker thread.
+ */
+typedef struct de_bvh_build_task_t {
+	uint32_t node;
+	uint32_t begin;
+	uint32_t end;
+	uint32_t depth;
+	uint32_t node_count;  /**< Count of nodes in subtree, filled by task */
+	uint32_t leaf_count;  /**< Filled by task */
+	uint32_t max_depth;   /**< Filled by task */
+} de_bvh_build_task_t;
+
+typedef struct de_bvh_builder_t {
+	const de_bvh_ref_t* refs;
+	uint32_t* indices;
+	uint32_t max_leaf;
+	uint32_t task_threshold;
+	DE_ARRAY_DECLARE(de_bvh_build_node_t, nodes);
+	DE_ARRAY_DECLARE(de_bvh_build_task_t, tasks);
+} de_bvh_builder_t;
+
+typedef struct de_bvh_bin_t {
+	de_vec3_t min;
+	de_vec3_t max;
+	uint32_t count;
+} de_bvh_bin_t;
+
+static float de_bvh_surface_area(const de_vec3_t* min, const de_vec3_t* max)
+{
+	const float dx = max->x - min->x;
+	const float dy = max->y - min->y;
+	const float dz = max->z - min->z;
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+static float de_bvh_axis(const de_vec3_t* v, int axis)
+{
+	return axis == 0 ? v->x : (axis == 1 ? v->y : v->z);
+}
+
+static void de_bvh_invalidate_bounds(de_vec3_t* min, de_vec3_t* max)
+{
+	*min = (de_vec3_t) { FLT_MAX, FLT_MAX, FLT_MAX };
+	*max = (de_vec3_t) { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+}
+
+static void de_bvh_merge_bounds(de_vec3_t* min, de_vec3_t* max, const de_vec3_t* other_min, const de_vec3_t* other_max)
+{
+	de_vec3_min_max(other_min, min, max);
+	de_vec3_min_max(other_max, min, max);
+}
+
+/**
+ * @brief Splits range of triangles using binned SAH. Returns index of first triangle of right
+ * part or end if range should become leaf. Writes bounds of range.
+ */
+static uint32_t de_bvh_split(const de_bvh_builder_t* b, uint32_t begin, uint32_t end, uint32_t depth, de_vec3_t* min, de_vec3_t* max)
+{
+	const uint32_t count = end - begin;
+
+	de_vec3_t cmin, cmax;
+	de_bvh_invalidate_bounds(min, max);
+	de_bvh_invalidate_bounds(&cmin, &cmax);
+	for (uint32_t i = begin; i < end; ++i) {
+		const de_bvh_ref_t* ref = b->refs + b->indices[i];
+		de_bvh_merge_bounds(min, max, &ref->min, &ref->max);
+		de_vec3_min_max(&ref->center, &cmin, &cmax);
+	}
+
+	if (count <= 2 || depth >= DE_BVH_MAX_DEPTH) {
+		return end;
+	}
+
+	/* find best split among all axes */
+	int best_axis = -1;
+	int best_bin = 0;
+	float best_cost = FLT_MAX;
+	for (int axis = 0; axis < 3; ++axis) {
+		const float axis_min = de_bvh_axis(&cmin, axis);
+		const float extent = de_bvh_axis(&cmax, axis) - axis_min;
+		if (extent <= 0.0f) {
+			continue;
+		}
+		const float scale = DE_BVH_BIN_COUNT / extent;
+
+		de_bvh_bin_t bins[DE_BVH_BIN_COUNT];
+		for (int i = 0; i < DE_BVH_BIN_COUNT; ++i) {
+			de_bvh_invalidate_bounds(&bins[i].min, &bins[i].max);
+			bins[i].count = 0;
+		}
+		for (uint32_t i = begin; i < end; ++i) {
+			const de_bvh_ref_t* ref = b->refs + b->indices[i];
+			int bin = (int)((de_bvh_axis(&ref->center, axis) - axis_min) * scale);
+			if (bin >= DE_BVH_BIN_COUNT) {
+				bin = DE_BVH_BIN_COUNT - 1;
+			}
+			de_bvh_merge_bounds(&bins[bin].min, &bins[bin].max, &ref->min, &ref->max);
+			++bins[bin].count;
+		}
+
+		/* sweep from right to get cost of right parts, then from left */
+		float right_cost[DE_BVH_BIN_COUNT];
+		de_vec3_t rmin, rmax;
+		de_bvh_invalidate_bounds(&rmin, &rmax);
+		uint32_t right_count = 0;
+		for (int i = DE_BVH_BIN_COUNT - 1; i > 0; --i) {
+			if (bins[i].count) {
+				de_bvh_merge_bounds(&rmin, &rmax, &bins[i].min, &bins[i].max);
+				right_count += bins[i].count;
+			}
+			right_cost[i] = right_count ? right_count * de_bvh_surface_area(&rmin, &rmax) : 0.0f;
+		}
+		de_vec3_t lmin, lmax;
+		de_bvh_invalidate_bounds(&lmin, &lmax);
+		uint32_t left_count = 0;
+		for (int i = 0; i < DE_BVH_BIN_COUNT - 1; ++i) {
+			if (bins[i].count) {
+				de_bvh_merge_bounds(&lmin, &lmax, &bins[i].min, &bins[i].max);
+				left_count += bins[i].count;
+			}
+			if (left_count == 0 || left_count == count) {
+				continue;
+			}
+			const float cost = left_count * de_bvh_surface_area(&lmin, &lmax) + right_cost[i + 1];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = i;
+			}
+		}
+	}
+
+	if (best_axis < 0) {
+		/* all centers are in one point, split by half if range is too big */
+		return count > b->max_leaf ? begin + count / 2 : end;
+	}
+
+	/* traversal is considered as expensive as one triangle test */
+	const float area = de_bvh_surface_area(min, max);
+	const float split_cost = 1.0f + (area > 0.0f ? best_cost / area : (float)count);
+	if (split_cost >= count && count <= b->max_leaf) {
+		return end;
+	}
+
+	/* partition indices by chosen plane */
+	const float axis_min = de_bvh_axis(&cmin, best_axis);
+	const float scale = DE_BVH_BIN_COUNT / (de_bvh_axis(&cmax, best_axis) - axis_min);
+	uint32_t i = begin;
+	uint32_t j = end;
+	while (i < j) {
+		const de_bvh_ref_t* ref = b->refs + b->indices[i];
+		int bin = (int)((de_bvh_axis(&ref->center, best_axis) - axis_min) * scale);
+		if (bin >= DE_BVH_BIN_COUNT) {
+			bin = DE_BVH_BIN_COUNT - 1;
+		}
+		if (bin <= best_bin) {
+			++i;
+		} else {
+			--j;
+			const uint32_t temp = b->indices[i];
+			b->indices[i] = b->indices[j];
+			b->indices[j] = temp;
+		}
+	}
+	return i;
+}
+
+static void de_bvh_make_node(de_bvh_build_node_t* node, const de_vec3_t* min, const de_vec3_t* max, uint32_t begin, uint32_t count)
+{
+	node->min = *min;
+	node->max = *max;
+	node->begin = begin;
+	node->count = count;
+	node->left = 0;
+	node->right = 0;
+}
+
+/**
+ * @brief Builds subtree with root at specified node. Children are allocated from region of
+ * subtree: range [begin; end) never needs more than 2 * (end - begin) nodes, so regions of
+ * different subtrees do not overlap and they can be built simultaneously.
+ */
+static void de_bvh_build_subtree(de_bvh_builder_t* b, de_bvh_build_task_t* task, uint32_t node_index,
+	uint32_t begin, uint32_t end, uint32_t depth, uint32_t* next)
+{
+	de_vec3_t min, max;
+	const uint32_t mid = de_bvh_split(b, begin, end, depth, &min, &max);
+
+	++task->node_count;
+	if (depth > task->max_depth) {
+		task->max_depth = depth;
+	}
+
+	de_bvh_build_node_t* node = b->nodes.data + node_index;
+	if (mid == end) {
+		de_bvh_make_node(node, &min, &max, begin, end - begin);
+		++task->leaf_count;
+	} else {
+		de_bvh_make_node(node, &min, &max, begin, 0);
+		node->left = (*next)++;
+		node->right = (*next)++;
+		de_bvh_build_subtree(b, task, node->left, begin, mid, depth + 1, next);
+		de_bvh_build_subtree(b, task, node->right, mid, end, depth + 1, next);
+	}
+}
+
+static void de_bvh_build_task(void* arg, size_t index)
+{
+	de_bvh_builder_t* b = arg;
+	de_bvh_build_task_t* task = b->tasks.data + index;
+	uint32_t next = 2 * task->begin;
+	de_bvh_build_subtree(b, task, task->node, task->begin, task->end, task->depth, &next);
+}
+
+/**
+ * @brief Splits top levels of tree on calling thread until ranges are small enough to become
+ * tasks. Top nodes are allocated after regions of subtrees. Returns count of top branches.
+ */
+static uint32_t de_bvh_build_top(de_bvh_builder_t* b, uint32_t node_index, uint32_t begin, uint32_t end, uint32_t depth)
+{
+	if (end - begin > b->task_threshold) {
+		de_vec3_t min, max;
+		const uint32_t mid = de_bvh_split(b, begin, end, depth, &min, &max);
+		if (mid != end) {
+			const uint32_t left = b->nodes.size;
+			DE_ARRAY_GROW(b->nodes, 2);
+			de_bvh_build_node_t* node = b->nodes.data + node_index;
+			de_bvh_make_node(node, &min, &max, begin, 0);
+			node->left = left;
+			node->right = left + 1;
+			return 1 + de_bvh_build_top(b, left, begin, mid, depth + 1) + de_bvh_build_top(b, left + 1, mid, end, depth + 1);
+		}
+	}
+	de_bvh_build_task_t* task = DE_ARRAY_GROW(b->tasks, 1);
+	memset(task, 0, sizeof(*task));
+	task->node = node_index;
+	task->begin = begin;
+	task->end = end;
+	task->depth = depth;
+	return 0;
+}
+
+/**
+ * @brief Writes nodes in depth-first order, left child follows parent.
+ */
+static uint32_t de_bvh_flatten(const de_bvh_builder_t* b, uint32_t index, de_bvh_t* bvh)
+{
+	const de_bvh_build_node_t* src = b->nodes.data + index;
+	const uint32_t out = bvh->node_count++;
+	de_bvh_node_t* dst = bvh->nodes + out;
+	dst->min = src->min;
+	dst->max = src->max;
+	dst->count = src->count;
+	if (src->count) {
+		dst->offset = src->begin;
+	} else {
+		de_bvh_flatten(b, src->left, bvh);
+		/* array is not reallocated, so pointer is still valid */
+		dst->offset = de_bvh_flatten(b, src->right, bvh);
+	}
+	return out;
+}
+
+/**
+ * @brief Builds tree over prepared references, bvh must be empty.
+ */
+static void de_bvh_build_refs(de_bvh_t* bvh, const de_bvh_ref_t* refs, uint32_t count, size_t max_leaf, de_thread_pool_t* pool)
+{
+	bvh->indices = de_malloc(count * sizeof(*bvh->indices));
+	bvh->index_count = count;
+	for (uint32_t i = 0; i < count; ++i) {
+		bvh->indices[i] = i;
+	}
+
+	de_bvh_builder_t b;
+	b.refs = refs;
+	b.indices = bvh->indices;
+	b.max_leaf = (uint32_t)max_leaf;
+	DE_ARRAY_INIT(b.nodes);
+	DE_ARRAY_INIT(b.tasks);
+
+	/* split into roughly four tasks per thread, small trees are built serially */
+	const size_t thread_count = pool ? de_thread_pool_get_worker_count(pool) + 1 : 1;
+	b.task_threshold = count;
+	if (thread_count > 1 && count >= DE_BVH_MIN_PARALLEL_TRIANGLES) {
+		b.task_threshold = (uint32_t)(count / (4 * thread_count));
+		if (b.task_threshold < DE_BVH_MIN_PARALLEL_TRIANGLES / 4) {
+			b.task_threshold = DE_BVH_MIN_PARALLEL_TRIANGLES / 4;
+		}
+	}
+
+	/* regions of subtrees go first, then root and other top nodes */
+	DE_ARRAY_GROW(b.nodes, 2 * count + 1);
+	const uint32_t root = 2 * count;
+	const uint32_t top_branches = de_bvh_build_top(&b, root, 0, count, 0);
+
+	de_thread_pool_parallel_for(pool, b.tasks.size, de_bvh_build_task, &b);
+
+	bvh->node_count = top_branches;
+	bvh->leaf_count = 0;
+	for (size_t i = 0; i < b.tasks.size; ++i) {
+		const de_bvh_build_task_t* task = b.tasks.data + i;
+		bvh->node_count += task->node_count;
+		bvh->leaf_count += task->leaf_count;
+		if (task->max_depth > bvh->depth) {
+			bvh->depth = task->max_depth;
+		}
+	}
+
+	bvh->nodes = de_malloc(bvh->node_count * sizeof(*bvh->nodes));
+	const uint32_t node_count = bvh->node_count;
+	bvh->node_count = 0;
+	de_bvh_flatten(&b, root, bvh);
+	DE_ASSERT(bvh->node_count == node_count);
+
+	DE_ARRAY_FREE(b.nodes);
+	DE_ARRAY_FREE(b.tasks);
+}
+
+de_bvh_t* de_bvh_build(const void* src_triangles, size_t triangle_count, int pos_stride, size_t max_triangles_per_leaf, de_thread_pool_t* pool)
+{
+	DE_ASSERT(max_triangles_per_leaf > 0);
+	DE_ASSERT(triangle_count < UINT32_MAX / 4);
+
+	de_bvh_t* bvh = DE_NEW(de_bvh_t);
+	if (!triangle_count) {
+		return bvh;
+	}
+
+	const uint32_t count = (uint32_t)triangle_count;
+	de_bvh_ref_t* refs = de_malloc(count * sizeof(*refs));
+	for (uint32_t i = 0; i < count; ++i) {
+		de_bvh_ref_t* ref = refs + i;
+		const de_vec3_t* v = (const de_vec3_t*)((const char*)src_triangles + i * pos_stride);
+		de_bvh_invalidate_bounds(&ref->min, &ref->max);
+		de_vec3_min_max(v, &ref->min, &ref->max);
+		de_vec3_min_max(v + 1, &ref->min, &ref->max);
+		de_vec3_min_max(v + 2, &ref->min, &ref->max);
+		de_vec3_middle(&ref->center, &ref->min, &ref->max);
+	}
+	de_bvh_build_refs(bvh, refs, count, max_triangles_per_leaf, pool);
+	de_free(refs);
+
+	return bvh;
+}
+
+de_bvh_t* de_bvh_build_from_bounds(const de_vec3_t* min, const de_vec3_t* max, size_t count, size_t max_primitives_per_leaf, de_thread_pool_t* pool)
+{
+	DE_ASSERT(min || !count);
+	DE_ASSERT(max || !count);
+	DE_ASSERT(max_primitives_per_leaf > 0);
+	DE_ASSERT(count < UINT32_MAX / 4);
+
+	de_bvh_t* bvh = DE_NEW(de_bvh_t);
+	if (!count) {
+		return bvh;
+	}
+
+	de_bvh_ref_t* refs = de_malloc(count * sizeof(*refs));
+	for (size_t i = 0; i < count; ++i) {
+		de_bvh_ref_t* ref = refs + i;
+		ref->min = min[i];
+		ref->max = max[i];
+		de_vec3_middle(&ref->center, &ref->min, &ref->max);
+	}
+	de_bvh_build_refs(bvh, refs, (uint32_t)count, max_primitives_per_leaf, pool);
+	de_free(refs);
+
+	return bvh;
+}
+
+void de_bvh_refit(de_bvh_t* bvh, const de_vec3_t* min, const de_vec3_t* max)
+{
+	DE_ASSERT(bvh);
+	DE_ASSERT(min || !bvh->node_count);
+	DE_ASSERT(max || !bvh->node_count);
+
+	/* children always have larger indices than their parent, so backward pass goes bottom-up */
+	for (uint32_t i = bvh->node_count; i-- > 0;) {
+		de_bvh_node_t* node = bvh->nodes + i;
+		de_bvh_invalidate_bounds(&node->min, &node->max);
+		if (node->count) {
+			for (uint32_t k = 0; k < node->count; ++k) {
+				const uint32_t index = bvh->indices[node->offset + k];
+				de_bvh_merge_bounds(&node->min, &node->max, min + index, max + index);
+			}
+		} else {
+			const de_bvh_node_t* left = bvh->nodes + i + 1;
+			const de_bvh_node_t* right = bvh->nodes + node->offset;
+			de_bvh_merge_bounds(&node->min, &node->max, &left->min, &left->max);
+			de_bvh_merge_bounds(&node->min, &node->max, &right->min, &right->max);
+		}
+	}
+}
+
+void de_bvh_free(de_bvh_t* bvh)
+{
+	if (bvh) {
+		de_free(bvh->nodes);
+		de_free(bvh->indices);
+		de_free(bvh);
+	}
+}
+
+void de_bvh_query_init(de_bvh_query_t* query)
+{
+	DE_ASSERT(query);
+	memset(query, 0, sizeof(*query));
+}
+
+void de_bvh_query_reserve(de_bvh_query_t* query, const de_bvh_t* bvh)
+{
+	DE_ASSERT(query);
+	DE_ASSERT(bvh);
+	if (query->capacity < bvh->leaf_count) {
+		query->capacity = bvh->leaf_count;
+		query->leafs = de_realloc(query->leafs, query->capacity * sizeof(*query->leafs));
+	}
+}
+
+void de_bvh_query_free(de_bvh_query_t* query)
+{
+	DE_ASSERT(query);
+	de_free(query->leafs);
+	de_bvh_query_init(query);
+}
+
+bool de_bvh_node_intersects_sphere(const de_bvh_node_t* node, const de_vec3_t* position, float radius)
+{
+	float d = 0.0f;
+	if (position->x < node->min.x) {
+		d += de_sqr(position->x - node->min.x);
+	} else if (position->x > node->max.x) {
+		d += de_sqr(position->x - node->max.x);
+	}
+	if (position->y < node->min.y) {
+		d += de_sqr(position->y - node->min.y);
+	} else if (position->y > node->max.y) {
+		d += de_sqr(position->y - node->max.y);
+	}
+	if (position->z < node->min.z) {
+		d += de_sqr(position->z - node->min.z);
+	} else if (position->z > node->max.z) {
+		d += de_sqr(position->z - node->max.z);
+	}
+	return d <= radius * radius;
+}
+
+void de_bvh_query_sphere(const de_bvh_t* bvh, de_bvh_query_t* query, const de_vec3_t* position, float radius)
+{
+	DE_ASSERT(query->capacity >= bvh->leaf_count);
+	query->size = 0;
+	if (!bvh->node_count) {
+		return;
+	}
+	uint32_t stack[DE_BVH_MAX_DEPTH + 1];
+	int top = 0;
+	uint32_t index = 0;
+	while (true) {
+		const de_bvh_node_t* node = bvh->nodes + index;
+		if (de_bvh_node_intersects_sphere(node, position, radius)) {
+			if (node->count) {
+				query->leafs[query->size++] = index;
+			} else {
+				stack[top++] = node->offset;
+				++index;
+				continue;
+			}
+		}
+		if (!top) {
+			break;
+		}
+		index = stack[--top];
+	}
+}
+
+/**
+ * @brief Ray-box slab test. Unlike de_ray_aabb_intersection, components of ray direction can be
+ * zero - flat nodes of BVH are very common, and division by zero would give NaN on their faces.
+ */
+static bool de_bvh_node_intersects_ray(const de_bvh_node_t* node, const de_ray_t* ray, const de_vec3_t* inv_dir, float* out_tmin)
+{
+	const float origin[3] = { ray->origin.x, ray->origin.y, ray->origin.z };
+	const float dir[3] = { ray->dir.x, ray->dir.y, ray->dir.z };
+	const float inv[3] = { inv_dir->x, inv_dir->y, inv_dir->z };
+	const float min[3] = { node->min.x, node->min.y, node->min.z };
+	const float max[3] = { node->max.x, node->max.y, node->max.z };
+	float tmin = -FLT_MAX;
+	float tmax = FLT_MAX;
+	for (int i = 0; i < 3; ++i) {
+		if (dir[i] == 0.0f) {
+			if (origin[i] < min[i] || origin[i] > max[i]) {
+				return false;
+			}
+		} else {
+			float t0 = (min[i] - origin[i]) * inv[i];
+			float t1 = (max[i] - origin[i]) * inv[i];
+			if (t0 > t1) {
+				const float temp = t0;
+				t0 = t1;
+				t1 = temp;
+			}
+			if (t0 > tmin) {
+				tmin = t0;
+			}
+			if (t1 < tmax) {
+				tmax = t1;
+			}
+		}
+	}
+	if (out_tmin) {
+		*out_tmin = tmin;
+	}
+	return tmin <= tmax && tmin < 1.0f && tmax > 0.0f;
+}
+
+static void de_bvh_inverse_dir(const de_ray_t* ray, de_vec3_t* inv_dir)
+{
+	inv_dir->x = ray->dir.x != 0.0f ? 1.0f / ray->dir.x : 0.0f;
+	inv_dir->y = ray->dir.y != 0.0f ? 1.0f / ray->dir.y : 0.0f;
+	inv_dir->z = ray->dir.z != 0.0f ? 1.0f / ray->dir.z : 0.0f;
+}
+
+void de_bvh_query_ray(const de_bvh_t* bvh, de_bvh_query_t* query, const de_ray_t* ray)
+{
+	DE_ASSERT(query->capacity >= bvh->leaf_count);
+	query->size = 0;
+	if (!bvh->node_count) {
+		return;
+	}
+	de_vec3_t inv_dir;
+	de_bvh_inverse_dir(ray, &inv_dir);
+	uint32_t stack[DE_BVH_MAX_DEPTH + 1];
+	int top = 0;
+	uint32_t index = 0;
+	while (true) {
+		const de_bvh_node_t* node = bvh->nodes + index;
+		if (de_bvh_node_intersects_ray(node, ray, &inv_dir, NULL)) {
+			if (node->count) {
+				query->leafs[query->size++] = index;
+			} else {
+				stack[top++] = node->offset;
+				++index;
+				continue;
+			}
+		}
+		if (!top) {
+			break;
+		}
+		index = stack[--top];
+	}
+}
+
+/**
+ * @brief Square distance from ray origin to point where ray enters node.
+ */
+static float de_bvh_entry_sqr_distance(float tmin, float dir_sqr_len)
+{
+	return tmin > 0.0f ? tmin * tmin * dir_sqr_len : 0.0f;
+}
+
+void de_bvh_traverse_ray_ordered(const de_bvh_t* bvh, const de_ray_t* ray, float* max_sqr_distance, de_bvh_ray_leaf_func_t func, void* user_data)
+{
+	DE_ASSERT(bvh);
+	DE_ASSERT(max_sqr_distance);
+	DE_ASSERT(func);
+
+	if (!bvh->node_count) {
+		return;
+	}
+
+	de_vec3_t inv_dir;
+	de_bvh_inverse_dir(ray, &inv_dir);
+	const float dir_sqr_len = de_vec3_sqr_len(&ray->dir);
+
+	float tmin;
+	if (!de_bvh_node_intersects_ray(bvh->nodes, ray, &inv_dir, &tmin)) {
+		return;
+	}
+
+	/* far children are deferred together with their entry distances */
+	struct {
+		uint32_t index;
+		float sqr_distance;
+	} stack[DE_BVH_MAX_DEPTH + 1];
+	int top = 0;
+	uint32_t index = 0;
+	while (true) {
+		const de_bvh_node_t* node = bvh->nodes + index;
+		if (node->count) {
+			if (func(user_data, bvh, node, max_sqr_distance)) {
+				return;
+			}
+		} else {
+			const uint32_t left = index + 1;
+			const uint32_t right = node->offset;
+			float left_tmin, right_tmin;
+			const bool left_hit = de_bvh_node_intersects_ray(bvh->nodes + left, ray, &inv_dir, &left_tmin);
+			const bool right_hit = de_bvh_node_intersects_ray(bvh->nodes + right, ray, &inv_dir, &right_tmin);
+			const float left_distance = de_bvh_entry_sqr_distance(left_tmin, dir_sqr_len);
+			const float right_distance = de_bvh_entry_sqr_distance(right_tmin, dir_sqr_len);
+			const bool visit_left = left_hit && left_distance <= *max_sqr_distance;
+			const bool visit_right = right_hit && right_distance <= *max_sqr_distance;
+			if (visit_left && visit_right) {
+				if (left_distance <= right_distance) {
+					stack[top].index = right;
+					stack[top].sqr_distance = right_distance;
+					index = left;
+				} else {
+					stack[top].index = left;
+					stack[top].sqr_distance = left_distance;
+					index = right;
+				}
+				++top;
+				continue;
+			} else if (visit_left) {
+				index = left;
+				continue;
+			} else if (visit_right) {
+				index = right;
+				continue;
+			}
+		}
+
+		/* pop next node which is still closer than closest hit */
+		do {
+			if (!top) {
+				return;
+			}
+			--top;
+		} while (stack[top].sqr_distance > *max_sqr_distance);
+		index = stack[top].index;
+	}
+}
+
+bool de_bvh_ray_packet_is_coherent(const de_ray_t* ray, int* octant)
+{
+	/* tiny components would give infinite inverse direction and NaN in slab test */
+	const float eps = 1e-20f;
+	if (fabsf(ray->dir.x) < eps || fabsf(ray->dir.y) < eps || fabsf(ray->dir.z) < eps) {
+		return false;
+	}
+	if (octant) {
+		*octant = (ray->dir.x < 0.0f ? 1 : 0) | (ray->dir.y < 0.0f ? 2 : 0) | (ray->dir.z < 0.0f ? 4 : 0);
+	}
+	return true;
+}
+
+void de_bvh_ray_packet_set(de_bvh_ray_packet_t* packet, const de_ray_t* const rays[DE_BVH_PACKET_SIZE])
+{
+	for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+		const de_ray_t* ray = rays[i];
+		de_vec3_t inv_dir;
+		de_bvh_inverse_dir(ray, &inv_dir);
+		packet->origin_x[i] = ray->origin.x;
+		packet->origin_y[i] = ray->origin.y;
+		packet->origin_z[i] = ray->origin.z;
+		packet->dir_x[i] = ray->dir.x;
+		packet->dir_y[i] = ray->dir.y;
+		packet->dir_z[i] = ray->dir.z;
+		packet->inv_dir_x[i] = inv_dir.x;
+		packet->inv_dir_y[i] = inv_dir.y;
+		packet->inv_dir_z[i] = inv_dir.z;
+		packet->dir_sqr_len[i] = de_vec3_sqr_len(&ray->dir);
+	}
+}
+
+/**
+ * @brief Tests node against every ray of packet. Returns mask of rays which intersect node
+ * not farther than their closest hits, writes entry square distances. Performs exactly same
+ * operations as de_bvh_node_intersects_ray + de_bvh_entry_sqr_distance.
+ */
+static int de_bvh_packet_test_node(const de_bvh_node_t* node, const de_bvh_ray_packet_t* p, float* entry_sqr_distance)
+{
+#if DE_SSE
+	__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->min.x), _mm_loadu_ps(p->origin_x)), _mm_loadu_ps(p->inv_dir_x));
+	__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->max.x), _mm_loadu_ps(p->origin_x)), _mm_loadu_ps(p->inv_dir_x));
+	__m128 tmin = _mm_max_ps(_mm_set1_ps(-FLT_MAX), _mm_min_ps(t0, t1));
+	__m128 tmax = _mm_min_ps(_mm_set1_ps(FLT_MAX), _mm_max_ps(t0, t1));
+	t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->min.y), _mm_loadu_ps(p->origin_y)), _mm_loadu_ps(p->inv_dir_y));
+	t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->max.y), _mm_loadu_ps(p->origin_y)), _mm_loadu_ps(p->inv_dir_y));
+	tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1));
+	tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+	t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->min.z), _mm_loadu_ps(p->origin_z)), _mm_loadu_ps(p->inv_dir_z));
+	t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->max.z), _mm_loadu_ps(p->origin_z)), _mm_loadu_ps(p->inv_dir_z));
+	tmin = _mm_max_ps(tmin, _mm_min_ps(t0, t1));
+	tmax = _mm_min_ps(tmax, _mm_max_ps(t0, t1));
+	const __m128 entry = _mm_max_ps(tmin, _mm_setzero_ps());
+	const __m128 distance = _mm_mul_ps(_mm_mul_ps(entry, entry), _mm_loadu_ps(p->dir_sqr_len));
+	__m128 hit = _mm_cmple_ps(tmin, tmax);
+	hit = _mm_and_ps(hit, _mm_cmplt_ps(tmin, _mm_set1_ps(1.0f)));
+	hit = _mm_and_ps(hit, _mm_cmpgt_ps(tmax, _mm_setzero_ps()));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(distance, _mm_loadu_ps(p->max_sqr_distance)));
+	_mm_storeu_ps(entry_sqr_distance, distance);
+	return _mm_movemask_ps(hit);
+#else
+	int mask = 0;
+	for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+		const float x0 = (node->min.x - p->origin_x[i]) * p->inv_dir_x[i];
+		const float x1 = (node->max.x - p->origin_x[i]) * p->inv_dir_x[i];
+		const float y0 = (node->min.y - p->origin_y[i]) * p->inv_dir_y[i];
+		const float y1 = (node->max.y - p->origin_y[i]) * p->inv_dir_y[i];
+		const float z0 = (node->min.z - p->origin_z[i]) * p->inv_dir_z[i];
+		const float z1 = (node->max.z - p->origin_z[i]) * p->inv_dir_z[i];
+		const float tmin = de_maxf(de_maxf(de_maxf(-FLT_MAX, de_minf(x0, x1)), de_minf(y0, y1)), de_minf(z0, z1));
+		const float tmax = de_minf(de_minf(de_minf(FLT_MAX, de_maxf(x0, x1)), de_maxf(y0, y1)), de_maxf(z0, z1));
+		entry_sqr_distance[i] = de_bvh_entry_sqr_distance(tmin, p->dir_sqr_len[i]);
+		if (tmin <= tmax && tmin < 1.0f && tmax > 0.0f && entry_sqr_distance[i] <= p->max_sqr_distance[i]) {
+			mask |= 1 << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+/**
+ * @brief Smallest entry distance among rays of mask, used to visit closer child first.
+ */
+static float de_bvh_packet_min_entry(const float* entry_sqr_distance, int mask)
+{
+	float min = FLT_MAX;
+	for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+		if ((mask & (1 << i)) && entry_sqr_distance[i] < min) {
+			min = entry_sqr_distance[i];
+		}
+	}
+	return min;
+}
+
+void de_bvh_traverse_ray_packet(const de_bvh_t* bvh, de_bvh_ray_packet_t* packet, int mask, de_bvh_packet_leaf_func_t func, void* user_data)
+{
+	DE_ASSERT(bvh);
+	DE_ASSERT(packet);
+	DE_ASSERT(func);
+
+	if (!bvh->node_count || !mask) {
+		return;
+	}
+
+	float entry[DE_BVH_PACKET_SIZE];
+	int node_mask = de_bvh_packet_test_node(bvh->nodes, packet, entry) & mask;
+	if (!node_mask) {
+		return;
+	}
+
+	/* far children are tested again when they are popped - closest hits could change */
+	uint32_t stack[DE_BVH_MAX_DEPTH + 1];
+	int top = 0;
+	uint32_t index = 0;
+	while (true) {
+		const de_bvh_node_t* node = bvh->nodes + index;
+		if (node->count) {
+			mask &= ~func(user_data, bvh, node, packet, node_mask);
+			if (!mask) {
+				return;
+			}
+		} else {
+			const uint32_t left = index + 1;
+			const uint32_t right = node->offset;
+			float left_entry[DE_BVH_PACKET_SIZE], right_entry[DE_BVH_PACKET_SIZE];
+			const int left_mask = de_bvh_packet_test_node(bvh->nodes + left, packet, left_entry) & mask;
+			const int right_mask = de_bvh_packet_test_node(bvh->nodes + right, packet, right_entry) & mask;
+			if (left_mask && right_mask) {
+				if (de_bvh_packet_min_entry(left_entry, left_mask) <= de_bvh_packet_min_entry(right_entry, right_mask)) {
+					stack[top++] = right;
+					index = left;
+					node_mask = left_mask;
+				} else {
+					stack[top++] = left;
+					index = right;
+					node_mask = right_mask;
+				}
+				continue;
+			} else if (left_mask) {
+				index = left;
+				node_mask = left_mask;
+				continue;
+			} else if (right_mask) {
+				index = right;
+				node_mask = right_mask;
+				continue;
+			}
+		}
+
+		/* pop next node which is still interesting for any ray */
+		do {
+			if (!top) {
+				return;
+			}
+			index = stack[--top];
+			node_mask = de_bvh_packet_test_node(bvh->nodes + index, packet, entry) & mask;
+		} while (!node_mask);
+	}
+}
@@ -0,0 +1,185 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+/**
+ * Bounding volume hierarchy for static geometry.
+ *
+ * Tree is built using binned surface area heuristic and stored in one contiguous array of
+ * nodes in depth-first order: left child of a branch always follows its parent, so only index
+ * of right child is stored. Each triangle is referenced exactly once - leafs point to
+ * contiguous ranges of reordered index buffer.
+ *
+ * Tree can also be built over bounds of arbitrary objects and refitted when they move.
+ *
+ * Build can be done in parallel: top levels of tree are split on calling thread, then
+ * subtrees are built on worker threads. Result does not depend on amount of threads.
+ */
+
+#define DE_BVH_MAX_DEPTH (60)
+
+/**
+ * @brief Node of BVH. Exactly 32 bytes.
+ */
+typedef struct de_bvh_node_t {
+	de_vec3_t min;
+	uint32_t offset; /**< First index in index buffer for leaf, index of right child for branch */
+	de_vec3_t max;
+	uint32_t count;  /**< Count of triangles in leaf, zero for branch */
+} de_bvh_node_t;
+
+typedef struct de_bvh_t {
+	de_bvh_node_t* nodes; /**< Root is first node */
+	uint32_t node_count;
+	uint32_t* indices;    /**< Indices of triangles (or other primitives), ordered by leafs */
+	uint32_t index_count;
+	uint32_t leaf_count;  /**< Total count of leafs, max possible count of leafs in query result */
+	uint32_t depth;
+} de_bvh_t;
+
+/**
+ * @brief Caller-owned context of BVH query. Any number of threads can query same BVH
+ * simultaneously using their own contexts.
+ */
+typedef struct de_bvh_query_t {
+	uint32_t* leafs; /**< Indices of leafs found by last query */
+	uint32_t size;   /**< Count of leafs found by last query */
+	uint32_t capacity;
+} de_bvh_query_t;
+
+/**
+ * @brief Builds BVH over a set of triangles.
+ * @param src_triangles pointer to first vertex of first triangle, each triangle is three de_vec3_t in a row.
+ * @param pos_stride offset between triangles in bytes.
+ * @param max_triangles_per_leaf leafs will never be larger than that.
+ * @param pool thread pool to build in parallel, can be NULL.
+ */
+de_bvh_t* de_bvh_build(const void* src_triangles, size_t triangle_count, int pos_stride, size_t max_triangles_per_leaf, de_thread_pool_t* pool);
+
+/**
+ * @brief Bulk-loads BVH over arbitrary primitives given by their bounds, indices of BVH are
+ * indices of bounds. Used for trees over objects rather than triangles.
+ * @param max_primitives_per_leaf leafs will never be larger than that.
+ * @param pool thread pool to build in parallel, can be NULL.
+ */
+de_bvh_t* de_bvh_build_from_bounds(const de_vec3_t* min, const de_vec3_t* max, size_t count, size_t max_primitives_per_leaf, de_thread_pool_t* pool);
+
+/**
+ * @brief Recomputes bounds of every node from new bounds of primitives, structure of tree
+ * is kept. Much cheaper than rebuild, but tree degrades if primitives move far.
+ * @param min bounds of primitives, indexed the same way as during build.
+ */
+void de_bvh_refit(de_bvh_t* bvh, const de_vec3_t* min, const de_vec3_t* max);
+
+/**
+ * @brief Frees BVH. NULL is allowed.
+ */
+void de_bvh_free(de_bvh_t* bvh);
+
+/**
+ * @brief Initializes empty query context.
+ */
+void de_bvh_query_init(de_bvh_query_t* query);
+
+/**
+ * @brief Makes sure that query context is large enough for any query to BVH. Call it once
+ * per BVH (not per query), after that queries to this BVH will not allocate memory.
+ */
+void de_bvh_query_reserve(de_bvh_query_t* query, const de_bvh_t* bvh);
+
+/**
+ * @brief Frees buffers of query context.
+ */
+void de_bvh_query_free(de_bvh_query_t* query);
+
+/**
+ * @brief Returns true if bounds of node intersect with sphere. Same test is used by
+ * de_bvh_query_sphere.
+ */
+bool de_bvh_node_intersects_sphere(const de_bvh_node_t* node, const de_vec3_t* position, float radius);
+
+/**
+ * @brief Fills query context with leafs which intersects with sphere.
+ */
+void de_bvh_query_sphere(const de_bvh_t* bvh, de_bvh_query_t* query, const de_vec3_t* position, float radius);
+
+/**
+ * @brief Fills query context with leafs which intersects with ray.
+ */
+void de_bvh_query_ray(const de_bvh_t* bvh, de_bvh_query_t* query, const de_ray_t* ray);
+
+/**
+ * @brief Called for each leaf during ordered ray traversal. Should test triangles of the leaf
+ * and decrease *max_sqr_distance when closer hit is found. Returning true stops traversal.
+ */
+typedef bool(*de_bvh_ray_leaf_func_t)(void* user_data, const de_bvh_t* bvh, const de_bvh_node_t* leaf, float* max_sqr_distance);
+
+/**
+ * @brief Visits leafs which intersects with ray in front-to-back order: child with closer
+ * entry point is visited first, nodes which are entered farther than *max_sqr_distance (square
+ * distance from ray origin) are skipped. Does not allocate memory and does not modify BVH.
+ */
+void de_bvh_traverse_ray_ordered(const de_bvh_t* bvh, const de_ray_t* ray, float* max_sqr_distance, de_bvh_ray_leaf_func_t func, void* user_data);
+
+#define DE_BVH_PACKET_SIZE (4)
+
+/**
+ * @brief Packet of coherent rays in SoA layout. Every component of direction of every ray must
+ * be non-zero and have same sign across packet (see de_bvh_ray_packet_is_coherent).
+ */
+typedef struct de_bvh_ray_packet_t {
+	float origin_x[DE_BVH_PACKET_SIZE];
+	float origin_y[DE_BVH_PACKET_SIZE];
+	float origin_z[DE_BVH_PACKET_SIZE];
+	float dir_x[DE_BVH_PACKET_SIZE];
+	float dir_y[DE_BVH_PACKET_SIZE];
+	float dir_z[DE_BVH_PACKET_SIZE];
+	float inv_dir_x[DE_BVH_PACKET_SIZE];
+	float inv_dir_y[DE_BVH_PACKET_SIZE];
+	float inv_dir_z[DE_BVH_PACKET_SIZE];
+	float dir_sqr_len[DE_BVH_PACKET_SIZE];
+	float max_sqr_distance[DE_BVH_PACKET_SIZE]; /**< Square distance of closest hit of each ray */
+} de_bvh_ray_packet_t;
+
+/**
+ * @brief Called for each leaf during packet traversal with mask of rays which intersect leaf.
+ * Should decrease max_sqr_distance of rays in packet when closer hits are found. Returns mask
+ * of rays which are done (any-hit queries), such rays are excluded from further traversal.
+ */
+typedef int(*de_bvh_packet_leaf_func_t)(void* user_data, const de_bvh_t* bvh, const de_bvh_node_t* leaf, de_bvh_ray_packet_t* packet, int mask);
+
+/**
+ * @brief Returns true if ray can go into packet with rays of given octant.
+ * @param octant sign bits of direction (x - 1, y - 2, z - 4), written if not NULL.
+ */
+bool de_bvh_ray_packet_is_coherent(const de_ray_t* ray, int* octant);
+
+/**
+ * @brief Fills packet with rays, max_sqr_distance is not touched.
+ */
+void de_bvh_ray_packet_set(de_bvh_ray_packet_t* packet, const de_ray_t* const rays[DE_BVH_PACKET_SIZE]);
+
+/**
+ * @brief Traverses BVH with whole packet at once, each node is tested against all rays using
+ * SIMD. Each ray visits exactly the leafs which de_bvh_traverse_ray_ordered would visit for it
+ * or more, so closest hits are the same.
+ * @param mask rays of packet which should participate (bit per ray).
+ */
+void de_bvh_traverse_ray_packet(const de_bvh_t* bvh, de_bvh_ray_packet_t* packet, int mask, de_bvh_packet_leaf_func_t func, void* user_data);
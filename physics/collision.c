@@ -21,7 +21,7 @@
 
 bool de_static_geometry_add_triangle(de_static_geometry_t* geom, const de_vec3_t* a, const de_vec3_t* b, const de_vec3_t* c)
 {
-	de_vec3_t ca;
+	de_vec3_t ba, ca;
 	de_static_triangle_t triangle;
 
 	triangle.a = *a;
@@ -29,11 +29,11 @@ bool de_static_geometry_add_triangle(de_static_geometry_t* geom, const de_vec3_t
 	triangle.c = *c;
 
 	/* Find vectors from triangle vertices */
-	de_vec3_sub(&triangle.ba, b, a);
+	de_vec3_sub(&ba, b, a);
 	de_vec3_sub(&ca, c, a);
 
 	/* Normal of triangle is a cross product of above vectors */
-	de_vec3_cross(&triangle.normal, &triangle.ba, &ca);
+	de_vec3_cross(&triangle.normal, &ba, &ca);
 	if (de_vec3_sqr_len(&triangle.normal) > FLT_EPSILON) {
 		de_vec3_normalize(&triangle.normal, &triangle.normal);
 	} else {
@@ -41,21 +41,6 @@ bool de_static_geometry_add_triangle(de_static_geometry_t* geom, const de_vec3_t
 		return false;
 	}
 
-	/* Find triangle edges */
-	de_vec3_sub(&triangle.ab, a, b);
-	de_vec3_sub(&triangle.bc, b, c);
-	de_vec3_sub(&triangle.ca, c, a);
-	de_ray_by_two_points(&triangle.ab_ray, a, b);
-	de_ray_by_two_points(&triangle.bc_ray, b, c);
-	de_ray_by_two_points(&triangle.ca_ray, c, a);
-
-	/* Precalculate dot-products for barycentric "point-in-triangle" method */
-	triangle.caDotca = de_vec3_dot(&ca, &ca);
-	triangle.caDotba = de_vec3_dot(&ca, &triangle.ba);
-	triangle.baDotba = de_vec3_dot(&triangle.ba, &triangle.ba);
-	triangle.invDenom = 1.0f / (triangle.caDotca * triangle.baDotba - triangle.caDotba * triangle.caDotba);
-	triangle.distance = -de_vec3_dot(a, &triangle.normal);
-
 	/* Add new triangle to array */
 	DE_ARRAY_APPEND(geom->triangles, triangle);
 
@@ -94,51 +79,1086 @@ void de_static_geometry_fill(de_static_geometry_t* geom, const de_mesh_t* mesh,
 		}
 	}
 
-	geom->octree = de_octree_build((char*)geom->triangles.data + offsetof(de_static_triangle_t, a), geom->triangles.size, sizeof(de_static_triangle_t), 64);
+	de_static_geometry_build(geom);
+}
+
+/**
+ * @brief Makes contact caches of all bodies of scene invalid.
+ */
+static void de_static_geometry_tree_invalidate(de_static_geometry_tree_t* tree)
+{
+	if (++tree->revision == 0) {
+		tree->revision = 1;
+	}
+}
+
+void de_static_geometry_build(de_static_geometry_t* geom)
+{
+	DE_ASSERT(geom);
+
+	/* bodies resting on old geometry must not hang in the air */
+	de_static_geometry_wake_bodies(geom);
+
+	de_thread_pool_t* pool = geom->scene && geom->scene->core ? de_core_get_thread_pool(geom->scene->core) : NULL;
+	de_bvh_free(geom->bvh);
+	geom->bvh = de_bvh_build((char*)geom->triangles.data + offsetof(de_static_triangle_t, a), geom->triangles.size, sizeof(de_static_triangle_t), DE_STATIC_GEOMETRY_MAX_TRIANGLES_PER_LEAF, pool);
+
+	/* and bodies inside of new geometry must be pushed out */
+	de_static_geometry_wake_bodies(geom);
+
+	/* bounds of geometry which is already in top-level tree are just refitted */
+	if (geom->scene) {
+		de_static_geometry_tree_t* tree = geom->scene->static_geometry_tree;
+		if (tree && geom->tree_index != DE_STATIC_GEOMETRY_NOT_IN_TREE && geom->bvh->node_count) {
+			tree->min.data[geom->tree_index] = geom->bvh->nodes[0].min;
+			tree->max.data[geom->tree_index] = geom->bvh->nodes[0].max;
+			de_bvh_refit(tree->bvh, tree->min.data, tree->max.data);
+			de_static_geometry_tree_invalidate(tree);
+		} else if (geom->tree_index != DE_STATIC_GEOMETRY_NOT_IN_TREE || geom->bvh->node_count) {
+			de_static_geometry_tree_rebuild(geom->scene);
+		}
+	}
+
+	/* Pack triangles in order of leafs, so every leaf covers few consecutive packs */
+	de_free(geom->packs);
+	geom->packs = NULL;
+	geom->pack_count = 0;
+	if (!geom->bvh) {
+		return;
+	}
+	geom->pack_count = (geom->bvh->index_count + DE_STATIC_TRIANGLE_PACK_SIZE - 1) / DE_STATIC_TRIANGLE_PACK_SIZE;
+	geom->packs = de_calloc(geom->pack_count, sizeof(*geom->packs));
+	for (uint32_t i = 0; i < geom->bvh->index_count; ++i) {
+		const de_static_triangle_t* triangle = geom->triangles.data + geom->bvh->indices[i];
+		de_static_triangle_pack_t* pack = geom->packs + i / DE_STATIC_TRIANGLE_PACK_SIZE;
+		const uint32_t lane = i % DE_STATIC_TRIANGLE_PACK_SIZE;
+		de_vec3_t n;
+		/* plane normal is normalized again, exactly as de_plane_set did it in narrow phase */
+		de_vec3_normalize(&n, &triangle->normal);
+		pack->a_x[lane] = triangle->a.x;
+		pack->a_y[lane] = triangle->a.y;
+		pack->a_z[lane] = triangle->a.z;
+		pack->b_x[lane] = triangle->b.x;
+		pack->b_y[lane] = triangle->b.y;
+		pack->b_z[lane] = triangle->b.z;
+		pack->c_x[lane] = triangle->c.x;
+		pack->c_y[lane] = triangle->c.y;
+		pack->c_z[lane] = triangle->c.z;
+		pack->ba_x[lane] = triangle->b.x - triangle->a.x;
+		pack->ba_y[lane] = triangle->b.y - triangle->a.y;
+		pack->ba_z[lane] = triangle->b.z - triangle->a.z;
+		pack->ca_x[lane] = triangle->c.x - triangle->a.x;
+		pack->ca_y[lane] = triangle->c.y - triangle->a.y;
+		pack->ca_z[lane] = triangle->c.z - triangle->a.z;
+		pack->cb_x[lane] = triangle->c.x - triangle->b.x;
+		pack->cb_y[lane] = triangle->c.y - triangle->b.y;
+		pack->cb_z[lane] = triangle->c.z - triangle->b.z;
+		pack->n_x[lane] = n.x;
+		pack->n_y[lane] = n.y;
+		pack->n_z[lane] = n.z;
+		pack->distance[lane] = -de_vec3_dot(&triangle->a, &triangle->normal);
+		const de_vec3_t ba = { pack->ba_x[lane], pack->ba_y[lane], pack->ba_z[lane] };
+		const de_vec3_t ca = { pack->ca_x[lane], pack->ca_y[lane], pack->ca_z[lane] };
+		pack->ba_dot_ba[lane] = de_vec3_dot(&ba, &ba);
+		pack->ca_dot_ba[lane] = de_vec3_dot(&ca, &ba);
+		pack->ca_dot_ca[lane] = de_vec3_dot(&ca, &ca);
+		pack->inv_denom[lane] = 1.0f / (pack->ca_dot_ca[lane] * pack->ba_dot_ba[lane] - pack->ca_dot_ba[lane] * pack->ca_dot_ba[lane]);
+	}
+}
+
+void de_static_geometry_tree_rebuild(de_scene_t* scene)
+{
+	DE_ASSERT(scene);
+
+	if (!scene->static_geometry_tree) {
+		scene->static_geometry_tree = DE_NEW(de_static_geometry_tree_t);
+	}
+	de_static_geometry_tree_t* tree = scene->static_geometry_tree;
+
+	DE_ARRAY_CLEAR(tree->geometries);
+	DE_ARRAY_CLEAR(tree->min);
+	DE_ARRAY_CLEAR(tree->max);
+	DE_LINKED_LIST_FOR_EACH_T(de_static_geometry_t*, geom, scene->static_geometries)
+	{
+		geom->tree_index = DE_STATIC_GEOMETRY_NOT_IN_TREE;
+		if (geom->bvh && geom->bvh->node_count) {
+			geom->tree_index = (uint32_t)tree->geometries.size;
+			DE_ARRAY_APPEND(tree->geometries, geom);
+			DE_ARRAY_APPEND(tree->min, geom->bvh->nodes[0].min);
+			DE_ARRAY_APPEND(tree->max, geom->bvh->nodes[0].max);
+		}
+	}
+
+	de_bvh_free(tree->bvh);
+	tree->bvh = de_bvh_build_from_bounds(tree->min.data, tree->max.data, tree->geometries.size, DE_STATIC_GEOMETRY_TREE_MAX_GEOMETRIES_PER_LEAF, NULL);
+	de_static_geometry_tree_invalidate(tree);
+}
+
+void de_static_geometry_tree_free(de_static_geometry_tree_t* tree)
+{
+	if (tree) {
+		de_bvh_free(tree->bvh);
+		DE_ARRAY_FREE(tree->geometries);
+		DE_ARRAY_FREE(tree->min);
+		DE_ARRAY_FREE(tree->max);
+		de_free(tree);
+	}
+}
+
+static int de_static_geometry_index_comparer(const void* a, const void* b)
+{
+	const uint32_t index_a = *(const uint32_t*)a;
+	const uint32_t index_b = *(const uint32_t*)b;
+	return index_a < index_b ? -1 : (index_a > index_b ? 1 : 0);
+}
+
+/**
+ * @brief Writes indices of geometries referenced by leafs found by query to the buffer (which
+ * must fit every geometry of tree) in order of scene list. Returns count of geometries.
+ */
+static uint32_t de_static_geometry_tree_gather(const de_static_geometry_tree_t* tree, const de_bvh_query_t* query, uint32_t* indices)
+{
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < query->size; ++i) {
+		const de_bvh_node_t* leaf = tree->bvh->nodes + query->leafs[i];
+		for (uint32_t k = 0; k < leaf->count; ++k) {
+			indices[count++] = tree->bvh->indices[leaf->offset + k];
+		}
+	}
+	if (count > 1) {
+		qsort(indices, count, sizeof(*indices), de_static_geometry_index_comparer);
+	}
+	return count;
+}
+
+void de_static_geometry_set_collision_layers(de_static_geometry_t* geom, uint32_t layer, uint32_t mask)
+{
+	DE_ASSERT(geom);
+	geom->collision_layer = layer;
+	geom->collision_mask = mask;
+	if (geom->scene && geom->scene->static_geometry_tree) {
+		de_static_geometry_tree_invalidate(geom->scene->static_geometry_tree);
+	}
+	de_static_geometry_wake_bodies(geom);
+}
+
+static bool de_collision_layers_match(uint32_t layer_a, uint32_t mask_a, uint32_t layer_b, uint32_t mask_b)
+{
+	return (layer_a & mask_b) && (layer_b & mask_a);
+}
+
+void de_static_geometry_wake_bodies(de_static_geometry_t* geom)
+{
+	DE_ASSERT(geom);
+
+	if (!geom->scene || !geom->bvh || !geom->bvh->node_count) {
+		return;
+	}
+
+	de_aabb_t bounds;
+	de_aabb_set(&bounds, &geom->bvh->nodes[0].min, &geom->bvh->nodes[0].max);
+	DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, geom->scene->bodies)
+	{
+		if (body->sleeping && de_aabb_sphere_intersection(&bounds, NULL, &body->position, body->radius)) {
+			de_body_wake_up(body);
+		}
+	}
+}
+
+size_t de_physics_get_sleeping_body_count(const de_scene_t* scene)
+{
+	DE_ASSERT(scene);
+	size_t count = 0;
+	DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
+	{
+		if (body->sleeping) {
+			++count;
+		}
+	}
+	return count;
 }
 
 bool de_static_triangle_contains_point(const de_static_triangle_t* triangle, const de_vec3_t* point)
 {
-	de_vec3_t vp;
-	de_vec3_sub(&vp, point, &triangle->a);
-	float dot02 = de_vec3_dot(&triangle->ca, &vp);
-	float dot12 = de_vec3_dot(&triangle->ba, &vp);
-	float u = (triangle->baDotba * dot02 - triangle->caDotba * dot12) * triangle->invDenom;
-	float v = (triangle->caDotca * dot12 - triangle->caDotba * dot02) * triangle->invDenom;
-	return (u >= 0.0f) && (v >= 0.0f) && (u + v < 1.0f);
+	return de_is_point_inside_triangle(point, &triangle->a, &triangle->b, &triangle->c);
+}
+
+/**
+ * @brief Returns mask of lanes of pack that belong to range [begin; end) of indices of bvh.
+ */
+static int de_static_triangle_pack_lanes(size_t pack, uint32_t begin, uint32_t end)
+{
+	const size_t first = pack * DE_STATIC_TRIANGLE_PACK_SIZE;
+	int mask = 0;
+	for (int i = 0; i < DE_STATIC_TRIANGLE_PACK_SIZE; ++i) {
+		if (first + i >= begin && first + i < end) {
+			mask |= 1 << i;
+		}
+	}
+	return mask;
+}
+
+#if DE_SSE
+/**
+ * @brief Conservative Moller-Trumbore test for four ray-triangle pairs. Returns mask of pairs
+ * which may intersect. Barycentric tolerance covers difference with de_ray_triangle_intersection,
+ * rays almost parallel to triangle plane can't be classified reliably and always pass.
+ */
+static int de_moller_trumbore_mask_sse(__m128 ox, __m128 oy, __m128 oz, __m128 dx, __m128 dy, __m128 dz,
+	__m128 ax, __m128 ay, __m128 az, __m128 e1x, __m128 e1y, __m128 e1z, __m128 e2x, __m128 e2y, __m128 e2z)
+{
+	const float eps = 1e-3f;
+	/* pvec = dir x e2 */
+	const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, e1x), _mm_mul_ps(py, e1y)), _mm_mul_ps(pz, e1z));
+	const __m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+	const __m128 degenerated = _mm_cmplt_ps(abs_det, _mm_set1_ps(1e-12f));
+	const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+	/* tvec = origin - a */
+	const __m128 tx = _mm_sub_ps(ox, ax);
+	const __m128 ty = _mm_sub_ps(oy, ay);
+	const __m128 tz = _mm_sub_ps(oz, az);
+	const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inv_det);
+	/* qvec = tvec x e1 */
+	const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv_det);
+	const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv_det);
+	const __m128 neg_eps = _mm_set1_ps(-eps);
+	__m128 inside = _mm_cmpge_ps(u, neg_eps);
+	inside = _mm_and_ps(inside, _mm_cmpge_ps(v, neg_eps));
+	inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f + eps)));
+	inside = _mm_and_ps(inside, _mm_cmpge_ps(t, neg_eps));
+	return _mm_movemask_ps(_mm_or_ps(inside, degenerated));
+}
+#else
+/**
+ * @brief Scalar version of de_moller_trumbore_mask_sse for one ray-triangle pair.
+ */
+static bool de_moller_trumbore_maybe(const de_vec3_t* origin, const de_vec3_t* dir, const de_vec3_t* a, const de_vec3_t* e1, const de_vec3_t* e2)
+{
+	const float eps = 1e-3f;
+	de_vec3_t pvec, tvec, qvec;
+	de_vec3_cross(&pvec, dir, e2);
+	const float det = de_vec3_dot(e1, &pvec);
+	if (fabsf(det) < 1e-12f) {
+		return true;
+	}
+	const float inv_det = 1.0f / det;
+	de_vec3_sub(&tvec, origin, a);
+	const float u = de_vec3_dot(&tvec, &pvec) * inv_det;
+	de_vec3_cross(&qvec, &tvec, e1);
+	const float v = de_vec3_dot(dir, &qvec) * inv_det;
+	const float t = de_vec3_dot(e2, &qvec) * inv_det;
+	return u >= -eps && v >= -eps && u + v <= 1.0f + eps && t >= -eps;
+}
+#endif
+
+/**
+ * @brief Returns mask of triangles of pack which may be hit by ray. Candidates must be
+ * checked precisely by de_ray_triangle_intersection.
+ */
+static int de_static_triangle_pack_ray_mask(const de_static_triangle_pack_t* pack, const de_ray_t* ray, int mask)
+{
+#if DE_SSE
+	return mask & de_moller_trumbore_mask_sse(
+		_mm_set1_ps(ray->origin.x), _mm_set1_ps(ray->origin.y), _mm_set1_ps(ray->origin.z),
+		_mm_set1_ps(ray->dir.x), _mm_set1_ps(ray->dir.y), _mm_set1_ps(ray->dir.z),
+		_mm_loadu_ps(pack->a_x), _mm_loadu_ps(pack->a_y), _mm_loadu_ps(pack->a_z),
+		_mm_loadu_ps(pack->ba_x), _mm_loadu_ps(pack->ba_y), _mm_loadu_ps(pack->ba_z),
+		_mm_loadu_ps(pack->ca_x), _mm_loadu_ps(pack->ca_y), _mm_loadu_ps(pack->ca_z));
+#else
+	int result = 0;
+	for (int i = 0; i < DE_STATIC_TRIANGLE_PACK_SIZE; ++i) {
+		if (mask & (1 << i)) {
+			const de_vec3_t a = { pack->a_x[i], pack->a_y[i], pack->a_z[i] };
+			const de_vec3_t e1 = { pack->ba_x[i], pack->ba_y[i], pack->ba_z[i] };
+			const de_vec3_t e2 = { pack->ca_x[i], pack->ca_y[i], pack->ca_z[i] };
+			if (de_moller_trumbore_maybe(&ray->origin, &ray->dir, &a, &e1, &e2)) {
+				result |= 1 << i;
+			}
+		}
+	}
+	return result;
+#endif
+}
+
+/**
+ * @brief Solves collisions of body with given triangles of pack one by one, in order of lanes.
+ */
+static void de_body_collide_with_pack(de_body_t* body, de_static_geometry_t* geom, size_t p, int mask)
+{
+	for (int i = 0; i < DE_STATIC_TRIANGLE_PACK_SIZE; ++i) {
+		if (mask & (1 << i)) {
+			de_body_triangle_collision(&geom->triangles.data[geom->bvh->indices[p * DE_STATIC_TRIANGLE_PACK_SIZE + i]], geom->packs + p, i, body);
+		}
+	}
+}
+
+/**
+ * @brief Solves collisions of body with triangles of leaf of bvh in order of leaf. With SSE
+ * exact test runs for whole pack at once while body stays in place; after a push usually one or
+ * two triangles of pack are left, they are tested one by one from new position.
+ */
+static void de_body_collide_with_leaf(de_body_t* body, de_static_geometry_t* geom, const de_bvh_node_t* leaf)
+{
+	const uint32_t end = leaf->offset + leaf->count;
+	for (size_t p = leaf->offset / DE_STATIC_TRIANGLE_PACK_SIZE; p * DE_STATIC_TRIANGLE_PACK_SIZE < end; ++p) {
+		int mask = de_static_triangle_pack_lanes(p, leaf->offset, end);
+#if DE_SSE
+		float x[DE_STATIC_TRIANGLE_PACK_SIZE], y[DE_STATIC_TRIANGLE_PACK_SIZE], z[DE_STATIC_TRIANGLE_PACK_SIZE];
+		int hits = mask & de_sphere_triangle_pack_intersection_sse(&body->position, body->radius, geom->packs + p, x, y, z);
+		for (int i = 0; i < DE_STATIC_TRIANGLE_PACK_SIZE && hits; ++i) {
+			if (!(hits & (1 << i))) {
+				continue;
+			}
+			const de_vec3_t position = body->position;
+			const de_vec3_t intersection_pt = { x[i], y[i], z[i] };
+			de_body_triangle_contact(&geom->triangles.data[geom->bvh->indices[p * DE_STATIC_TRIANGLE_PACK_SIZE + i]], body, &intersection_pt);
+			mask &= ~((2 << i) - 1);
+			hits &= mask;
+			if (!de_vec3_equals(&position, &body->position)) {
+				de_body_collide_with_pack(body, geom, p, mask);
+				break;
+			}
+		}
+#else
+		de_body_collide_with_pack(body, geom, p, mask);
+#endif
+	}
+}
+
+#define DE_PHYSICS_BODIES_PER_TASK (32)
+#define DE_PHYSICS_PAIRS_PER_TASK (64)
+
+#define DE_PHYSICS_SNAPSHOT_VERSION (3)
+
+/* Marks absent body or triangle of contact in snapshot */
+#define DE_PHYSICS_SNAPSHOT_NO_INDEX (UINT32_MAX)
+
+typedef struct de_physics_snapshot_header_t {
+	uint32_t version;
+	uint32_t body_count;
+} de_physics_snapshot_header_t;
+
+/**
+ * @brief Everything physics step reads or writes, velocity is implied by last position. Record is
+ * followed by contact_count contacts: sleeping bodies are not collided, so their contacts would not
+ * be filled again by physics step.
+ */
+typedef struct de_body_snapshot_t {
+	de_vec3_t position;
+	de_vec3_t last_position;
+	de_vec3_t acceleration;
+	de_vec3_t gravity;
+	float radius;
+	float friction;
+	float still_time;
+	uint32_t collision_layer;
+	uint32_t collision_mask;
+	uint32_t sleeping;
+	uint32_t contact_count;
+} de_body_snapshot_t;
+
+/**
+ * @brief Contact with other body and triangle stored by indices, pointers could dangle when
+ * snapshot is restored after bodies or geometries were changed.
+ */
+typedef struct de_contact_snapshot_t {
+	de_vec3_t position;
+	de_vec3_t normal;
+	uint32_t body;     /**< Index of body in scene list */
+	uint32_t geometry; /**< Index of geometry in top-level tree */
+	uint32_t triangle; /**< Index of triangle in geometry */
+} de_contact_snapshot_t;
+
+static size_t de_body_get_snapshot_size(const de_body_t* body)
+{
+	return sizeof(de_body_snapshot_t) + body->contact_count * sizeof(de_contact_snapshot_t);
+}
+
+size_t de_physics_get_snapshot_size(const de_scene_t* scene)
+{
+	DE_ASSERT(scene);
+	size_t size = sizeof(de_physics_snapshot_header_t);
+	DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
+	{
+		size += de_body_get_snapshot_size(body);
+	}
+	return size;
+}
+
+static bool de_static_geometry_find_triangle(const de_static_geometry_t* geom, const de_static_triangle_t* triangle, uint32_t* index)
+{
+	if (triangle >= geom->triangles.data && triangle < geom->triangles.data + geom->triangles.size) {
+		*index = (uint32_t)(triangle - geom->triangles.data);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Finds triangle in geometries of top-level tree. Geometry with index in hint is checked
+ * first, contacts of one body are usually with the same geometry.
+ */
+static bool de_physics_find_triangle(const de_static_geometry_tree_t* tree, const de_static_triangle_t* triangle, uint32_t* hint, uint32_t* index)
+{
+	if (!tree) {
+		return false;
+	}
+	if (*hint < tree->geometries.size && de_static_geometry_find_triangle(tree->geometries.data[*hint], triangle, index)) {
+		return true;
+	}
+	for (size_t i = 0; i < tree->geometries.size; ++i) {
+		if (i != *hint && de_static_geometry_find_triangle(tree->geometries.data[i], triangle, index)) {
+			*hint = (uint32_t)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t de_physics_save_snapshot(de_scene_t* scene, void* buffer, size_t buffer_size)
+{
+	DE_ASSERT(scene);
+	DE_ASSERT(buffer || !buffer_size);
+
+	const size_t size = de_physics_get_snapshot_size(scene);
+	if (buffer_size < size) {
+		return 0;
+	}
+
+	/* contacts reference bodies by index in list, so order must be fresh */
+	uint32_t body_count = 0;
+	DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
+	{
+		body->proxy.order = body_count++;
+	}
+	if (scene->broadphase) {
+		scene->broadphase->next_order = body_count;
+	}
+
+	/* buffer may be unaligned, so records are assembled on stack */
+	char* ptr = (char*)buffer + sizeof(de_physics_snapshot_header_t);
+	de_physics_snapshot_header_t header;
+	header.version = DE_PHYSICS_SNAPSHOT_VERSION;
+	header.body_count = body_count;
+	memcpy(buffer, &header, sizeof(header));
+	uint32_t geometry_hint = 0;
+	DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
+	{
+		de_body_snapshot_t record;
+		record.position = body->position;
+		record.last_position = body->last_position;
+		record.acceleration = body->acceleration;
+		record.gravity = body->gravity;
+		record.radius = body->radius;
+		record.friction = body->friction;
+		record.still_time = body->still_time;
+		record.collision_layer = body->collision_layer;
+		record.collision_mask = body->collision_mask;
+		record.sleeping = body->sleeping;
+		record.contact_count = (uint32_t)body->contact_count;
+		memcpy(ptr, &record, sizeof(record));
+		ptr += sizeof(record);
+		for (int i = 0; i < body->contact_count; ++i) {
+			const de_contact_t* contact = body->contacts + i;
+			de_contact_snapshot_t contact_record;
+			contact_record.position = contact->position;
+			contact_record.normal = contact->normal;
+			contact_record.body = contact->body ? contact->body->proxy.order : DE_PHYSICS_SNAPSHOT_NO_INDEX;
+			contact_record.geometry = DE_PHYSICS_SNAPSHOT_NO_INDEX;
+			contact_record.triangle = DE_PHYSICS_SNAPSHOT_NO_INDEX;
+			/* triangles of freed geometry are not found, its bodies are awake and will refill contacts */
+			if (contact->triangle && de_physics_find_triangle(scene->static_geometry_tree, contact->triangle, &geometry_hint, &contact_record.triangle)) {
+				contact_record.geometry = geometry_hint;
+			}
+			memcpy(ptr, &contact_record, sizeof(contact_record));
+			ptr += sizeof(contact_record);
+		}
+	}
+
+	return size;
+}
+
+/**
+ * @brief Returns true if indices of contact resolve in scene.
+ */
+static bool de_physics_is_contact_snapshot_valid(const de_contact_snapshot_t* record, size_t body_count, const de_static_geometry_tree_t* tree)
+{
+	if (record->body != DE_PHYSICS_SNAPSHOT_NO_INDEX && record->body >= body_count) {
+		return false;
+	}
+	if (record->geometry == DE_PHYSICS_SNAPSHOT_NO_INDEX) {
+		return record->triangle == DE_PHYSICS_SNAPSHOT_NO_INDEX;
+	}
+	return tree && record->geometry < tree->geometries.size && record->triangle < tree->geometries.data[record->geometry]->triangles.size;
+}
+
+bool de_physics_load_snapshot(de_scene_t* scene, const void* buffer, size_t buffer_size)
+{
+	DE_ASSERT(scene);
+	DE_ASSERT(buffer || !buffer_size);
+
+	de_physics_snapshot_header_t header;
+	if (buffer_size < sizeof(header)) {
+		de_log("physics snapshot: buffer is too small");
+		return false;
+	}
+	memcpy(&header, buffer, sizeof(header));
+	if (header.version != DE_PHYSICS_SNAPSHOT_VERSION) {
+		de_log("physics snapshot: unsupported version %u", header.version);
+		return false;
+	}
+
+	/* bodies of contacts are looked up by index */
+	de_body_array_t bodies;
+	DE_ARRAY_INIT(bodies);
+	DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
+	{
+		DE_ARRAY_APPEND(bodies, body);
+	}
+
+	/* validate whole snapshot first, scene must stay untouched if it does not match */
+	const de_static_geometry_tree_t* tree = scene->static_geometry_tree;
+	const char* begin = (const char*)buffer + sizeof(header);
+	const char* end = (const char*)buffer + buffer_size;
+	const char* ptr = begin;
+	bool valid = bodies.size == header.body_count;
+	for (size_t i = 0; valid && i < bodies.size; ++i) {
+		de_body_snapshot_t record;
+		if ((size_t)(end - ptr) < sizeof(record)) {
+			valid = false;
+			break;
+		}
+		memcpy(&record, ptr, sizeof(record));
+		ptr += sizeof(record);
+		if (record.contact_count > DE_MAX_CONTACTS || (size_t)(end - ptr) < record.contact_count * sizeof(de_contact_snapshot_t)) {
+			valid = false;
+			break;
+		}
+		for (uint32_t k = 0; valid && k < record.contact_count; ++k) {
+			de_contact_snapshot_t contact_record;
+			memcpy(&contact_record, ptr, sizeof(contact_record));
+			ptr += sizeof(contact_record);
+			valid = de_physics_is_contact_snapshot_valid(&contact_record, bodies.size, tree);
+		}
+	}
+	if (!valid) {
+		de_log("physics snapshot: does not match scene");
+		DE_ARRAY_FREE(bodies);
+		return false;
+	}
+
+	ptr = begin;
+	for (size_t i = 0; i < bodies.size; ++i) {
+		de_body_t* body = bodies.data[i];
+		de_body_snapshot_t record;
+		memcpy(&record, ptr, sizeof(record));
+		ptr += sizeof(record);
+		body->position = record.position;
+		body->last_position = record.last_position;
+		body->acceleration = record.acceleration;
+		body->gravity = record.gravity;
+		body->radius = record.radius;
+		body->friction = record.friction;
+		body->still_time = record.still_time;
+		body->collision_layer = record.collision_layer;
+		body->collision_mask = record.collision_mask;
+		body->sleeping = record.sleeping != 0;
+		body->contact_count = record.contact_count;
+		for (uint32_t k = 0; k < record.contact_count; ++k) {
+			de_contact_snapshot_t contact_record;
+			memcpy(&contact_record, ptr, sizeof(contact_record));
+			ptr += sizeof(contact_record);
+			de_contact_t* contact = body->contacts + k;
+			contact->position = contact_record.position;
+			contact->normal = contact_record.normal;
+			contact->body = contact_record.body != DE_PHYSICS_SNAPSHOT_NO_INDEX ? bodies.data[contact_record.body] : NULL;
+			contact->triangle = NULL;
+			if (contact_record.geometry != DE_PHYSICS_SNAPSHOT_NO_INDEX) {
+				contact->triangle = tree->geometries.data[contact_record.geometry]->triangles.data + contact_record.triangle;
+			}
+		}
+		body->contact_cache.revision = 0;
+		de_body_update_broadphase(body);
+	}
+	DE_ARRAY_FREE(bodies);
+
+	return true;
+}
+
+/* Colors with less pairs are resolved on calling thread, overhead of pool would be larger than work */
+#define DE_PHYSICS_MIN_PARALLEL_PAIRS (256)
+
+typedef struct de_body_pair_t {
+	de_body_t* a;
+	de_body_t* b;
+} de_body_pair_t;
+
+/**
+ * @brief Scratch data of one task of physics step, tasks never share it.
+ */
+typedef struct de_physics_task_t {
+	de_bvh_query_t query;
+	de_bvh_query_t tree_query;
+	DE_ARRAY_DECLARE(uint32_t, geometries);
+	de_body_array_t candidates;
+	DE_ARRAY_DECLARE(de_body_pair_t, pairs);
+} de_physics_task_t;
+
+/**
+ * @brief State of physics step of one scene.
+ *
+ * Step is split into phases, each phase is either parallel and touches only data owned by its
+ * task, or serial:
+ * 1) integration and collisions with static geometry, each body only modifies itself (parallel);
+ * 2) update of broadphase (serial);
+ * 3) gathering of overlapping pairs of bodies, in order of bodies (parallel);
+ * 4) coloring of pairs: pairs of same color do not share bodies, pairs of each body get
+ *    increasing colors in order of list of pairs (serial);
+ * 5) resolution of pairs color by color, pairs of one color in parallel;
+ * 6) islands of touching bodies are put to sleep or woken up (serial).
+ * Nothing depends on count of threads, so result is bit-identical for any pool.
+ *
+ * Sleeping bodies are skipped in phase 1, pairs of two sleeping bodies are skipped in phase 3.
+ */
+typedef struct de_physics_step_t {
+	de_thread_pool_t* pool;
+	de_broadphase_t* broadphase;
+	const de_static_geometry_tree_t* tree; /**< Top-level tree of static geometries of scene, NULL if it is empty */
+	float dt;
+	float dt2;
+	de_body_array_t bodies;        /**< Bodies of scene, index of body is equal to its order */
+	de_physics_task_t* tasks;
+	size_t task_count;
+	size_t task_capacity;
+	DE_ARRAY_DECLARE(de_body_pair_t, pairs); /**< Pairs sorted by color */
+	DE_ARRAY_DECLARE(uint32_t, colors);     /**< Temporary: color of each pair, then offsets of colors */
+	DE_ARRAY_DECLARE(uint32_t, next_color); /**< Temporary: first free color of each body */
+	DE_ARRAY_DECLARE(uint32_t, islands);    /**< Temporary: parent of each body in disjoint set of islands */
+	DE_ARRAY_DECLARE(bool, island_awake);   /**< Temporary: true if island has a body that is not still */
+	size_t color_begin;            /**< Range of pairs of color being resolved */
+	size_t color_end;
+} de_physics_step_t;
+
+/**
+ * @brief Collides body with geometries found by top-level tree in order of scene list,
+ * starting from geometry with index first. When body is pushed, geometries are gathered again
+ * for new position and iteration continues from next geometry, so results are the same as if
+ * every geometry of scene was checked.
+ */
+static void de_body_collide_with_tree(de_body_t* body, const de_static_geometry_tree_t* tree, de_physics_task_t* task, uint32_t first)
+{
+	uint32_t* indices = task->geometries.data;
+	de_bvh_query_sphere(tree->bvh, &task->tree_query, &body->position, body->radius);
+	uint32_t count = de_static_geometry_tree_gather(tree, &task->tree_query, indices);
+	uint32_t n = 0;
+	while (n < count && indices[n] < first) {
+		++n;
+	}
+	while (n < count) {
+		const uint32_t index = indices[n++];
+		de_static_geometry_t* geom = tree->geometries.data[index];
+		if (!de_collision_layers_match(body->collision_layer, body->collision_mask, geom->collision_layer, geom->collision_mask)) {
+			continue;
+		}
+		const de_vec3_t position = body->position;
+		de_bvh_query_reserve(&task->query, geom->bvh);
+		de_bvh_query_sphere(geom->bvh, &task->query, &body->position, body->radius);
+		for (uint32_t k = 0; k < task->query.size; ++k) {
+			de_body_collide_with_leaf(body, geom, geom->bvh->nodes + task->query.leafs[k]);
+		}
+		if (position.x != body->position.x || position.y != body->position.y || position.z != body->position.z) {
+			de_bvh_query_sphere(tree->bvh, &task->tree_query, &body->position, body->radius);
+			count = de_static_geometry_tree_gather(tree, &task->tree_query, indices);
+			n = 0;
+			while (n < count && indices[n] <= index) {
+				++n;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Fills contact cache of body with leafs which touch body enlarged by margin. Returns
+ * false if there are too many of them, cache is left invalid then.
+ */
+static bool de_body_fill_contact_cache(de_body_t* body, const de_static_geometry_tree_t* tree, de_physics_task_t* task)
+{
+	de_body_contact_cache_t* cache = &body->contact_cache;
+	const float radius = body->radius + DE_BODY_CONTACT_CACHE_MARGIN;
+	cache->revision = 0;
+	cache->count = 0;
+	de_bvh_query_sphere(tree->bvh, &task->tree_query, &body->position, radius);
+	const uint32_t count = de_static_geometry_tree_gather(tree, &task->tree_query, task->geometries.data);
+	for (uint32_t n = 0; n < count; ++n) {
+		const uint32_t index = task->geometries.data[n];
+		const de_static_geometry_t* geom = tree->geometries.data[index];
+		if (!de_collision_layers_match(body->collision_layer, body->collision_mask, geom->collision_layer, geom->collision_mask)) {
+			continue;
+		}
+		de_bvh_query_reserve(&task->query, geom->bvh);
+		de_bvh_query_sphere(geom->bvh, &task->query, &body->position, radius);
+		if (cache->count + task->query.size > DE_BODY_CONTACT_CACHE_SIZE) {
+			return false;
+		}
+		for (uint32_t k = 0; k < task->query.size; ++k) {
+			cache->geometries[cache->count] = index;
+			cache->leafs[cache->count] = task->query.leafs[k];
+			++cache->count;
+		}
+	}
+	cache->center = body->position;
+	cache->radius = body->radius;
+	cache->revision = tree->revision;
+	return true;
+}
+
+/**
+ * @brief Collides body with static geometry using its contact cache, cache is refilled when
+ * body left its region. Cached leafs are tested with same position as in de_body_collide_with_tree,
+ * so results are the same, just queries are skipped.
+ */
+static void de_body_collide_with_static_geometries(de_body_t* body, const de_static_geometry_tree_t* tree, de_physics_task_t* task)
+{
+	de_body_contact_cache_t* cache = &body->contact_cache;
+	const float sqr_margin = DE_BODY_CONTACT_CACHE_MARGIN * DE_BODY_CONTACT_CACHE_MARGIN;
+	const bool valid = cache->revision == tree->revision && cache->radius == body->radius &&
+		de_vec3_sqr_distance(&body->position, &cache->center) <= sqr_margin;
+	if (!valid && !de_body_fill_contact_cache(body, tree, task)) {
+		de_body_collide_with_tree(body, tree, task, 0);
+		return;
+	}
+	uint32_t i = 0;
+	while (i < cache->count) {
+		const uint32_t index = cache->geometries[i];
+		de_static_geometry_t* geom = tree->geometries.data[index];
+		const de_vec3_t position = body->position;
+		for (; i < cache->count && cache->geometries[i] == index; ++i) {
+			const de_bvh_node_t* leaf = geom->bvh->nodes + cache->leafs[i];
+			if (de_bvh_node_intersects_sphere(leaf, &position, body->radius)) {
+				de_body_collide_with_leaf(body, geom, leaf);
+			}
+		}
+		/* pushes could move body out of region covered by cache */
+		if (de_vec3_sqr_distance(&body->position, &cache->center) > sqr_margin) {
+			de_body_collide_with_tree(body, tree, task, index + 1);
+			return;
+		}
+	}
+}
+
+static void de_physics_integrate_task(void* arg, size_t index)
+{
+	de_physics_step_t* step = arg;
+	de_physics_task_t* task = step->tasks + index;
+	const size_t begin = index * DE_PHYSICS_BODIES_PER_TASK;
+	const size_t end = begin + DE_PHYSICS_BODIES_PER_TASK < step->bodies.size ? begin + DE_PHYSICS_BODIES_PER_TASK : step->bodies.size;
+	for (size_t i = begin; i < end; ++i) {
+		de_body_t* body = step->bodies.data[i];
+		if (body->sleeping) {
+			/* acceleration could be applied directly */
+			if (body->acceleration.x == 0.0f && body->acceleration.y == 0.0f && body->acceleration.z == 0.0f) {
+				continue;
+			}
+			de_body_wake_up(body);
+		}
+		/* Drop contact information */
+		body->contact_count = 0;
+		/* Apply gravity */
+		de_vec3_add(&body->acceleration, &body->acceleration, &body->gravity);
+		/* Do Verlet integration */
+		de_body_verlet(body, step->dt2);
+		/* Solve sphere-mesh collisions */
+		if (step->tree) {
+			de_body_collide_with_static_geometries(body, step->tree, task);
+		}
+	}
+}
+
+static void de_physics_gather_pairs_task(void* arg, size_t index)
+{
+	de_physics_step_t* step = arg;
+	de_physics_task_t* task = step->tasks + index;
+	const size_t begin = index * DE_PHYSICS_BODIES_PER_TASK;
+	const size_t end = begin + DE_PHYSICS_BODIES_PER_TASK < step->bodies.size ? begin + DE_PHYSICS_BODIES_PER_TASK : step->bodies.size;
+	DE_ARRAY_CLEAR(task->pairs);
+	for (size_t i = begin; i < end; ++i) {
+		de_body_t* body = step->bodies.data[i];
+		de_broadphase_query_pairs(step->broadphase, body, &step->bodies, &task->candidates);
+		for (size_t k = 0; k < task->candidates.size; ++k) {
+			de_body_t* other = task->candidates.data[k];
+			if ((body->sleeping && other->sleeping) ||
+				!de_collision_layers_match(body->collision_layer, body->collision_mask, other->collision_layer, other->collision_mask)) {
+				continue;
+			}
+			const float radius_sum = body->radius + other->radius;
+			if (de_vec3_sqr_distance(&body->position, &other->position) <= radius_sum * radius_sum) {
+				de_body_pair_t* pair = DE_ARRAY_GROW(task->pairs, 1);
+				pair->a = body;
+				pair->b = other;
+			}
+		}
+	}
+}
+
+static void de_physics_resolve_pairs_task(void* arg, size_t index)
+{
+	de_physics_step_t* step = arg;
+	const size_t begin = step->color_begin + index * DE_PHYSICS_PAIRS_PER_TASK;
+	const size_t end = begin + DE_PHYSICS_PAIRS_PER_TASK < step->color_end ? begin + DE_PHYSICS_PAIRS_PER_TASK : step->color_end;
+	for (size_t i = begin; i < end; ++i) {
+		const de_body_pair_t* pair = step->pairs.data + i;
+		de_body_body_collision(pair->a, pair->b);
+	}
+}
+
+/**
+ * @brief Merges pairs of tasks and sorts them by color, order of pairs inside of color is kept.
+ * Returns count of colors, colors array will contain offsets of colors.
+ */
+static size_t de_physics_color_pairs(de_physics_step_t* step)
+{
+	size_t pair_count = 0;
+	for (size_t i = 0; i < step->task_count; ++i) {
+		pair_count += step->tasks[i].pairs.size;
+	}
+	DE_ARRAY_CLEAR(step->pairs);
+	DE_ARRAY_CLEAR(step->colors);
+	if (!pair_count) {
+		return 0;
+	}
+
+	DE_ARRAY_CLEAR(step->next_color);
+	uint32_t* next_color = DE_ARRAY_GROW(step->next_color, step->bodies.size);
+	memset(next_color, 0, step->bodies.size * sizeof(uint32_t));
+
+	/* greedy coloring, every pair gets first color which is free for both bodies */
+	uint32_t color_count = 0;
+	uint32_t* colors = DE_ARRAY_GROW(step->colors, pair_count);
+	for (size_t i = 0, n = 0; i < step->task_count; ++i) {
+		const de_physics_task_t* task = step->tasks + i;
+		for (size_t k = 0; k < task->pairs.size; ++k, ++n) {
+			uint32_t* color_a = next_color + task->pairs.data[k].a->proxy.order;
+			uint32_t* color_b = next_color + task->pairs.data[k].b->proxy.order;
+			const uint32_t color = *color_a > *color_b ? *color_a : *color_b;
+			colors[n] = color;
+			*color_a = color + 1;
+			*color_b = color + 1;
+			if (color + 1 > color_count) {
+				color_count = color + 1;
+			}
+		}
+	}
+
+	/* counting sort by color */
+	uint32_t* offsets = DE_ARRAY_GROW(step->colors, color_count + 1);
+	colors = step->colors.data;
+	memset(offsets, 0, (color_count + 1) * sizeof(uint32_t));
+	for (size_t n = 0; n < pair_count; ++n) {
+		++offsets[colors[n] + 1];
+	}
+	for (uint32_t c = 0; c < color_count; ++c) {
+		offsets[c + 1] += offsets[c];
+	}
+	de_body_pair_t* pairs = DE_ARRAY_GROW(step->pairs, pair_count);
+	for (size_t i = 0, n = 0; i < step->task_count; ++i) {
+		const de_physics_task_t* task = step->tasks + i;
+		for (size_t k = 0; k < task->pairs.size; ++k, ++n) {
+			pairs[offsets[colors[n]]++] = task->pairs.data[k];
+		}
+	}
+	/* offsets were shifted by scatter, now offsets[c] is end of color c */
+	memmove(step->colors.data, offsets, color_count * sizeof(uint32_t));
+	step->colors.size = color_count;
+
+	return color_count;
+}
+
+static uint32_t de_physics_find_island(uint32_t* islands, uint32_t i)
+{
+	while (islands[i] != i) {
+		islands[i] = islands[islands[i]];
+		i = islands[i];
+	}
+	return i;
+}
+
+/**
+ * @brief Joins touching bodies into islands. Island falls asleep when each of its bodies was still
+ * for DE_BODY_SLEEP_TIME, otherwise every sleeping body of island is woken up.
+ */
+static void de_physics_update_islands(de_physics_step_t* step)
+{
+	const size_t count = step->bodies.size;
+	const float still_distance = DE_BODY_SLEEP_VELOCITY * step->dt;
+
+	DE_ARRAY_CLEAR(step->islands);
+	DE_ARRAY_CLEAR(step->island_awake);
+	uint32_t* islands = DE_ARRAY_GROW(step->islands, count);
+	bool* island_awake = DE_ARRAY_GROW(step->island_awake, count);
+	for (size_t i = 0; i < count; ++i) {
+		de_body_t* body = step->bodies.data[i];
+		islands[i] = (uint32_t)i;
+		island_awake[i] = false;
+		/* sleeping body can be moved only by push of awake body */
+		de_vec3_t velocity;
+		de_vec3_sub(&velocity, &body->position, &body->last_position);
+		if (de_vec3_sqr_len(&velocity) > still_distance * still_distance) {
+			body->still_time = 0.0f;
+		} else if (!body->sleeping) {
+			body->still_time += step->dt;
+		}
+	}
+
+	for (size_t i = 0; i < step->pairs.size; ++i) {
+		const uint32_t a = de_physics_find_island(islands, step->pairs.data[i].a->proxy.order);
+		const uint32_t b = de_physics_find_island(islands, step->pairs.data[i].b->proxy.order);
+		/* smaller index is root, so islands do not depend on order of pairs */
+		if (a < b) {
+			islands[b] = a;
+		} else if (b < a) {
+			islands[a] = b;
+		}
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		if (step->bodies.data[i]->still_time < DE_BODY_SLEEP_TIME) {
+			island_awake[de_physics_find_island(islands, (uint32_t)i)] = true;
+		}
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		de_body_t* body = step->bodies.data[i];
+		if (island_awake[de_physics_find_island(islands, (uint32_t)i)]) {
+			if (body->sleeping) {
+				de_body_wake_up(body);
+			}
+		} else if (!body->sleeping) {
+			body->sleeping = true;
+			/* drop residual velocity */
+			body->last_position = body->position;
+		}
+	}
+}
+
+static void de_physics_step_scene(de_physics_step_t* step, de_scene_t* scene)
+{
+	if (!scene->broadphase) {
+		scene->broadphase = de_broadphase_create(DE_BROADPHASE_DEFAULT_CELL_SIZE);
+	}
+	de_broadphase_t* bp = scene->broadphase;
+	step->broadphase = bp;
+
+	/* Refresh order of bodies, pairs are gathered and colored in this order */
+	DE_ARRAY_CLEAR(step->bodies);
+	DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
+	{
+		de_broadphase_update_body(bp, body);
+		body->proxy.order = (uint32_t)step->bodies.size;
+		DE_ARRAY_APPEND(step->bodies, body);
+	}
+	bp->next_order = (uint32_t)step->bodies.size;
+
+	step->task_count = (step->bodies.size + DE_PHYSICS_BODIES_PER_TASK - 1) / DE_PHYSICS_BODIES_PER_TASK;
+	if (step->task_count > step->task_capacity) {
+		step->tasks = de_realloc(step->tasks, step->task_count * sizeof(*step->tasks));
+		for (size_t i = step->task_capacity; i < step->task_count; ++i) {
+			de_physics_task_t* task = step->tasks + i;
+			de_bvh_query_init(&task->query);
+			de_bvh_query_init(&task->tree_query);
+			DE_ARRAY_INIT(task->geometries);
+			DE_ARRAY_INIT(task->candidates);
+			DE_ARRAY_INIT(task->pairs);
+		}
+		step->task_capacity = step->task_count;
+	}
+
+	/* queries to top-level tree must not allocate in workers */
+	const de_static_geometry_tree_t* tree = scene->static_geometry_tree;
+	step->tree = tree && tree->geometries.size ? tree : NULL;
+	if (step->tree) {
+		for (size_t i = 0; i < step->task_count; ++i) {
+			de_physics_task_t* task = step->tasks + i;
+			de_bvh_query_reserve(&task->tree_query, tree->bvh);
+			DE_ARRAY_RESERVE(task->geometries, tree->geometries.size);
+		}
+	}
+
+	de_thread_pool_parallel_for(step->pool, step->task_count, de_physics_integrate_task, step);
+
+	for (size_t i = 0; i < step->bodies.size; ++i) {
+		de_broadphase_update_body(bp, step->bodies.data[i]);
+	}
+
+	de_thread_pool_parallel_for(step->pool, step->task_count, de_physics_gather_pairs_task, step);
+
+	const size_t color_count = de_physics_color_pairs(step);
+	step->color_begin = 0;
+	for (size_t c = 0; c < color_count; ++c) {
+		step->color_end = step->colors.data[c];
+		const size_t count = step->color_end - step->color_begin;
+		if (count < DE_PHYSICS_MIN_PARALLEL_PAIRS) {
+			de_thread_pool_parallel_for(NULL, (count + DE_PHYSICS_PAIRS_PER_TASK - 1) / DE_PHYSICS_PAIRS_PER_TASK, de_physics_resolve_pairs_task, step);
+		} else {
+			de_thread_pool_parallel_for(step->pool, (count + DE_PHYSICS_PAIRS_PER_TASK - 1) / DE_PHYSICS_PAIRS_PER_TASK, de_physics_resolve_pairs_task, step);
+		}
+		step->color_begin = step->color_end;
+	}
+
+	de_physics_update_islands(step);
+
+	/* Keep broadphase actual for ray casts between steps */
+	for (size_t i = 0; i < step->bodies.size; ++i) {
+		de_broadphase_update_body(bp, step->bodies.data[i]);
+	}
 }
 
 void de_physics_step(de_core_t* core, double dt)
 {
-	const float dt2 = (float)(dt * dt);
+	de_physics_step_t step;
+	memset(&step, 0, sizeof(step));
+	step.pool = de_core_get_thread_pool(core);
+	step.dt = (float)dt;
+	step.dt2 = (float)(dt * dt);
 	DE_LINKED_LIST_FOR_EACH_T(de_scene_t*, scene, core->scenes)
 	{
+		if (scene->bodies.head) {
+			de_physics_step_scene(&step, scene);
+		}
+	}
+	for (size_t i = 0; i < step.task_capacity; ++i) {
+		de_physics_task_t* task = step.tasks + i;
+		de_bvh_query_free(&task->query);
+		de_bvh_query_free(&task->tree_query);
+		DE_ARRAY_FREE(task->geometries);
+		DE_ARRAY_FREE(task->candidates);
+		DE_ARRAY_FREE(task->pairs);
+	}
+	de_free(step.tasks);
+	DE_ARRAY_FREE(step.bodies);
+	DE_ARRAY_FREE(step.pairs);
+	DE_ARRAY_FREE(step.colors);
+	DE_ARRAY_FREE(step.next_color);
+	DE_ARRAY_FREE(step.islands);
+	DE_ARRAY_FREE(step.island_awake);
+}
+
+/**
+ * @brief Gathers bodies which can be hit by ray, in order of bodies in scene.
+ */
+static void de_ray_cast_gather_bodies(de_scene_t* scene, const de_ray_t* ray, de_body_array_t* candidates)
+{
+	if (!scene->broadphase || !de_broadphase_query_line(scene->broadphase, ray, candidates)) {
+		/* broadphase will not help, check everything */
+		DE_ARRAY_CLEAR(*candidates);
 		DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
 		{
-			/* Drop contact information */
-			body->contact_count = 0;
-			/* Apply gravity */
-			de_vec3_add(&body->acceleration, &body->acceleration, &body->gravity);
-			/* Do Verlet integration */
-			de_body_verlet(body, dt2);
-			/* Solve sphere-mesh collisions */
-			DE_LINKED_LIST_FOR_EACH_T(de_static_geometry_t*, geom, scene->static_geometries)
-			{
-				de_octree_trace_sphere(geom->octree, &body->position, body->radius);
-				for (int i = 0; i < geom->octree->trace_buffer.size; ++i) {
-					de_octree_node_t* node = geom->octree->trace_buffer.nodes[i];
-					for (int k = 0; k < node->index_count; ++k) {
-						de_body_triangle_collision(&geom->triangles.data[node->triangle_indices[k]], body);
-					}
-				}
-			}
-			/* Solve sphere-sphere collisions */
-			DE_LINKED_LIST_FOR_EACH_T(de_body_t*, other, scene->bodies)
-			{
-				if (other != body) {
-					de_body_body_collision(body, other);
-				}
-			}
+			DE_ARRAY_APPEND(*candidates, body);
 		}
 	}
 }
@@ -155,14 +1175,20 @@ static int de_ray_cast_result_distance_comparer(const void* a, const void* b)
 	return 0;
 }
 
-bool de_ray_cast(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, de_ray_cast_result_array_t* result_array)
+bool de_ray_cast(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, uint32_t layer_mask, de_ray_cast_result_array_t* result_array)
 {
 	bool hit = false;
 
 	/* check bodies */
 	if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_BODY)) {
-		DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
-		{
+		de_body_array_t candidates;
+		DE_ARRAY_INIT(candidates);
+		de_ray_cast_gather_bodies(scene, ray, &candidates);
+		for (size_t n = 0; n < candidates.size; ++n) {
+			de_body_t* body = candidates.data[n];
+			if (!(body->collision_layer & layer_mask)) {
+				continue;
+			}
 			if (flags & DE_RAY_CAST_FLAGS_IGNORE_BODY_IN_RAY) {
 				if (de_vec3_sqr_distance(&body->position, &ray->origin) <= body->radius * body->radius) {
 					continue;
@@ -182,30 +1208,51 @@ bool de_ray_cast(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t fla
 				}
 			}
 		}
+		DE_ARRAY_FREE(candidates);
 	}
 
-	/* check static geometries */
-	if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_STATIC_GEOMETRY)) {
-		DE_LINKED_LIST_FOR_EACH_T(de_static_geometry_t*, geom, scene->static_geometries)
-		{
-			de_octree_trace_ray(geom->octree, ray);
-			for (int i = 0; i < geom->octree->trace_buffer.size; ++i) {
-				de_octree_node_t* node = geom->octree->trace_buffer.nodes[i];
-				for (int k = 0; k < node->index_count; ++k) {
-					de_vec3_t intersection_point;
-					de_static_triangle_t* triangle = &geom->triangles.data[node->triangle_indices[k]];
-					if (de_ray_triangle_intersection(ray, &triangle->a, &triangle->b, &triangle->c, &intersection_point)) {
-						de_ray_cast_result_t* result = DE_ARRAY_GROW(*result_array, 1);
-						result->position = intersection_point;
-						result->normal = triangle->normal;
-						result->body = NULL;
-						result->triangle = triangle;
-						result->static_geometry = geom;
-						result->sqr_distance = de_vec3_sqr_distance(&intersection_point, &ray->origin);
+	/* check static geometries which bounds are hit by ray */
+	const de_static_geometry_tree_t* tree = scene->static_geometry_tree;
+	if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_STATIC_GEOMETRY) && tree && tree->geometries.size) {
+		de_bvh_query_t query;
+		de_bvh_query_init(&query);
+		de_bvh_query_reserve(&query, tree->bvh);
+		de_bvh_query_ray(tree->bvh, &query, ray);
+		uint32_t* indices = de_malloc(tree->geometries.size * sizeof(*indices));
+		const uint32_t geometry_count = de_static_geometry_tree_gather(tree, &query, indices);
+		for (uint32_t n = 0; n < geometry_count; ++n) {
+			de_static_geometry_t* geom = tree->geometries.data[indices[n]];
+			if (!(geom->collision_layer & layer_mask)) {
+				continue;
+			}
+			de_bvh_query_reserve(&query, geom->bvh);
+			de_bvh_query_ray(geom->bvh, &query, ray);
+			for (uint32_t i = 0; i < query.size; ++i) {
+				const de_bvh_node_t* leaf = geom->bvh->nodes + query.leafs[i];
+				const uint32_t end = leaf->offset + leaf->count;
+				for (size_t p = leaf->offset / DE_STATIC_TRIANGLE_PACK_SIZE; p * DE_STATIC_TRIANGLE_PACK_SIZE < end; ++p) {
+					const int candidates = de_static_triangle_pack_ray_mask(geom->packs + p, ray, de_static_triangle_pack_lanes(p, leaf->offset, end));
+					for (int k = 0; k < DE_STATIC_TRIANGLE_PACK_SIZE; ++k) {
+						if (!(candidates & (1 << k))) {
+							continue;
+						}
+						de_vec3_t intersection_point;
+						de_static_triangle_t* triangle = &geom->triangles.data[geom->bvh->indices[p * DE_STATIC_TRIANGLE_PACK_SIZE + k]];
+						if (de_ray_triangle_intersection(ray, &triangle->a, &triangle->b, &triangle->c, &intersection_point)) {
+							de_ray_cast_result_t* result = DE_ARRAY_GROW(*result_array, 1);
+							result->position = intersection_point;
+							result->normal = triangle->normal;
+							result->body = NULL;
+							result->triangle = triangle;
+							result->static_geometry = geom;
+							result->sqr_distance = de_vec3_sqr_distance(&intersection_point, &ray->origin);
+						}
 					}
 				}
 			}
 		}
+		de_free(indices);
+		de_bvh_query_free(&query);
 	}
 
 	if (flags & DE_RAY_CAST_FLAGS_SORT_RESULTS) {
@@ -215,7 +1262,175 @@ bool de_ray_cast(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t fla
 	return hit;
 }
 
-bool de_ray_cast_closest(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, de_ray_cast_result_t* result)
+typedef struct de_ray_cast_leaf_context_t {
+	const de_ray_t* ray;
+	const de_static_geometry_tree_t* tree;
+	uint32_t layer_mask;
+	de_static_geometry_t* geom;
+	de_ray_cast_result_t* result;
+	bool hit;
+} de_ray_cast_leaf_context_t;
+
+static bool de_ray_cast_closest_leaf(void* user_data, const de_bvh_t* bvh, const de_bvh_node_t* leaf, float* max_sqr_distance)
+{
+	de_ray_cast_leaf_context_t* ctx = user_data;
+	const uint32_t end = leaf->offset + leaf->count;
+	for (size_t p = leaf->offset / DE_STATIC_TRIANGLE_PACK_SIZE; p * DE_STATIC_TRIANGLE_PACK_SIZE < end; ++p) {
+		const int candidates = de_static_triangle_pack_ray_mask(ctx->geom->packs + p, ctx->ray, de_static_triangle_pack_lanes(p, leaf->offset, end));
+		for (int k = 0; k < DE_STATIC_TRIANGLE_PACK_SIZE; ++k) {
+			if (!(candidates & (1 << k))) {
+				continue;
+			}
+			de_vec3_t intersection_point;
+			de_static_triangle_t* triangle = &ctx->geom->triangles.data[bvh->indices[p * DE_STATIC_TRIANGLE_PACK_SIZE + k]];
+			if (de_ray_triangle_intersection(ctx->ray, &triangle->a, &triangle->b, &triangle->c, &intersection_point)) {
+				ctx->hit = true;
+				const float new_distance = de_vec3_sqr_distance(&ctx->ray->origin, &intersection_point);
+				if (new_distance < *max_sqr_distance) {
+					de_ray_cast_result_t* result = ctx->result;
+					result->position = intersection_point;
+					result->normal = triangle->normal;
+					result->body = NULL;
+					result->triangle = triangle;
+					result->static_geometry = ctx->geom;
+					result->sqr_distance = new_distance;
+					*max_sqr_distance = new_distance;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+static bool de_ray_cast_any_leaf(void* user_data, const de_bvh_t* bvh, const de_bvh_node_t* leaf, float* max_sqr_distance)
+{
+	de_ray_cast_leaf_context_t* ctx = user_data;
+	const uint32_t end = leaf->offset + leaf->count;
+	for (size_t p = leaf->offset / DE_STATIC_TRIANGLE_PACK_SIZE; p * DE_STATIC_TRIANGLE_PACK_SIZE < end; ++p) {
+		const int candidates = de_static_triangle_pack_ray_mask(ctx->geom->packs + p, ctx->ray, de_static_triangle_pack_lanes(p, leaf->offset, end));
+		for (int k = 0; k < DE_STATIC_TRIANGLE_PACK_SIZE; ++k) {
+			if (!(candidates & (1 << k))) {
+				continue;
+			}
+			de_vec3_t intersection_point;
+			const de_static_triangle_t* triangle = &ctx->geom->triangles.data[bvh->indices[p * DE_STATIC_TRIANGLE_PACK_SIZE + k]];
+			if (de_ray_triangle_intersection(ctx->ray, &triangle->a, &triangle->b, &triangle->c, &intersection_point)) {
+				if (de_vec3_sqr_distance(&ctx->ray->origin, &intersection_point) <= *max_sqr_distance) {
+					ctx->hit = true;
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief Leaf of top-level tree: geometries are traversed front-to-back too, closest hit
+ * found so far limits both trees.
+ */
+static bool de_ray_cast_closest_tree_leaf(void* user_data, const de_bvh_t* bvh, const de_bvh_node_t* leaf, float* max_sqr_distance)
+{
+	de_ray_cast_leaf_context_t* ctx = user_data;
+	for (uint32_t k = 0; k < leaf->count; ++k) {
+		de_static_geometry_t* geom = ctx->tree->geometries.data[bvh->indices[leaf->offset + k]];
+		if (geom->collision_layer & ctx->layer_mask) {
+			ctx->geom = geom;
+			de_bvh_traverse_ray_ordered(geom->bvh, ctx->ray, max_sqr_distance, de_ray_cast_closest_leaf, ctx);
+		}
+	}
+	return false;
+}
+
+static bool de_ray_cast_any_tree_leaf(void* user_data, const de_bvh_t* bvh, const de_bvh_node_t* leaf, float* max_sqr_distance)
+{
+	de_ray_cast_leaf_context_t* ctx = user_data;
+	for (uint32_t k = 0; k < leaf->count; ++k) {
+		de_static_geometry_t* geom = ctx->tree->geometries.data[bvh->indices[leaf->offset + k]];
+		if (geom->collision_layer & ctx->layer_mask) {
+			ctx->geom = geom;
+			de_bvh_traverse_ray_ordered(geom->bvh, ctx->ray, max_sqr_distance, de_ray_cast_any_leaf, ctx);
+			if (ctx->hit) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static bool de_ray_cast_is_body_ignored(const de_body_t* body, const de_ray_t* ray, de_ray_cast_flags_t flags, uint32_t layer_mask)
+{
+	if (!(body->collision_layer & layer_mask)) {
+		return true;
+	}
+	if (flags & DE_RAY_CAST_FLAGS_IGNORE_BODY_IN_RAY) {
+		return de_vec3_sqr_distance(&body->position, &ray->origin) <= body->radius * body->radius;
+	}
+	return false;
+}
+
+/**
+ * @brief Finds closest hit of ray among bodies. Returns true if there was any hit.
+ */
+static bool de_ray_cast_closest_bodies(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, uint32_t layer_mask,
+	de_ray_cast_result_t* result, float* closest_distance, de_body_array_t* candidates)
+{
+	bool hit = false;
+	de_ray_cast_gather_bodies(scene, ray, candidates);
+	for (size_t n = 0; n < candidates->size; ++n) {
+		de_body_t* body = candidates->data[n];
+		if (de_ray_cast_is_body_ignored(body, ray, flags, layer_mask)) {
+			continue;
+		}
+
+		de_vec3_t intersection_points[2];
+		if (de_ray_sphere_intersection(ray, &body->position, body->radius, &intersection_points[0], &intersection_points[1])) {
+			hit = true;
+			for (size_t i = 0; i < 2; ++i) {
+				const float new_distance = de_vec3_sqr_distance(&ray->origin, &intersection_points[i]);
+				if (new_distance < *closest_distance) {
+					result->position = intersection_points[i];
+					de_vec3_sub(&result->normal, &result->position, &body->position);
+					result->body = body;
+					result->triangle = NULL;
+					result->static_geometry = NULL;
+					result->sqr_distance = new_distance;
+					*closest_distance = new_distance;
+				}
+			}
+		}
+	}
+	return hit;
+}
+
+/**
+ * @brief Returns true if any body intersects segment of ray.
+ */
+static bool de_ray_cast_any_bodies(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, uint32_t layer_mask, de_body_array_t* candidates)
+{
+	const float dir_sqr_len = de_vec3_sqr_len(&ray->dir);
+	de_ray_cast_gather_bodies(scene, ray, candidates);
+	for (size_t n = 0; n < candidates->size; ++n) {
+		de_body_t* body = candidates->data[n];
+		if (de_ray_cast_is_body_ignored(body, ray, flags, layer_mask)) {
+			continue;
+		}
+		/* closest point of segment to center of body */
+		de_vec3_t to_center, closest;
+		de_vec3_sub(&to_center, &body->position, &ray->origin);
+		float t = dir_sqr_len > 0.0f ? de_vec3_dot(&to_center, &ray->dir) / dir_sqr_len : 0.0f;
+		t = de_clamp(t, 0.0f, 1.0f);
+		de_vec3_scale(&closest, &ray->dir, t);
+		de_vec3_add(&closest, &closest, &ray->origin);
+		if (de_vec3_sqr_distance(&closest, &body->position) <= body->radius * body->radius) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool de_ray_cast_closest_internal(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags,
+	uint32_t layer_mask, de_ray_cast_result_t* result, de_body_array_t* candidates)
 {
 	bool hit = false;
 
@@ -225,60 +1440,411 @@ bool de_ray_cast_closest(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_fla
 
 	/* check bodies */
 	if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_BODY)) {
-		DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
-		{
-			if (flags & DE_RAY_CAST_FLAGS_IGNORE_BODY_IN_RAY) {
-				if (de_vec3_sqr_distance(&body->position, &ray->origin) <= body->radius * body->radius) {
-					continue;
-				}
+		hit |= de_ray_cast_closest_bodies(scene, ray, flags, layer_mask, result, &closest_distance, candidates);
+	}
+
+	/* check static geometries, closest hit of bodies limits traversal */
+	const de_static_geometry_tree_t* tree = scene->static_geometry_tree;
+	if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_STATIC_GEOMETRY) && tree) {
+		de_ray_cast_leaf_context_t ctx;
+		ctx.ray = ray;
+		ctx.tree = tree;
+		ctx.layer_mask = layer_mask;
+		ctx.geom = NULL;
+		ctx.result = result;
+		ctx.hit = false;
+		de_bvh_traverse_ray_ordered(tree->bvh, ray, &closest_distance, de_ray_cast_closest_tree_leaf, &ctx);
+		hit |= ctx.hit;
+	}
+
+	return hit;
+}
+
+static bool de_ray_cast_any_internal(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, uint32_t layer_mask, de_body_array_t* candidates)
+{
+	/* check bodies */
+	if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_BODY)) {
+		if (de_ray_cast_any_bodies(scene, ray, flags, layer_mask, candidates)) {
+			return true;
+		}
+	}
+
+	/* check static geometries */
+	const de_static_geometry_tree_t* tree = scene->static_geometry_tree;
+	if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_STATIC_GEOMETRY) && tree) {
+		de_ray_cast_leaf_context_t ctx;
+		ctx.ray = ray;
+		ctx.tree = tree;
+		ctx.layer_mask = layer_mask;
+		ctx.geom = NULL;
+		ctx.result = NULL;
+		ctx.hit = false;
+		float max_sqr_distance = de_vec3_sqr_len(&ray->dir);
+		de_bvh_traverse_ray_ordered(tree->bvh, ray, &max_sqr_distance, de_ray_cast_any_tree_leaf, &ctx);
+		if (ctx.hit) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool de_ray_cast_closest(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, uint32_t layer_mask, de_ray_cast_result_t* result)
+{
+	DE_ASSERT(scene);
+	DE_ASSERT(ray);
+	DE_ASSERT(result);
+	de_body_array_t candidates;
+	DE_ARRAY_INIT(candidates);
+	const bool hit = de_ray_cast_closest_internal(scene, ray, flags, layer_mask, result, &candidates);
+	DE_ARRAY_FREE(candidates);
+	return hit;
+}
+
+bool de_ray_cast_any(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, uint32_t layer_mask)
+{
+	DE_ASSERT(scene);
+	DE_ASSERT(ray);
+	de_body_array_t candidates;
+	DE_ARRAY_INIT(candidates);
+	const bool hit = de_ray_cast_any_internal(scene, ray, flags, layer_mask, &candidates);
+	DE_ARRAY_FREE(candidates);
+	return hit;
+}
+
+#define DE_RAY_BATCH_UNITS_PER_CHUNK (16)
+
+/**
+ * @brief Either packet of coherent rays or one ray, indices of items of batch.
+ */
+typedef struct de_ray_batch_unit_t {
+	uint32_t items[DE_BVH_PACKET_SIZE];
+	uint32_t count;
+} de_ray_batch_unit_t;
+
+typedef struct de_ray_batch_key_t {
+	uint64_t key;
+	uint32_t index;
+} de_ray_batch_key_t;
+
+typedef struct de_ray_batch_t {
+	de_scene_t* scene;
+	de_ray_batch_item_t* items;
+	de_ray_batch_unit_t* units;
+	size_t unit_count;
+	de_body_array_t* candidates; /**< One array per chunk of units */
+} de_ray_batch_t;
+
+typedef struct de_ray_packet_leaf_context_t {
+	de_ray_batch_item_t* items[DE_BVH_PACKET_SIZE];
+	const de_static_geometry_tree_t* tree;
+	bool any_hit;
+	de_static_geometry_t* geom;
+	bool hit[DE_BVH_PACKET_SIZE];
+} de_ray_packet_leaf_context_t;
+
+static int de_ray_batch_key_comparer(const void* a, const void* b)
+{
+	const de_ray_batch_key_t* key_a = a;
+	const de_ray_batch_key_t* key_b = b;
+	if (key_a->key != key_b->key) {
+		return key_a->key < key_b->key ? -1 : 1;
+	}
+	return key_a->index < key_b->index ? -1 : (key_a->index > key_b->index ? 1 : 0);
+}
+
+static uint32_t de_ray_batch_spread_bits(uint32_t v)
+{
+	v &= 0x3FF;
+	v = (v | (v << 16)) & 0x030000FF;
+	v = (v | (v << 8)) & 0x0300F00F;
+	v = (v | (v << 4)) & 0x030C30C3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+/**
+ * @brief Conservative test of triangle (lane of pack) against every ray of packet, returns mask
+ * of rays which may hit triangle. These rays are checked precisely later, so results are the
+ * same as for single ray cast.
+ */
+static int de_ray_packet_triangle_mask(const de_bvh_ray_packet_t* p, const de_static_triangle_pack_t* pack, int lane, int mask)
+{
+#if DE_SSE
+	return mask & de_moller_trumbore_mask_sse(
+		_mm_loadu_ps(p->origin_x), _mm_loadu_ps(p->origin_y), _mm_loadu_ps(p->origin_z),
+		_mm_loadu_ps(p->dir_x), _mm_loadu_ps(p->dir_y), _mm_loadu_ps(p->dir_z),
+		_mm_set1_ps(pack->a_x[lane]), _mm_set1_ps(pack->a_y[lane]), _mm_set1_ps(pack->a_z[lane]),
+		_mm_set1_ps(pack->ba_x[lane]), _mm_set1_ps(pack->ba_y[lane]), _mm_set1_ps(pack->ba_z[lane]),
+		_mm_set1_ps(pack->ca_x[lane]), _mm_set1_ps(pack->ca_y[lane]), _mm_set1_ps(pack->ca_z[lane]));
+#else
+	const de_vec3_t a = { pack->a_x[lane], pack->a_y[lane], pack->a_z[lane] };
+	const de_vec3_t e1 = { pack->ba_x[lane], pack->ba_y[lane], pack->ba_z[lane] };
+	const de_vec3_t e2 = { pack->ca_x[lane], pack->ca_y[lane], pack->ca_z[lane] };
+	int result = 0;
+	for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+		if (mask & (1 << i)) {
+			const de_vec3_t origin = { p->origin_x[i], p->origin_y[i], p->origin_z[i] };
+			const de_vec3_t dir = { p->dir_x[i], p->dir_y[i], p->dir_z[i] };
+			if (de_moller_trumbore_maybe(&origin, &dir, &a, &e1, &e2)) {
+				result |= 1 << i;
 			}
+		}
+	}
+	return result;
+#endif
+}
 
-			de_vec3_t intersection_points[2];
-			if (de_ray_sphere_intersection(ray, &body->position, body->radius, &intersection_points[0], &intersection_points[1])) {
-				hit = true;
-				for (size_t i = 0; i < 2; ++i) {
-					const float new_distance = de_vec3_sqr_distance(&ray->origin, &intersection_points[i]);
-					if (new_distance < closest_distance) {
-						result->position = intersection_points[i];
-						de_vec3_sub(&result->normal, &result->position, &body->position);
-						result->body = body;
-						result->triangle = NULL;
-						result->static_geometry = NULL;
-						result->sqr_distance = new_distance;
-						closest_distance = new_distance;
-					}
+static int de_ray_packet_closest_leaf(void* user_data, const de_bvh_t* bvh, const de_bvh_node_t* leaf, de_bvh_ray_packet_t* packet, int mask)
+{
+	de_ray_packet_leaf_context_t* ctx = user_data;
+	for (uint32_t k = 0; k < leaf->count; ++k) {
+		const uint32_t index = leaf->offset + k;
+		de_static_triangle_t* triangle = &ctx->geom->triangles.data[bvh->indices[index]];
+		const int candidates = de_ray_packet_triangle_mask(packet, ctx->geom->packs + index / DE_STATIC_TRIANGLE_PACK_SIZE, index % DE_STATIC_TRIANGLE_PACK_SIZE, mask);
+		for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+			if (!(candidates & (1 << i))) {
+				continue;
+			}
+			de_ray_batch_item_t* item = ctx->items[i];
+			de_vec3_t intersection_point;
+			if (de_ray_triangle_intersection(&item->ray, &triangle->a, &triangle->b, &triangle->c, &intersection_point)) {
+				ctx->hit[i] = true;
+				const float new_distance = de_vec3_sqr_distance(&item->ray.origin, &intersection_point);
+				if (new_distance < packet->max_sqr_distance[i]) {
+					item->result.position = intersection_point;
+					item->result.normal = triangle->normal;
+					item->result.body = NULL;
+					item->result.triangle = triangle;
+					item->result.static_geometry = ctx->geom;
+					item->result.sqr_distance = new_distance;
+					packet->max_sqr_distance[i] = new_distance;
 				}
 			}
 		}
 	}
+	return 0;
+}
 
-	/* check static geometries */
-	if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_STATIC_GEOMETRY)) {
-		DE_LINKED_LIST_FOR_EACH_T(de_static_geometry_t*, geom, scene->static_geometries)
-		{
-			de_octree_trace_ray(geom->octree, ray);
-			for (int i = 0; i < geom->octree->trace_buffer.size; ++i) {
-				de_octree_node_t* node = geom->octree->trace_buffer.nodes[i];
-				for (int k = 0; k < node->index_count; ++k) {
-					de_vec3_t intersection_point;
-					de_static_triangle_t* triangle = &geom->triangles.data[node->triangle_indices[k]];
-					if (de_ray_triangle_intersection(ray, &triangle->a, &triangle->b, &triangle->c, &intersection_point)) {
-						hit = true;
-						const float new_distance = de_vec3_sqr_distance(&ray->origin, &intersection_point);
-						if (new_distance < closest_distance) {
-							result->position = intersection_point;
-							result->normal = triangle->normal;
-							result->body = NULL;
-							result->triangle = triangle;
-							result->static_geometry = geom;
-							result->sqr_distance = new_distance;
-							closest_distance = new_distance;
-						}
-					}
+static int de_ray_packet_any_leaf(void* user_data, const de_bvh_t* bvh, const de_bvh_node_t* leaf, de_bvh_ray_packet_t* packet, int mask)
+{
+	de_ray_packet_leaf_context_t* ctx = user_data;
+	int done = 0;
+	for (uint32_t k = 0; k < leaf->count && mask; ++k) {
+		const uint32_t index = leaf->offset + k;
+		const de_static_triangle_t* triangle = &ctx->geom->triangles.data[bvh->indices[index]];
+		const int candidates = de_ray_packet_triangle_mask(packet, ctx->geom->packs + index / DE_STATIC_TRIANGLE_PACK_SIZE, index % DE_STATIC_TRIANGLE_PACK_SIZE, mask);
+		for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+			if (!(candidates & (1 << i))) {
+				continue;
+			}
+			const de_ray_t* ray = &ctx->items[i]->ray;
+			de_vec3_t intersection_point;
+			if (de_ray_triangle_intersection(ray, &triangle->a, &triangle->b, &triangle->c, &intersection_point) &&
+				de_vec3_sqr_distance(&ray->origin, &intersection_point) <= packet->max_sqr_distance[i]) {
+				ctx->hit[i] = true;
+				done |= 1 << i;
+				mask &= ~(1 << i);
+			}
+		}
+	}
+	return done;
+}
+
+/**
+ * @brief Leaf of top-level tree: packet goes into each geometry with rays which layer masks
+ * accept it. Returns rays which are done (any-hit queries).
+ */
+static int de_ray_packet_tree_leaf(void* user_data, const de_bvh_t* bvh, const de_bvh_node_t* leaf, de_bvh_ray_packet_t* packet, int mask)
+{
+	de_ray_packet_leaf_context_t* ctx = user_data;
+	int done = 0;
+	for (uint32_t k = 0; k < leaf->count && mask; ++k) {
+		de_static_geometry_t* geom = ctx->tree->geometries.data[bvh->indices[leaf->offset + k]];
+		int geom_mask = 0;
+		for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+			if (ctx->items[i]->layer_mask & geom->collision_layer) {
+				geom_mask |= 1 << i;
+			}
+		}
+		geom_mask &= mask;
+		if (!geom_mask) {
+			continue;
+		}
+		ctx->geom = geom;
+		if (ctx->any_hit) {
+			de_bvh_traverse_ray_packet(geom->bvh, packet, geom_mask, de_ray_packet_any_leaf, ctx);
+			for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+				if (ctx->hit[i] && (mask & (1 << i))) {
+					done |= 1 << i;
+					mask &= ~(1 << i);
 				}
 			}
+		} else {
+			de_bvh_traverse_ray_packet(geom->bvh, packet, geom_mask, de_ray_packet_closest_leaf, ctx);
 		}
 	}
+	return done;
+}
 
-	return hit;
-}
\ No newline at end of file
+static void de_ray_batch_process_packet(de_ray_batch_t* batch, const de_ray_batch_unit_t* unit, de_body_array_t* candidates)
+{
+	de_ray_packet_leaf_context_t ctx;
+	const de_ray_t* rays[DE_BVH_PACKET_SIZE];
+	de_bvh_ray_packet_t packet;
+	for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+		ctx.items[i] = batch->items + unit->items[i];
+		ctx.hit[i] = false;
+		rays[i] = &ctx.items[i]->ray;
+	}
+	de_bvh_ray_packet_set(&packet, rays);
+
+	/* every ray of packet has same flags */
+	const de_ray_cast_flags_t flags = ctx.items[0]->flags;
+	const bool any_hit = (flags & DE_RAY_CAST_FLAGS_ANY_HIT) != 0;
+
+	/* bodies are checked per ray, their closest hits limit traversal of static geometry */
+	int mask = 0;
+	for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+		de_ray_batch_item_t* item = ctx.items[i];
+		if (any_hit) {
+			packet.max_sqr_distance[i] = packet.dir_sqr_len[i];
+			if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_BODY)) {
+				ctx.hit[i] = de_ray_cast_any_bodies(batch->scene, &item->ray, flags, item->layer_mask, candidates);
+			}
+		} else {
+			item->result.position = (de_vec3_t) { FLT_MAX, FLT_MAX, FLT_MAX };
+			packet.max_sqr_distance[i] = FLT_MAX;
+			if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_BODY)) {
+				ctx.hit[i] = de_ray_cast_closest_bodies(batch->scene, &item->ray, flags, item->layer_mask, &item->result, &packet.max_sqr_distance[i], candidates);
+			}
+		}
+		if (!any_hit || !ctx.hit[i]) {
+			mask |= 1 << i;
+		}
+	}
+
+	/* whole packet goes through top-level tree, then through geometries in its leafs */
+	ctx.tree = batch->scene->static_geometry_tree;
+	ctx.any_hit = any_hit;
+	ctx.geom = NULL;
+	if (!(flags & DE_RAY_CAST_FLAGS_IGNORE_STATIC_GEOMETRY) && ctx.tree) {
+		de_bvh_traverse_ray_packet(ctx.tree->bvh, &packet, mask, de_ray_packet_tree_leaf, &ctx);
+	}
+
+	for (int i = 0; i < DE_BVH_PACKET_SIZE; ++i) {
+		ctx.items[i]->hit = ctx.hit[i];
+	}
+}
+
+static void de_ray_batch_process_chunk(void* arg, size_t chunk)
+{
+	de_ray_batch_t* batch = arg;
+	de_body_array_t* candidates = batch->candidates + chunk;
+	const size_t begin = chunk * DE_RAY_BATCH_UNITS_PER_CHUNK;
+	size_t end = begin + DE_RAY_BATCH_UNITS_PER_CHUNK;
+	if (end > batch->unit_count) {
+		end = batch->unit_count;
+	}
+	for (size_t i = begin; i < end; ++i) {
+		const de_ray_batch_unit_t* unit = batch->units + i;
+		if (unit->count == DE_BVH_PACKET_SIZE) {
+			de_ray_batch_process_packet(batch, unit, candidates);
+		} else {
+			de_ray_batch_item_t* item = batch->items + unit->items[0];
+			if (item->flags & DE_RAY_CAST_FLAGS_ANY_HIT) {
+				item->hit = de_ray_cast_any_internal(batch->scene, &item->ray, item->flags, item->layer_mask, candidates);
+			} else {
+				item->hit = de_ray_cast_closest_internal(batch->scene, &item->ray, item->flags, item->layer_mask, &item->result, candidates);
+			}
+		}
+	}
+}
+
+void de_ray_cast_batch(de_scene_t* scene, de_ray_batch_item_t* items, size_t count, de_thread_pool_t* pool)
+{
+	DE_ASSERT(scene);
+	DE_ASSERT(items || !count);
+	DE_ASSERT(count < UINT32_MAX);
+
+	if (!count) {
+		return;
+	}
+
+	/* sort rays so that rays with same flags and direction octant and close origins are adjacent */
+	de_vec3_t min = { FLT_MAX, FLT_MAX, FLT_MAX };
+	de_vec3_t max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = 0; i < count; ++i) {
+		de_vec3_min_max(&items[i].ray.origin, &min, &max);
+	}
+	de_vec3_t scale;
+	de_vec3_sub(&scale, &max, &min);
+	scale.x = scale.x > 0.0f ? 1023.0f / scale.x : 0.0f;
+	scale.y = scale.y > 0.0f ? 1023.0f / scale.y : 0.0f;
+	scale.z = scale.z > 0.0f ? 1023.0f / scale.z : 0.0f;
+
+	de_ray_batch_key_t* keys = de_malloc(count * sizeof(*keys));
+	for (size_t i = 0; i < count; ++i) {
+		const de_ray_batch_item_t* item = items + i;
+		int octant;
+		keys[i].index = (uint32_t)i;
+		if (de_bvh_ray_packet_is_coherent(&item->ray, &octant)) {
+			const uint32_t x = (uint32_t)((item->ray.origin.x - min.x) * scale.x);
+			const uint32_t y = (uint32_t)((item->ray.origin.y - min.y) * scale.y);
+			const uint32_t z = (uint32_t)((item->ray.origin.z - min.z) * scale.z);
+			const uint32_t morton = de_ray_batch_spread_bits(x) | (de_ray_batch_spread_bits(y) << 1) | (de_ray_batch_spread_bits(z) << 2);
+			keys[i].key = ((uint64_t)((uint32_t)item->flags & 0xFFFFFF) << 35) | ((uint64_t)octant << 32) | morton;
+		} else {
+			keys[i].key = UINT64_MAX;
+		}
+	}
+	qsort(keys, count, sizeof(*keys), de_ray_batch_key_comparer);
+
+	/* group runs of rays with same flags and octant into packets, rest is traced one by one */
+	de_ray_batch_t batch;
+	batch.scene = scene;
+	batch.items = items;
+	batch.units = de_malloc(count * sizeof(*batch.units));
+	batch.unit_count = 0;
+	for (size_t i = 0; i < count;) {
+		de_ray_batch_unit_t* unit = batch.units + batch.unit_count++;
+		const uint64_t group = keys[i].key >> 32;
+		size_t n = 1;
+		if (keys[i].key != UINT64_MAX) {
+			while (n < DE_BVH_PACKET_SIZE && i + n < count && keys[i + n].key != UINT64_MAX && (keys[i + n].key >> 32) == group) {
+				++n;
+			}
+		}
+		if (n < DE_BVH_PACKET_SIZE) {
+			n = 1;
+		}
+		unit->count = (uint32_t)n;
+		for (size_t k = 0; k < n; ++k) {
+			unit->items[k] = keys[i + k].index;
+		}
+		i += n;
+	}
+	de_free(keys);
+
+	/* candidate arrays are prepared here, so workers will rarely need to allocate */
+	size_t body_count = 0;
+	DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
+	{
+		++body_count;
+	}
+	const size_t chunk_count = (batch.unit_count + DE_RAY_BATCH_UNITS_PER_CHUNK - 1) / DE_RAY_BATCH_UNITS_PER_CHUNK;
+	batch.candidates = de_calloc(chunk_count, sizeof(*batch.candidates));
+	if (body_count) {
+		for (size_t i = 0; i < chunk_count; ++i) {
+			DE_ARRAY_RESERVE(batch.candidates[i], body_count);
+		}
+	}
+
+	de_thread_pool_parallel_for(pool, chunk_count, de_ray_batch_process_chunk, &batch);
+
+	for (size_t i = 0; i < chunk_count; ++i) {
+		DE_ARRAY_FREE(batch.candidates[i]);
+	}
+	de_free(batch.candidates);
+	de_free(batch.units);
+}
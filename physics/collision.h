@@ -22,31 +22,62 @@
 /**
 * @class de_static_triangle_t
 * @brief Static triangle for static collision geometry
+*
+* Edges, edge rays and plane of triangle are not stored, narrow phase computes them on demand
+* or takes them from de_static_triangle_pack_t.
 */
 struct de_static_triangle_t {
 	de_vec3_t normal; /**< Normal of triangle */
 	de_vec3_t a;      /**< Vertex of triangle */
 	de_vec3_t b;      /**< Vertex of triangle */
 	de_vec3_t c;      /**< Vertex of triangle */
-	de_vec3_t ab;     /**< Edge of triangle */
-	de_vec3_t bc;     /**< Edge of triangle */
-	de_vec3_t ca;     /**< Edge of triangle */
-	de_vec3_t ba;     /**< Edge of triangle */
-	float caDotca;    /**< Precalculated dot product between edges */
-	float caDotba;    /**< Precalculated dot product between edges */
-	float baDotba;    /**< Precalculated dot product between edges */
-	float invDenom;   /**< Inverse denominator for barycentric point-in-triangle method */
-	de_ray_t ab_ray;  /**< Precalculated edge ray */
-	de_ray_t bc_ray;  /**< Precalculated edge ray */
-	de_ray_t ca_ray;  /**< Precalculated edge ray */
-	float distance;   /**< Precalculated distance to the origin (d component of plane equation) */
 };
 
+#define DE_STATIC_TRIANGLE_PACK_SIZE (4)
+
+/**
+* @brief Four triangles of static geometry in SoA layout, used by SIMD narrow phase.
+* Stores everything ray rejection test and exact sphere test need, so narrow phase does not
+* touch de_static_triangle_t until contact is found.
+*/
+typedef struct de_static_triangle_pack_t {
+	float a_x[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float a_y[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float a_z[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float b_x[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float b_y[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float b_z[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float c_x[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float c_y[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float c_z[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float ba_x[DE_STATIC_TRIANGLE_PACK_SIZE]; /**< Edge b - a */
+	float ba_y[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float ba_z[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float ca_x[DE_STATIC_TRIANGLE_PACK_SIZE]; /**< Edge c - a */
+	float ca_y[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float ca_z[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float cb_x[DE_STATIC_TRIANGLE_PACK_SIZE]; /**< Edge c - b */
+	float cb_y[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float cb_z[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float n_x[DE_STATIC_TRIANGLE_PACK_SIZE];      /**< Normal of plane of triangle */
+	float n_y[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float n_z[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float distance[DE_STATIC_TRIANGLE_PACK_SIZE];  /**< d component of plane equation */
+	float ba_dot_ba[DE_STATIC_TRIANGLE_PACK_SIZE]; /**< Precalculated dot products for barycentric "point-in-triangle" method */
+	float ca_dot_ba[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float ca_dot_ca[DE_STATIC_TRIANGLE_PACK_SIZE];
+	float inv_denom[DE_STATIC_TRIANGLE_PACK_SIZE];
+} de_static_triangle_pack_t;
+
+#define DE_STATIC_GEOMETRY_MAX_TRIANGLES_PER_LEAF (8)
+#define DE_STATIC_GEOMETRY_TREE_MAX_GEOMETRIES_PER_LEAF (2)
+
 typedef enum de_ray_cast_flags_t {
 	DE_RAY_CAST_FLAGS_IGNORE_BODY = DE_BIT(0),
 	DE_RAY_CAST_FLAGS_IGNORE_STATIC_GEOMETRY = DE_BIT(1),
 	DE_RAY_CAST_FLAGS_SORT_RESULTS = DE_BIT(2), /**< Results will be sorted from closest to farthest (closest will be first in array) */
 	DE_RAY_CAST_FLAGS_IGNORE_BODY_IN_RAY = DE_BIT(3), /**< Bodies that contain ray origin will be ignored. Useful option if you need to cast a ray from some body, i.e. player. */
+	DE_RAY_CAST_FLAGS_ANY_HIT = DE_BIT(4), /**< de_ray_cast_batch only: occlusion query as in de_ray_cast_any, result of item is not filled. */
 } de_ray_cast_flags_t;
 
 typedef struct de_ray_cast_result_t {
@@ -63,6 +94,17 @@ typedef struct de_ray_cast_result_t {
  */
 typedef DE_ARRAY_DECLARE(de_ray_cast_result_t, de_ray_cast_result_array_t);
 
+/**
+ * @brief Single ray of de_ray_cast_batch.
+ */
+typedef struct de_ray_batch_item_t {
+	de_ray_t ray;               /**< Input ray */
+	de_ray_cast_flags_t flags;  /**< Input flags, DE_RAY_CAST_FLAGS_ANY_HIT switches item to occlusion query */
+	uint32_t layer_mask;        /**< Input: only objects with any of these layers can be hit */
+	bool hit;                   /**< Output: true if there was any hit */
+	de_ray_cast_result_t result; /**< Output: closest hit, valid if hit is true and query is not occlusion query */
+} de_ray_batch_item_t;
+
 /**
 * @class de_static_geometry_t
 * @brief Static collision geometry
@@ -73,8 +115,29 @@ typedef DE_ARRAY_DECLARE(de_ray_cast_result_t, de_ray_cast_result_array_t);
 struct de_static_geometry_t {
 	DE_LINKED_LIST_ITEM(struct de_static_geometry_t);
 	de_scene_t* scene;
-	de_octree_t* octree;
+	de_bvh_t* bvh;    /**< Acceleration structure, built by de_static_geometry_build */
 	DE_ARRAY_DECLARE(de_static_triangle_t, triangles); /**< Array of de_static_triangle_t. All geometry stored here */
+	de_static_triangle_pack_t* packs; /**< Internal. Triangles in order of bvh->indices, packed by four */
+	size_t pack_count;
+	uint32_t collision_layer; /**< Bits of layers geometry belongs to */
+	uint32_t collision_mask;  /**< Bits of layers of bodies geometry collides with */
+	uint32_t tree_index;      /**< Private. Index in top-level tree of scene, DE_STATIC_GEOMETRY_NOT_IN_TREE if geometry is empty */
+};
+
+#define DE_STATIC_GEOMETRY_NOT_IN_TREE (UINT32_MAX)
+
+/**
+ * @brief Top-level tree over static geometries of scene. Leafs of BVH reference geometries
+ * instead of triangles, so collisions and ray casts visit only geometries whose bounds are
+ * touched. Tree is bulk-loaded when set of non-empty geometries changes (geometry is built for
+ * the first time, became empty or freed) and refitted when existing geometry is rebuilt.
+ */
+struct de_static_geometry_tree_t {
+	de_bvh_t* bvh; /**< Indices of BVH are indices in arrays below */
+	uint32_t revision; /**< Changed on every rebuild, refit and change of layers, contact caches of bodies are checked against it */
+	DE_ARRAY_DECLARE(de_static_geometry_t*, geometries); /**< Non-empty geometries in order of scene list */
+	DE_ARRAY_DECLARE(de_vec3_t, min); /**< Bounds of geometries */
+	DE_ARRAY_DECLARE(de_vec3_t, max);
 };
 
 /**
@@ -84,6 +147,30 @@ struct de_static_geometry_t {
 */
 void de_static_geometry_fill(de_static_geometry_t* geom, const de_mesh_t* mesh, const de_mat4_t transform);
 
+/**
+* @brief Builds acceleration structures of static geometry. Must be called after triangles
+* were added by de_static_geometry_add_triangle, until then geometry does not participate in
+* collisions and ray casts. de_static_geometry_fill calls it automatically.
+*/
+void de_static_geometry_build(de_static_geometry_t* geom);
+
+/**
+* @brief Sets bits of layers geometry belongs to and bits of layers of bodies it collides with.
+* Bodies near geometry are woken up.
+*/
+void de_static_geometry_set_collision_layers(de_static_geometry_t* geom, uint32_t layer, uint32_t mask);
+
+/**
+* @brief Bulk-loads top-level tree over static geometries of scene. Called automatically when
+* geometry is built or freed.
+*/
+void de_static_geometry_tree_rebuild(de_scene_t* scene);
+
+/**
+* @brief Frees top-level tree. NULL is allowed.
+*/
+void de_static_geometry_tree_free(de_static_geometry_tree_t* tree);
+
 /**
 * @brief Adds new triangle to static geometry
 * @param geom pointer to static geometry
@@ -95,20 +182,78 @@ bool de_static_geometry_add_triangle(de_static_geometry_t* geom, const de_vec3_t
 
 /**
  * @brief Performs ray cast. Always return result for closest hit. Flags can be used to choose
- * types of entities that should participate in ray cast. Returns true if there was any hit.
+ * types of entities that should participate in ray cast, only bodies and geometries with layers
+ * in layer_mask are checked (DE_COLLISION_MASK_ALL to check everything). Returns true if there
+ * was any hit.
+ *
+ * Static geometries (through top-level tree) and their triangles are traversed front-to-back,
+ * subtrees farther than closest hit found so far are skipped.
+ */
+bool de_ray_cast_closest(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, uint32_t layer_mask, de_ray_cast_result_t* result);
+
+/**
+ * @brief Occlusion query: returns true if anything intersects segment [origin; origin + dir].
+ * Stops at first found intersection, so it is much cheaper than de_ray_cast_closest and
+ * should be used for visibility checks. DE_RAY_CAST_FLAGS_SORT_RESULTS is ignored.
+ */
+bool de_ray_cast_any(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, uint32_t layer_mask);
+
+/**
+ * @brief Performs many ray casts at once, results are the same as of de_ray_cast_closest or
+ * de_ray_cast_any (if item has DE_RAY_CAST_FLAGS_ANY_HIT) called for each item.
+ *
+ * Rays are sorted by flags, direction octant and origin, groups of coherent rays are traced
+ * through static geometry as SIMD packets. Work is split between threads of pool (can be NULL).
+ * Scene must not be modified during call.
  */
-bool de_ray_cast_closest(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, de_ray_cast_result_t* result);
+void de_ray_cast_batch(de_scene_t* scene, de_ray_batch_item_t* items, size_t count, de_thread_pool_t* pool);
 
 /**
  * @brief Performs ray cast and fills array with intersection result for every picked entity.
- * Flags can be used to choose types of entities that should participate in ray cast. 
+ * Flags and layer_mask can be used to choose entities that should participate in ray cast.
  * Returns true if there was any hit.
  */
-bool de_ray_cast(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, de_ray_cast_result_array_t* result_array);
+bool de_ray_cast(de_scene_t* scene, const de_ray_t* ray, de_ray_cast_flags_t flags, uint32_t layer_mask, de_ray_cast_result_array_t* result_array);
 
 /**
 * @brief Calculates physics for one frame
 */
 void de_physics_step(de_core_t* core, double dt);
 
+/**
+* @brief Returns count of sleeping bodies of scene, useful for profiling.
+*/
+size_t de_physics_get_sleeping_body_count(const de_scene_t* scene);
+
+/**
+* @brief Returns size in bytes of snapshot of bodies of scene, see de_physics_save_snapshot.
+*/
+size_t de_physics_get_snapshot_size(const de_scene_t* scene);
+
+/**
+* @brief Writes compact binary snapshot of state of every body of scene (positions, velocities,
+* gravity, radius, layers, sleep state, contacts) into caller-provided buffer, in order of bodies.
+* Does not allocate memory. Returns count of written bytes, zero if buffer is too small.
+*
+* Snapshot is meant for rollback, replays and look-ahead within one run of application: it is
+* not portable between builds and platforms, use de_body_visit for save games.
+*/
+size_t de_physics_save_snapshot(de_scene_t* scene, void* buffer, size_t buffer_size);
+
+/**
+* @brief Restores state of bodies from snapshot made by de_physics_save_snapshot. Scene must have
+* the same count of bodies as when snapshot was made, state is restored in order of bodies.
+* Contacts are restored as well, since physics step does not collide sleeping bodies. They are
+* stored as indices of body in scene and of triangle in static geometry, snapshot is rejected if
+* any index does not resolve. Returns false if snapshot does not match scene, scene is not
+* modified then.
+*/
+bool de_physics_load_snapshot(de_scene_t* scene, const void* buffer, size_t buffer_size);
+
+/**
+* @brief Wakes up every sleeping body near static geometry. Called automatically when geometry
+* is rebuilt or freed, must be called manually if triangles were changed directly.
+*/
+void de_static_geometry_wake_bodies(de_static_geometry_t* geom);
+
 bool de_static_triangle_contains_point(const de_static_triangle_t* triangle, const de_vec3_t* point);
\ No newline at end of file
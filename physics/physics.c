@@ -19,6 +19,7 @@
 * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
-#include "physics/octree.c"
+#include "physics/bvh.c"
+#include "physics/broadphase.c"
 #include "physics/body.c"
 #include "physics/collision.c"
\ No newline at end of file
@@ -22,6 +22,21 @@
 #define DE_MAX_CONTACTS (8)
 #define DE_AIR_FRICTION (0.003f)
 
+/* Collision layers: two objects interact only if layer of each of them is in mask of other one.
+ * Ray casts hit only objects with layer in layer mask of ray. */
+#define DE_COLLISION_LAYER_DEFAULT (1u)
+#define DE_COLLISION_MASK_ALL (0xFFFFFFFFu)
+
+/* Body which moves slower than this (units per second) is considered still */
+#define DE_BODY_SLEEP_VELOCITY (0.05f)
+/* Island of touching bodies falls asleep when every its body was still for this time (seconds) */
+#define DE_BODY_SLEEP_TIME (0.5f)
+/* Static geometry around body is queried with radius enlarged by this margin, found leafs are
+ * reused until body moves farther than margin */
+#define DE_BODY_CONTACT_CACHE_MARGIN (0.2f)
+/* Max count of leafs of static geometry in contact cache of body */
+#define DE_BODY_CONTACT_CACHE_SIZE (16)
+
 /**
 * @class de_contact_s
 * @brief Physical contact
@@ -33,6 +48,7 @@ typedef struct de_contact_s {
 	de_static_triangle_t* triangle; /**< Pointer to triangle of static geometry */
 } de_contact_t;
 
-#include "physics/octree.h"
+#include "physics/bvh.h"
+#include "physics/broadphase.h"
 #include "physics/body.h"
 #include "physics/collision.h"
\ No newline at end of file
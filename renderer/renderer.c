@@ -97,6 +97,8 @@ static void de_renderer_load_extensions()
 	GET_GL_EXT(PFNGLGENVERTEXARRAYSPROC, glGenVertexArrays);
 	GET_GL_EXT(PFNGLBINDVERTEXARRAYPROC, glBindVertexArray);
 	GET_GL_EXT(PFNGLDELETEVERTEXARRAYSPROC, glDeleteVertexArrays);
+	GET_GL_EXT(PFNGLVERTEXATTRIBDIVISORPROC, glVertexAttribDivisor);
+	GET_GL_EXT(PFNGLDRAWELEMENTSINSTANCEDPROC, glDrawElementsInstanced);
 
 #ifdef _WIN32	
 	/* Windows does support only OpenGL 1.1 and we must obtain these pointers */
@@ -397,7 +399,7 @@ static void de_renderer_create_shaders(de_renderer_t* r)
 		"       localTangent = vertexTangent.xyz;"
 		"   }"
 		"	gl_Position = worldViewProjection * localPosition;"
-		"   normal = normalize(mat3(worldMatrix) * localNormal);"
+		"   normal = normalize(transpose(inverse(mat3(worldMatrix))) * localNormal);"
 		"   tangent = normalize(mat3(worldMatrix) * localTangent);"
 		"   binormal = normalize(vertexTangent.w * cross(tangent, normal));"
 		"	texCoord = vertexTexCoord;"
@@ -471,11 +473,11 @@ static void de_renderer_create_shaders(de_renderer_t* r)
 	static const char* particle_vs =
 		"#version 330 core\n"
 
-		"layout(location = 0) in vec3 vertexPosition;"
+		"layout(location = 0) in vec3 particlePosition;"
 		"layout(location = 1) in vec2 vertexTexCoord;"
 		"layout(location = 2) in float particleSize;"
 		"layout(location = 3) in float particleRotation;"
-		"layout(location = 4) in vec4 vertexColor;"
+		"layout(location = 4) in vec4 particleColor;"
 
 		"uniform mat4 viewProjectionMatrix;"
 		"uniform mat4 worldMatrix;"
@@ -495,10 +497,10 @@ static void de_renderer_create_shaders(de_renderer_t* r)
 
 		"void main()"
 		"{"
-		"	color = vertexColor;"
+		"	color = particleColor;"
 		"	texCoord = vertexTexCoord;"
 		"   vec2 vertexOffset = rotateVec2(vertexTexCoord * 2.0 - 1.0, particleRotation);"
-		"	vec4 worldPosition = worldMatrix * vec4(vertexPosition, 1.0);"
+		"	vec4 worldPosition = worldMatrix * vec4(particlePosition, 1.0);"
 		"	vec4 offset = (vertexOffset.x * cameraSideVector + vertexOffset.y * cameraUpVector) * particleSize;"
 		"	gl_Position = viewProjectionMatrix * (worldPosition + offset);"
 		"}";
@@ -682,6 +684,18 @@ de_renderer_t* de_renderer_init(de_core_t* core)
 	glGenBuffers(1, &r->gui_render_buffers.vbo);
 	glGenBuffers(1, &r->gui_render_buffers.ebo);
 
+	/* Create particle quad */
+	{
+		static const de_vec2_t tex_coords[] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+		static const GLuint indices[] = { 0, 1, 2, 0, 2, 3 };
+		glGenBuffers(1, &r->particle_quad_buffers.vbo);
+		DE_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, r->particle_quad_buffers.vbo));
+		DE_GL_CALL(glBufferData(GL_ARRAY_BUFFER, sizeof(tex_coords), tex_coords, GL_STATIC_DRAW));
+		glGenBuffers(1, &r->particle_quad_buffers.ebo);
+		DE_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->particle_quad_buffers.ebo));
+		DE_GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW));
+	}
+
 	r->test_surface = de_renderer_create_surface(r);
 
 	/* white dummy texture for surfaces without texture */
@@ -720,6 +734,8 @@ void de_renderer_free(de_renderer_t* r)
 	de_renderer_free_surface(r->quad);
 	de_renderer_free_surface(r->test_surface);
 	de_renderer_free_surface(r->light_unit_sphere);
+	glDeleteBuffers(1, &r->particle_quad_buffers.vbo);
+	glDeleteBuffers(1, &r->particle_quad_buffers.ebo);
 	de_resource_release(de_resource_from_texture(r->white_dummy));
 	de_resource_release(de_resource_from_texture(r->normal_map_dummy));
 	de_free(r);
@@ -844,10 +860,8 @@ GLuint de_renderer_create_gpu_program(const char* vertexSource, const char* frag
 	return program;
 }
 
-static void de_renderer_upload_surface(de_surface_t* s)
+static void de_renderer_upload_shared_data(de_surface_shared_data_t* data)
 {
-	de_surface_shared_data_t* data = s->shared_data;
-
 	if (!data->vertex_buffer) {
 		glGenBuffers(1, &data->vertex_buffer);
 	}
@@ -921,7 +935,11 @@ static void de_renderer_upload_surface(de_surface_t* s)
 	DE_GL_CALL(glEnableVertexAttribArray(5));
 
 	DE_GL_CALL(glBindVertexArray(0));
+}
 
+static void de_renderer_upload_surface(de_surface_t* s)
+{
+	de_renderer_upload_shared_data(s->shared_data);
 	s->need_upload = false;
 }
 
@@ -1025,6 +1043,33 @@ static void de_renderer_draw_mesh_bones(de_renderer_t* r, de_mesh_t* mesh)
 	}
 }
 
+static void de_renderer_bind_textures(de_renderer_t* r, de_texture_t* diffuse_map, de_texture_t* normal_map, de_texture_t* specular_map)
+{
+	/* bind diffuse map */
+	DE_GL_CALL(glActiveTexture(GL_TEXTURE0));
+	if (diffuse_map) {
+		DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, diffuse_map->id));
+	} else {
+		DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, r->white_dummy->id));
+	}
+
+	/* bind normal map */
+	DE_GL_CALL(glActiveTexture(GL_TEXTURE1));
+	if (normal_map) {
+		DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, normal_map->id));
+	} else {
+		DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, r->normal_map_dummy->id));
+	}
+
+	/* bind specular map */
+	DE_GL_CALL(glActiveTexture(GL_TEXTURE2));
+	if (specular_map) {
+		DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, specular_map->id));
+	} else {
+		DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, r->white_dummy->id));
+	}
+}
+
 static void de_renderer_draw_mesh(de_renderer_t* r, de_mesh_t* mesh)
 {	
 	for (size_t i = 0; i < mesh->surfaces.size; ++i) {
@@ -1035,29 +1080,7 @@ static void de_renderer_draw_mesh(de_renderer_t* r, de_mesh_t* mesh)
 			de_renderer_upload_surface(surf);
 		}
 
-		/* bind diffuse map */
-		DE_GL_CALL(glActiveTexture(GL_TEXTURE0));
-		if (surf->diffuse_map) {
-			DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, surf->diffuse_map->id));
-		} else {
-			DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, r->white_dummy->id));
-		}
-
-		/* bind normal map */
-		DE_GL_CALL(glActiveTexture(GL_TEXTURE1));
-		if (surf->normal_map) {
-			DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, surf->normal_map->id));
-		} else {
-			DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, r->normal_map_dummy->id));
-		}
-
-		/* bind specular map */
-		DE_GL_CALL(glActiveTexture(GL_TEXTURE2));
-		if (surf->specular_map) {
-			DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, surf->specular_map->id));
-		} else {
-			DE_GL_CALL(glBindTexture(GL_TEXTURE_2D, r->white_dummy->id));
-		}
+		de_renderer_bind_textures(r, surf->diffuse_map, surf->normal_map, surf->specular_map);
 
 		DE_GL_CALL(glUniform1i(r->gbuffer_shader.use_skeletal_animation, is_skinned));
 		if (is_skinned) {
@@ -1068,6 +1091,61 @@ static void de_renderer_draw_mesh(de_renderer_t* r, de_mesh_t* mesh)
 		}
 
 		de_renderer_render_surface(r, surf);
+		++r->draw_call_count;
+	}
+}
+
+static void de_renderer_draw_index_range(de_renderer_t* r, size_t first_index, size_t index_count)
+{
+	DE_GL_CALL(glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, (void*)(first_index * sizeof(GLuint))));
+	++r->draw_call_count;
+}
+
+static void de_renderer_draw_static_batches(de_renderer_t* r, de_scene_t* scene, de_camera_t* camera, const de_frustum_t* frustum)
+{
+	if (!scene->static_batches.head) {
+		return;
+	}
+
+	/* Geometry of batches is already in world space */
+	de_mat4_t identity;
+	de_mat4_identity(&identity);
+	DE_GL_CALL(glUniformMatrix4fv(r->gbuffer_shader.wvp_matrix, 1, GL_FALSE, camera->view_projection_matrix.f));
+	DE_GL_CALL(glUniformMatrix4fv(r->gbuffer_shader.world_matrix, 1, GL_FALSE, identity.f));
+	DE_GL_CALL(glUniform1i(r->gbuffer_shader.use_skeletal_animation, 0));
+
+	DE_LINKED_LIST_FOR_EACH_T(de_static_batch_t*, batch, scene->static_batches)
+	{
+		if (batch->need_upload) {
+			de_renderer_upload_shared_data(batch->data);
+			batch->need_upload = false;
+		}
+
+		de_renderer_bind_textures(r, batch->diffuse_map, batch->normal_map, batch->specular_map);
+
+		DE_GL_CALL(glBindVertexArray(batch->data->vertex_array_object));
+
+		/* Adjacent visible chunks are merged into one draw call */
+		size_t first_index = 0;
+		size_t index_count = 0;
+		for (size_t i = 0; i < batch->chunks.size; ++i) {
+			const de_static_batch_chunk_t* chunk = &batch->chunks.data[i];
+			if (!de_frustum_box_intersection(frustum, &chunk->bounds, NULL)) {
+				continue;
+			}
+			if (index_count && first_index + index_count == chunk->first_index) {
+				index_count += chunk->index_count;
+			} else {
+				if (index_count) {
+					de_renderer_draw_index_range(r, first_index, index_count);
+				}
+				first_index = chunk->first_index;
+				index_count = chunk->index_count;
+			}
+		}
+		if (index_count) {
+			de_renderer_draw_index_range(r, first_index, index_count);
+		}
 	}
 }
 
@@ -1138,6 +1216,8 @@ void de_renderer_render(de_renderer_t* r)
 	/* Upload textures first */
 	de_renderer_upload_textures(r);
 
+	r->draw_call_count = 0;
+
 	de_mat4_t identity;
 	de_mat4_identity(&identity);
 
@@ -1180,7 +1260,7 @@ void de_renderer_render(de_renderer_t* r)
 		/* Render each node */
 		DE_LINKED_LIST_FOR_EACH_T(de_node_t*, node, scene->nodes)
 		{
-			if (node->global_visibility && node->type == DE_NODE_TYPE_MESH) {
+			if (node->global_visibility && node->type == DE_NODE_TYPE_MESH && !node->s.mesh.batched) {
 				de_mesh_t* mesh = &node->s.mesh;
 				const bool is_skinned = de_mesh_is_skinned(mesh);
 
@@ -1202,6 +1282,8 @@ void de_renderer_render(de_renderer_t* r)
 			}
 		}
 
+		de_renderer_draw_static_batches(r, scene, camera, &frustum);
+
 		DE_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, r->gbuffer.opt_fbo));
 		const GLenum lightBuffers[] = { GL_COLOR_ATTACHMENT0_EXT };
 		DE_GL_CALL(glDrawBuffers(1, lightBuffers));		
@@ -1388,54 +1470,71 @@ void de_renderer_render(de_renderer_t* r)
 		de_vec3_t camera_position;
 		de_node_get_global_position(camera_node, &camera_position);
 
+		de_frustum_t frustum;
+		de_frustum_from_matrix(&frustum, &camera->view_projection_matrix);
+
 		DE_LINKED_LIST_FOR_EACH_T(de_node_t*, node, scene->nodes)
 		{
-			if (node->type != DE_NODE_TYPE_PARTICLE_SYSTEM) {
+			if (node->type != DE_NODE_TYPE_PARTICLE_SYSTEM || !node->global_visibility) {
 				continue;
 			}
 
 			de_particle_system_t* particle_system = &node->s.particle_system;
-			de_particle_system_generate_vertices(particle_system, &camera_position);
+			if (!de_particle_system_is_in_frustum(particle_system, &frustum)) {
+				continue;
+			}
+			de_particle_system_generate_instances(particle_system, &camera_position);
 
-			/* Upload buffers */
-			if (!particle_system->vertex_buffer) {
-				glGenBuffers(1, &particle_system->vertex_buffer);
+			if (!particle_system->instances.size) {
+				continue;
 			}
-			if (!particle_system->index_buffer) {
-				glGenBuffers(1, &particle_system->index_buffer);
+
+			if (particle_system->blend_mode == DE_PARTICLE_SYSTEM_BLEND_MODE_ADDITIVE) {
+				DE_GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE));
+			} else {
+				DE_GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
 			}
+
+			const size_t instance_size = sizeof(*particle_system->instances.data);
+
+			/* Create buffers and setup attributes once, vertex array object remembers them */
 			if (!particle_system->vertex_array_object) {
 				glGenVertexArrays(1, &particle_system->vertex_array_object);
-			}
+				glGenBuffers(1, &particle_system->instance_buffer);
 
-			DE_GL_CALL(glBindVertexArray(particle_system->vertex_array_object));
+				DE_GL_CALL(glBindVertexArray(particle_system->vertex_array_object));
 
-			/* Upload indices */
-			DE_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, particle_system->index_buffer));
-			DE_GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(*particle_system->indices.data) * particle_system->indices.size, particle_system->indices.data, GL_DYNAMIC_DRAW));
+				/* Quad is shared between instances */
+				DE_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, r->particle_quad_buffers.ebo));
+				DE_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, r->particle_quad_buffers.vbo));
+				DE_GL_CALL(glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(de_vec2_t), NULL));
+				DE_GL_CALL(glEnableVertexAttribArray(1));
 
-			/* Upload vertices */
-			const size_t vertex_size = sizeof(*particle_system->vertices.data);
-			const size_t total_size_bytes = vertex_size * particle_system->vertices.size;
+				/* Per-instance data */
+				DE_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, particle_system->instance_buffer));
 
-			DE_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, particle_system->vertex_buffer));
-			DE_GL_CALL(glBufferData(GL_ARRAY_BUFFER, total_size_bytes, particle_system->vertices.data, GL_DYNAMIC_DRAW));
+				DE_GL_CALL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, instance_size, (void*)offsetof(de_particle_instance_t, position)));
+				DE_GL_CALL(glEnableVertexAttribArray(0));
+				DE_GL_CALL(glVertexAttribDivisor(0, 1));
 
-			/* Setup attribute locations for shared data */
-			DE_GL_CALL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertex_size, (void*)offsetof(de_particle_vertex_t, position)));
-			DE_GL_CALL(glEnableVertexAttribArray(0));
+				DE_GL_CALL(glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, instance_size, (void*)offsetof(de_particle_instance_t, size)));
+				DE_GL_CALL(glEnableVertexAttribArray(2));
+				DE_GL_CALL(glVertexAttribDivisor(2, 1));
 
-			DE_GL_CALL(glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, vertex_size, (void*)offsetof(de_particle_vertex_t, tex_coord)));
-			DE_GL_CALL(glEnableVertexAttribArray(1));
+				DE_GL_CALL(glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, instance_size, (void*)offsetof(de_particle_instance_t, rotation)));
+				DE_GL_CALL(glEnableVertexAttribArray(3));
+				DE_GL_CALL(glVertexAttribDivisor(3, 1));
 
-			DE_GL_CALL(glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, vertex_size, (void*)offsetof(de_particle_vertex_t, size)));
-			DE_GL_CALL(glEnableVertexAttribArray(2));
-
-			DE_GL_CALL(glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, vertex_size, (void*)offsetof(de_particle_vertex_t, rotation)));
-			DE_GL_CALL(glEnableVertexAttribArray(3));
+				DE_GL_CALL(glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, instance_size, (void*)offsetof(de_particle_instance_t, color)));
+				DE_GL_CALL(glEnableVertexAttribArray(4));
+				DE_GL_CALL(glVertexAttribDivisor(4, 1));
+			} else {
+				DE_GL_CALL(glBindVertexArray(particle_system->vertex_array_object));
+			}
 
-			DE_GL_CALL(glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, vertex_size, (void*)offsetof(de_particle_vertex_t, color)));
-			DE_GL_CALL(glEnableVertexAttribArray(4));
+			/* Upload instances */
+			DE_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, particle_system->instance_buffer));
+			DE_GL_CALL(glBufferData(GL_ARRAY_BUFFER, instance_size * particle_system->instances.size, particle_system->instances.data, GL_STREAM_DRAW));
 
 			/* Set uniforms */
 			de_particle_system_shader_t* shader = &r->particle_system_shader;
@@ -1462,7 +1561,7 @@ void de_renderer_render(de_renderer_t* r)
 
 			DE_GL_CALL(glUniform2f(shader->fs.proj_params, camera->z_far, camera->z_near));			 
 
-			DE_GL_CALL(glDrawElements(GL_TRIANGLES, particle_system->indices.size, GL_UNSIGNED_INT, NULL));
+			DE_GL_CALL(glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL, particle_system->instances.size));
 		}
 	}
 	
@@ -1593,6 +1692,11 @@ size_t de_renderer_get_mean_fps(de_renderer_t* r)
 	return r->mean_fps;
 }
 
+size_t de_renderer_get_draw_call_count(de_renderer_t* r)
+{
+	return r->draw_call_count;
+}
+
 double de_render_get_frame_time(de_renderer_t* r)
 {
 	return r->frame_time;
@@ -51,6 +51,8 @@ PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray;
 PFNGLGENVERTEXARRAYSPROC glGenVertexArrays;
 PFNGLBINDVERTEXARRAYPROC glBindVertexArray;
 PFNGLDELETEVERTEXARRAYSPROC glDeleteVertexArrays;
+PFNGLVERTEXATTRIBDIVISORPROC glVertexAttribDivisor;
+PFNGLDRAWELEMENTSINSTANCEDPROC glDrawElementsInstanced;
 
 PFNGLGENERATEMIPMAPPROC glGenerateMipmap;
 
@@ -199,6 +201,11 @@ struct de_renderer_t {
 		GLuint ebo;      /**< Element buffer object id */
 	} gui_render_buffers;
 
+	struct {
+		GLuint vbo;      /**< Texture coordinates of quad corners */
+		GLuint ebo;      /**< Indices of two triangles of quad */
+	} particle_quad_buffers; /**< Shared by every particle system, particles are instances of this quad */
+
 	/* Statistics (time in milliseconds) */
 	double frame_time; /**< Actual time amount last frame took to be rendered. */
 	double frame_time_accumulator; /**< Total time of frames since last FPS was committed. */
@@ -207,6 +214,7 @@ struct de_renderer_t {
 	size_t mean_fps; /**< Mean FPS. */
 	size_t min_fps; /**< Minimum FPS. */
 	size_t current_fps; /**< Current FPS. */
+	size_t draw_call_count; /**< Count of draw calls of geometry pass during last frame. */
 };
 
 /**
@@ -250,6 +258,11 @@ void de_renderer_render(de_renderer_t* r);
  */
 size_t de_renderer_get_mean_fps(de_renderer_t* r);
 
+/**
+ * @brief Returns count of draw calls of geometry pass during last frame.
+ */
+size_t de_renderer_get_draw_call_count(de_renderer_t* r);
+
 /**
  * @brief Returns time consumed by the renderer to draw one frame.
  */
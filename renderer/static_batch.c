@@ -0,0 +1,272 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+/**
+ * @brief Surface that goes into batch.
+ */
+typedef struct de_static_batch_entry_t {
+	de_node_t* node;
+	de_surface_t* surf;
+	size_t batch;    /**< Index of batch in array of batches of current build */
+	int32_t cell[3]; /**< Spatial chunk coordinates */
+} de_static_batch_entry_t;
+
+typedef DE_ARRAY_DECLARE(de_static_batch_entry_t, de_static_batch_entry_array_t);
+typedef DE_ARRAY_DECLARE(de_static_batch_t*, de_static_batch_array_t);
+
+static bool de_static_batch_is_suitable(de_node_t* node)
+{
+	if (node->type != DE_NODE_TYPE_MESH || !node->global_visibility || node->body || node->depth_hack != 0.0f) {
+		return false;
+	}
+	de_mesh_t* mesh = de_node_to_mesh(node);
+	if (mesh->batched || de_mesh_is_skinned(mesh)) {
+		return false;
+	}
+	return true;
+}
+
+static size_t de_static_batch_get_or_create(de_scene_t* scene, de_static_batch_array_t* batches, de_surface_t* surf)
+{
+	for (size_t i = 0; i < batches->size; ++i) {
+		de_static_batch_t* batch = batches->data[i];
+		if (batch->diffuse_map == surf->diffuse_map && batch->normal_map == surf->normal_map && batch->specular_map == surf->specular_map) {
+			return i;
+		}
+	}
+	de_static_batch_t* batch = DE_NEW(de_static_batch_t);
+	batch->diffuse_map = surf->diffuse_map;
+	batch->normal_map = surf->normal_map;
+	batch->specular_map = surf->specular_map;
+	if (batch->diffuse_map) {
+		de_resource_add_ref(de_resource_from_texture(batch->diffuse_map));
+	}
+	if (batch->normal_map) {
+		de_resource_add_ref(de_resource_from_texture(batch->normal_map));
+	}
+	if (batch->specular_map) {
+		de_resource_add_ref(de_resource_from_texture(batch->specular_map));
+	}
+	batch->need_upload = true;
+	DE_LINKED_LIST_APPEND(scene->static_batches, batch);
+	DE_ARRAY_APPEND(*batches, batch);
+	return batches->size - 1;
+}
+
+static void de_static_batch_collect(de_scene_t* scene, de_node_t* node, float chunk_size,
+	de_static_batch_entry_array_t* entries, de_static_batch_array_t* batches)
+{
+	if (de_static_batch_is_suitable(node)) {
+		de_mesh_t* mesh = de_node_to_mesh(node);
+		for (size_t i = 0; i < mesh->surfaces.size; ++i) {
+			de_surface_t* surf = mesh->surfaces.data[i];
+			de_surface_shared_data_t* data = surf->shared_data;
+			if (!data || !data->index_count) {
+				continue;
+			}
+			/* Surface is assigned to chunk by center of its world-space bounds */
+			de_aabb_t bounds;
+			de_aabb_invalidate(&bounds);
+			for (size_t k = 0; k < data->vertex_count; ++k) {
+				de_vec3_t p;
+				de_vec3_transform(&p, &data->positions[k], &node->global_matrix);
+				de_aabb_push_point(&bounds, &p);
+			}
+			de_vec3_t center;
+			de_aabb_get_center(&bounds, &center);
+
+			de_static_batch_entry_t* entry = DE_ARRAY_GROW(*entries, 1);
+			entry->node = node;
+			entry->surf = surf;
+			entry->batch = de_static_batch_get_or_create(scene, batches, surf);
+			entry->cell[0] = (int32_t)floorf(center.x / chunk_size);
+			entry->cell[1] = (int32_t)floorf(center.y / chunk_size);
+			entry->cell[2] = (int32_t)floorf(center.z / chunk_size);
+		}
+		mesh->batched = true;
+	}
+	for (size_t i = 0; i < node->children.size; ++i) {
+		de_static_batch_collect(scene, node->children.data[i], chunk_size, entries, batches);
+	}
+}
+
+static int de_static_batch_entry_compare(const void* a, const void* b)
+{
+	const de_static_batch_entry_t* ea = (const de_static_batch_entry_t*)a;
+	const de_static_batch_entry_t* eb = (const de_static_batch_entry_t*)b;
+	if (ea->batch != eb->batch) {
+		return ea->batch < eb->batch ? -1 : 1;
+	}
+	for (int i = 0; i < 3; ++i) {
+		if (ea->cell[i] != eb->cell[i]) {
+			return ea->cell[i] < eb->cell[i] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+static bool de_static_batch_same_cell(const de_static_batch_entry_t* a, const de_static_batch_entry_t* b)
+{
+	return a->cell[0] == b->cell[0] && a->cell[1] == b->cell[1] && a->cell[2] == b->cell[2];
+}
+
+/**
+ * @brief Transforms direction vector by upper 3x3 of matrix and renormalizes it, zero vectors
+ * are left as is. Normals must be transformed by inverse-transpose of world matrix (see
+ * de_static_batch_append), tangents by world matrix itself.
+ */
+static void de_static_batch_transform_direction(de_vec3_t* out, const de_vec3_t* dir, const de_mat4_t* m)
+{
+	de_vec3_transform_normal(out, dir, m);
+	if (de_vec3_sqr_len(out) > 0.0f) {
+		de_vec3_normalize(out, out);
+	}
+}
+
+/**
+ * @brief Appends world-space copy of surface geometry into batch data, extends bounds of chunk.
+ */
+static void de_static_batch_append(de_surface_shared_data_t* dest, de_static_batch_chunk_t* chunk, const de_static_batch_entry_t* entry)
+{
+	const de_surface_shared_data_t* src = entry->surf->shared_data;
+	const de_mat4_t* m = &entry->node->global_matrix;
+	const int base = (int)dest->vertex_count;
+
+	/* Inverse of affine matrix has inverse of its upper 3x3 in upper 3x3, so normals stay
+	 * perpendicular to surface under non-uniform scale */
+	de_mat4_t inverse, normal_matrix;
+	de_mat4_inverse(&inverse, m);
+	de_mat4_transpose(&normal_matrix, &inverse);
+
+	for (size_t i = 0; i < src->vertex_count; ++i) {
+		const size_t k = dest->vertex_count + i;
+		de_vec3_transform(&dest->positions[k], &src->positions[i], m);
+		de_static_batch_transform_direction(&dest->normals[k], &src->normals[i], &normal_matrix);
+		de_vec3_t tangent = { src->tangents[i].x, src->tangents[i].y, src->tangents[i].z };
+		de_static_batch_transform_direction(&tangent, &tangent, m);
+		dest->tangents[k] = (de_vec4_t) { tangent.x, tangent.y, tangent.z, src->tangents[i].w };
+		dest->tex_coords[k] = src->tex_coords[i];
+		de_aabb_push_point(&chunk->bounds, &dest->positions[k]);
+	}
+	memset(dest->bone_weights + dest->vertex_count, 0, src->vertex_count * sizeof(*dest->bone_weights));
+	memset(dest->bone_indices + dest->vertex_count, 0, src->vertex_count * sizeof(*dest->bone_indices));
+	dest->vertex_count += src->vertex_count;
+
+	for (size_t i = 0; i < src->index_count; ++i) {
+		dest->indices[dest->index_count + i] = src->indices[i] + base;
+	}
+	dest->index_count += src->index_count;
+	chunk->index_count += src->index_count;
+}
+
+size_t de_scene_build_static_batches(de_scene_t* scene, de_node_t* root, float chunk_size)
+{
+	DE_ASSERT(scene);
+	DE_ASSERT(root);
+	DE_ASSERT(chunk_size > 0.0f);
+
+	de_static_batch_entry_array_t entries;
+	de_static_batch_array_t batches;
+	DE_ARRAY_INIT(entries);
+	DE_ARRAY_INIT(batches);
+
+	de_node_calculate_transforms_descending(root);
+	de_static_batch_collect(scene, root, chunk_size, &entries, &batches);
+
+	/* Group surfaces by batch, then by chunk, so each chunk is contiguous range of indices */
+	DE_ARRAY_QSORT(entries, de_static_batch_entry_compare);
+
+	size_t begin = 0;
+	while (begin < entries.size) {
+		de_static_batch_t* batch = batches.data[entries.data[begin].batch];
+
+		size_t end = begin;
+		size_t vertex_count = 0, index_count = 0;
+		while (end < entries.size && entries.data[end].batch == entries.data[begin].batch) {
+			vertex_count += entries.data[end].surf->shared_data->vertex_count;
+			index_count += entries.data[end].surf->shared_data->index_count;
+			++end;
+		}
+
+		batch->data = de_surface_shared_data_create(vertex_count, index_count);
+
+		de_static_batch_chunk_t* chunk = NULL;
+		for (size_t i = begin; i < end; ++i) {
+			if (!chunk || !de_static_batch_same_cell(&entries.data[i - 1], &entries.data[i])) {
+				if (chunk) {
+					de_aabb_recompute_corners(&chunk->bounds);
+				}
+				chunk = DE_ARRAY_GROW(batch->chunks, 1);
+				de_aabb_invalidate(&chunk->bounds);
+				chunk->first_index = batch->data->index_count;
+				chunk->index_count = 0;
+			}
+			de_static_batch_append(batch->data, chunk, &entries.data[i]);
+		}
+		de_aabb_recompute_corners(&chunk->bounds);
+
+		begin = end;
+	}
+
+	const size_t count = entries.size;
+
+	DE_ARRAY_FREE(entries);
+	DE_ARRAY_FREE(batches);
+
+	return count;
+}
+
+void de_scene_clear_static_batches(de_scene_t* scene)
+{
+	DE_ASSERT(scene);
+
+	DE_LINKED_LIST_FOR_EACH_T(de_node_t*, node, scene->nodes)
+	{
+		if (node->type == DE_NODE_TYPE_MESH) {
+			de_node_to_mesh(node)->batched = false;
+		}
+	}
+
+	while (scene->static_batches.head) {
+		de_static_batch_t* batch = scene->static_batches.head;
+		DE_LINKED_LIST_REMOVE(scene->static_batches, batch);
+		if (batch->diffuse_map) {
+			de_resource_release(de_resource_from_texture(batch->diffuse_map));
+		}
+		if (batch->normal_map) {
+			de_resource_release(de_resource_from_texture(batch->normal_map));
+		}
+		if (batch->specular_map) {
+			de_resource_release(de_resource_from_texture(batch->specular_map));
+		}
+		de_surface_shared_data_t* data = batch->data;
+		if (data) {
+			if (data->vertex_array_object) {
+				glDeleteBuffers(1, &data->vertex_buffer);
+				glDeleteBuffers(1, &data->index_buffer);
+				glDeleteVertexArrays(1, &data->vertex_array_object);
+			}
+			de_surface_shared_data_free(data);
+		}
+		DE_ARRAY_FREE(batch->chunks);
+		de_free(batch);
+	}
+}
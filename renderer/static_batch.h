@@ -0,0 +1,67 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+/**
+ * Static batching.
+ *
+ * Level geometry usually consists of lots of small static props, drawing each surface with
+ * separate draw call is very expensive. Static batching merges surfaces that never move and
+ * use same set of textures into one big vertex/index buffer with vertices pre-transformed into
+ * world space. Merged geometry is split into spatial chunks, each chunk is contiguous range of
+ * indices with its own bounds, so batch still can be culled per-chunk, and adjacent visible
+ * chunks are drawn with one draw call.
+ *
+ * Batched meshes are not rendered separately, so changes of transform, visibility or surfaces
+ * of such meshes will not be visible until batches are rebuilt. Batches must be cleared before
+ * batched meshes are freed.
+ */
+
+/**
+ * @brief Contiguous range of indices of batch that are close to each other in space.
+ */
+typedef struct de_static_batch_chunk_t {
+	de_aabb_t bounds; /**< World-space bounds of chunk geometry */
+	size_t first_index;
+	size_t index_count;
+} de_static_batch_chunk_t;
+
+struct de_static_batch_t {
+	DE_LINKED_LIST_ITEM(struct de_static_batch_t);
+	de_texture_t* diffuse_map;
+	de_texture_t* normal_map;
+	de_texture_t* specular_map;
+	de_surface_shared_data_t* data; /**< Merged world-space geometry */
+	bool need_upload;
+	DE_ARRAY_DECLARE(de_static_batch_chunk_t, chunks);
+};
+
+/**
+ * @brief Merges every visible non-skinned static mesh in hierarchy of root into static batches
+ * of scene. Meshes with physical body or depth hack are considered dynamic and skipped.
+ * Returns count of batched surfaces.
+ * @param chunk_size size of spatial chunk, surfaces are assigned to chunks by their centers.
+ */
+size_t de_scene_build_static_batches(de_scene_t* scene, de_node_t* root, float chunk_size);
+
+/**
+ * @brief Frees every static batch of scene, batched meshes will be rendered separately again.
+ */
+void de_scene_clear_static_batches(de_scene_t* scene);
@@ -29,6 +29,9 @@ static void de_model_deinit(de_resource_t* res)
 		node->model_resource = NULL;
 	}
 	de_scene_free(mdl->scene);
+	DE_ARRAY_FREE(mdl->prefab.nodes);
+	DE_ARRAY_FREE(mdl->prefab.bone_indices);
+	DE_ARRAY_FREE(mdl->prefab.track_indices);
 }
 
 static void de_model_set_node_resource(de_node_t* node, de_resource_t* res)
@@ -43,25 +46,98 @@ static void de_model_set_node_resource(de_node_t* node, de_resource_t* res)
 	}
 }
 
-static bool de_model_load(de_resource_t* res)
+static void de_model_template_add_node(de_model_template_t* prefab, de_node_t* node, int32_t parent)
+{
+	de_model_template_node_t* entry = DE_ARRAY_GROW(prefab->nodes, 1);
+	entry->node = node;
+	entry->parent = parent;
+	entry->first_bone = 0;
+	entry->bone_count = 0;
+	const int32_t index = (int32_t)(prefab->nodes.size - 1);
+	for (size_t i = 0; i < node->children.size; ++i) {
+		de_model_template_add_node(prefab, node->children.data[i], index);
+	}
+}
+
+static int32_t de_model_template_index_of(const de_model_template_t* prefab, const de_node_t* node)
+{
+	if (node) {
+		for (size_t i = 0; i < prefab->nodes.size; ++i) {
+			if (prefab->nodes.data[i].node == node) {
+				return (int32_t)i;
+			}
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Flattens model hierarchy and precomputes remapping tables. Done on load and
+ * only rebuilt if model was changed after it, so linear searches here are fine.
+ */
+static void de_model_build_template(de_model_t* mdl)
+{
+	de_model_template_t* prefab = &mdl->prefab;
+
+	DE_ARRAY_CLEAR(prefab->nodes);
+	DE_ARRAY_CLEAR(prefab->bone_indices);
+	DE_ARRAY_CLEAR(prefab->track_indices);
+
+	de_model_template_add_node(prefab, mdl->root, -1);
+
+	for (size_t i = 0; i < prefab->nodes.size; ++i) {
+		de_model_template_node_t* entry = &prefab->nodes.data[i];
+		entry->first_bone = (uint32_t)prefab->bone_indices.size;
+		if (entry->node->type == DE_NODE_TYPE_MESH) {
+			de_mesh_t* mesh = de_node_to_mesh(entry->node);
+			for (size_t k = 0; k < mesh->surfaces.size; ++k) {
+				de_surface_t* surf = mesh->surfaces.data[k];
+				for (size_t j = 0; j < surf->bones.size; ++j) {
+					DE_ARRAY_APPEND(prefab->bone_indices, de_model_template_index_of(prefab, surf->bones.data[j]));
+				}
+			}
+		}
+		entry->bone_count = (uint32_t)prefab->bone_indices.size - entry->first_bone;
+	}
+
+	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, mdl->scene->animations)
+	{
+		for (size_t i = 0; i < anim->tracks.size; ++i) {
+			DE_ARRAY_APPEND(prefab->track_indices, de_model_template_index_of(prefab, anim->tracks.data[i]->node));
+		}
+	}
+}
+
+static bool de_model_load_fbx(de_resource_t* res, de_fbx_t* fbx)
 {
 	de_model_t* mdl = de_resource_to_model(res);
 	de_core_t* core = res->core;
 	mdl->scene = de_scene_create(core);
 	DE_LINKED_LIST_REMOVE(core->scenes, mdl->scene);
-	mdl->root = de_fbx_load_to_scene(mdl->scene, de_path_cstr(&res->source));
+	mdl->root = fbx ? de_fbx_to_scene(mdl->scene, fbx) : NULL;
 	if (mdl->root) {
 		de_model_set_node_resource(mdl->root, res);
 		DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, mdl->scene->animations)
 		{
 			anim->resource = res;
 		}
+		de_model_build_template(mdl);
 	} else {
 		de_log("failed to load model %s", de_path_cstr(&res->source));
 	}
 	return mdl->root != NULL;
 }
 
+static bool de_model_load(de_resource_t* res)
+{
+	de_fbx_t* fbx = de_fbx_load_file(de_path_cstr(&res->source));
+	const bool result = de_model_load_fbx(res, fbx);
+	if (fbx) {
+		de_fbx_free(fbx);
+	}
+	return result;
+}
+
 static bool de_model_visit(de_object_visitor_t* visitor, de_resource_t* res)
 {
 	DE_ASSERT(visitor);
@@ -95,27 +171,117 @@ de_node_t* de_model_instantiate(de_model_t* mdl, de_scene_t* dest_scene)
 		return NULL;
 	}
 
-	/* Instantiate nodes. */
-	de_node_t* copy = de_node_copy(dest_scene, mdl->root);
+	/* Template is built on load, but animations or tracks of model could be changed after
+	 * that, or model was made without loading. */
+	size_t track_count = 0;
+	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, mdl->scene->animations)
+	{
+		track_count += anim->tracks.size;
+	}
+	if (!mdl->prefab.nodes.size || track_count != mdl->prefab.track_indices.size) {
+		de_model_build_template(mdl);
+	}
+
+	const de_model_template_t* prefab = &mdl->prefab;
+
+	de_node_t** instances = de_malloc(prefab->nodes.size * sizeof(*instances));
 
-	/* Instantiate animations. */
+	/* Instantiate nodes. Parents always go before children in template, so parent
+	 * of each node is already instantiated and has its global transform computed. */
+	for (size_t i = 0; i < prefab->nodes.size; ++i) {
+		const de_model_template_node_t* entry = &prefab->nodes.data[i];
+		de_node_t* copy = de_node_copy_single(dest_scene, entry->node);
+		if (entry->node->children.size) {
+			DE_ARRAY_RESERVE(copy->children, entry->node->children.size);
+		}
+		instances[i] = copy;
+		de_node_calculate_local_transform(copy);
+		if (entry->parent >= 0) {
+			de_node_t* parent = instances[entry->parent];
+			de_node_attach(copy, parent);
+			de_mat4_mul(&copy->global_matrix, &parent->global_matrix, &copy->local_matrix);
+		} else {
+			copy->global_matrix = copy->local_matrix;
+		}
+	}
+
+	/* Remap surface bones. */
+	for (size_t i = 0; i < prefab->nodes.size; ++i) {
+		const de_model_template_node_t* entry = &prefab->nodes.data[i];
+		if (!entry->bone_count) {
+			continue;
+		}
+		const int32_t* bone_index = prefab->bone_indices.data + entry->first_bone;
+		de_mesh_t* mesh = de_node_to_mesh(instances[i]);
+		for (size_t k = 0; k < mesh->surfaces.size; ++k) {
+			de_surface_t* surf = mesh->surfaces.data[k];
+			for (size_t j = 0; j < surf->bones.size; ++j, ++bone_index) {
+				surf->bones.data[j] = *bone_index >= 0 ? instances[*bone_index] : NULL;
+			}
+		}
+	}
+
+	/* Instantiate animations and remap track nodes. */
+	const int32_t* track_index = prefab->track_indices.data;
 	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, ref_anim, mdl->scene->animations)
 	{
 		de_animation_t* anim_copy = de_animation_copy(ref_anim, dest_scene);
+		de_animation_set_lod_node(anim_copy, instances[0]);
+		for (size_t i = 0; i < anim_copy->tracks.size; ++i, ++track_index) {
+			if (*track_index >= 0) {
+				de_animation_track_set_node(anim_copy->tracks.data[i], instances[*track_index]);
+			}
+		}
+	}
 
-		/* Remap animation track nodes. */
-		for (size_t i = 0; i < ref_anim->tracks.size; ++i) {
-			de_animation_track_t* ref_track = ref_anim->tracks.data[i];
+	de_node_t* root = instances[0];
 
-			/* Find instantiated node that corresponds to node in resource */
-			DE_LINKED_LIST_FOR_EACH_T(de_node_t*, node, dest_scene->nodes)
-			{
-				if (ref_track->node && node->original == ref_track->node) {
-					anim_copy->tracks.data[i]->node = node;
-				}
-			}
+	de_free(instances);
+
+	return root;
+}
+
+de_resource_t* de_model_create_from_fbx(de_core_t* core, const de_path_t* path, de_fbx_t* fbx)
+{
+	DE_ASSERT(core);
+	DE_ASSERT(path);
+	de_resource_t* res = de_core_find_resource_of_type(core, DE_RESOURCE_TYPE_MODEL, path);
+	if (res) {
+		return res;
+	}
+	res = de_resource_create(core, path, DE_RESOURCE_TYPE_MODEL, 0);
+	if (!de_model_load_fbx(res, fbx)) {
+		/* same as in de_core_request_resource: add ref and release to destroy resource */
+		de_resource_add_ref(res);
+		de_resource_release(res);
+		return NULL;
+	}
+	return res;
+}
+
+void de_model_instance_set_animation_lod(de_node_t* root, const de_animation_lod_t* lod)
+{
+	DE_ASSERT(root);
+	DE_ASSERT(root->scene);
+	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, root->scene->animations)
+	{
+		if (anim->lod_node == root) {
+			de_animation_set_lod(anim, lod);
 		}
 	}
+}
 
-	return copy;
-}
\ No newline at end of file
+void de_model_instance_free(de_node_t* root)
+{
+	DE_ASSERT(root);
+	DE_ASSERT(root->scene);
+	de_animation_t* anim = root->scene->animations.head;
+	while (anim) {
+		de_animation_t* next = anim->next;
+		if (anim->lod_node == root) {
+			de_animation_free(anim);
+		}
+		anim = next;
+	}
+	de_node_free(root);
+}
@@ -19,6 +19,32 @@
 * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
+/**
+ * @brief Flattened node of model hierarchy used for fast instantiation.
+ */
+typedef struct de_model_template_node_t {
+	de_node_t* node; /**< Source node in model scene */
+	int32_t parent; /**< Index of parent node in template, -1 for root */
+	uint32_t first_bone; /**< Index of first entry in bone indices table */
+	uint32_t bone_count; /**< Total count of bones of every surface of node */
+} de_model_template_node_t;
+
+/**
+ * @brief Prefab template of a model. Built once when model is loaded, contains model
+ * hierarchy flattened in depth-first order (so parents always go before children) and
+ * remapping tables which refer to nodes by index in template, so instantiation does not
+ * need to search nodes by name or by original.
+ */
+typedef struct de_model_template_t {
+	DE_ARRAY_DECLARE(de_model_template_node_t, nodes);
+	/** Template index of every bone of every surface of every node in order. -1 if bone
+	 * is out of model hierarchy */
+	DE_ARRAY_DECLARE(int32_t, bone_indices);
+	/** Template index of node of every track of every animation in order. -1 if track
+	 * has no node or node is out of model hierarchy */
+	DE_ARRAY_DECLARE(int32_t, track_indices);
+} de_model_template_t;
+
 /**
  * @brief Model is an isolated scene which can be instantiated multiple times, the source
  * scene won't be rendered.
@@ -26,8 +52,32 @@
 typedef struct de_model_t {
 	de_scene_t* scene;
 	de_node_t* root;
+	de_model_template_t prefab; /**< Private. Prefab template used by de_model_instantiate */
 } de_model_t;
 
+/**
+ * @brief Creates a copy of model hierarchy and its animations in destination scene. Uses
+ * precomputed template of the model, so cost is linear in count of nodes and tracks.
+ */
 de_node_t* de_model_instantiate(de_model_t* mdl, de_scene_t* dest_scene);
 
+/**
+ * @brief Frees model instance together with animations that were instantiated for it.
+ * @param root root node of instance returned by de_model_instantiate
+ */
+void de_model_instance_free(de_node_t* root);
+
+/**
+ * @brief Internal. Creates model resource from FBX that was parsed in advance, for example on
+ * worker thread. If model with same path is already registered in core, returns it instead.
+ * Does not take ownership of fbx. Returns NULL on failure.
+ */
+de_resource_t* de_model_create_from_fbx(de_core_t* core, const de_path_t* path, de_fbx_t* fbx);
+
+/**
+ * @brief Sets level of detail settings of every animation of model instance.
+ * @param root root node of instance returned by de_model_instantiate
+ */
+void de_model_instance_set_animation_lod(de_node_t* root, const de_animation_lod_t* lod);
+
 de_resource_dispatch_table_t* de_model_get_dispatch_table(void);
\ No newline at end of file
@@ -28,6 +28,7 @@ de_animation_t* de_animation_create(de_scene_t* s)
 	animation->scene = s;
 	animation->weight = 1.0f;
 	animation->speed = 1.0f;
+	animation->pose_cache_bucket = -1;
 	animation->flags = (de_animation_flags_t)(DE_ANIMATION_FLAG_ENABLED | DE_ANIMATION_FLAG_LOOPED);
 
 	DE_LINKED_LIST_APPEND(s->animations, animation);
@@ -35,6 +36,63 @@ de_animation_t* de_animation_create(de_scene_t* s)
 	return animation;
 }
 
+static de_animation_track_data_t* de_animation_track_data_create(void)
+{
+	de_animation_track_data_t* data = DE_NEW(de_animation_track_data_t);
+	data->ref_count = 1;
+	return data;
+}
+
+static void de_animation_track_data_add_ref(de_animation_track_data_t* data)
+{
+	++data->ref_count;
+}
+
+static void de_animation_track_data_release(de_animation_track_data_t* data)
+{
+	DE_ASSERT(data->ref_count > 0);
+	if (--data->ref_count == 0) {
+		DE_ARRAY_FREE(data->keyframes);
+		if (data->compressed) {
+			de_compressed_track_free(data->compressed);
+		}
+		de_free(data);
+	}
+}
+
+/**
+ * @brief Returns data of a track which can be modified. Creates data if track have none,
+ * makes private copy if data is shared with other tracks.
+ */
+static de_animation_track_data_t* de_animation_track_get_writable_data(de_animation_track_t* track)
+{
+	if (!track->data) {
+		track->data = de_animation_track_data_create();
+	} else if (track->data->ref_count > 1) {
+		de_animation_track_data_t* shared = track->data;
+		track->data = de_animation_track_data_create();
+		DE_ARRAY_COPY(shared->keyframes, track->data->keyframes);
+		if (shared->compressed) {
+			track->data->compressed = de_compressed_track_copy(shared->compressed);
+		}
+		de_animation_track_data_release(shared);
+	}
+	return track->data;
+}
+
+static void de_animation_track_set_data(de_animation_track_t* track, de_animation_track_data_t* data)
+{
+	if (data) {
+		de_animation_track_data_add_ref(data);
+	}
+	if (track->data) {
+		de_animation_track_data_release(track->data);
+	}
+	track->data = data;
+	track->cursor = 0;
+	memset(&track->compressed_cursor, 0, sizeof(track->compressed_cursor));
+}
+
 de_animation_track_t* de_animation_track_create(de_animation_t* anim)
 {
 	de_animation_track_t* track;
@@ -75,13 +133,34 @@ static bool de_keyframe_visit(de_object_visitor_t* visitor, de_keyframe_t* key)
 	return result;
 }
 
+static bool de_animation_track_data_visit(de_object_visitor_t* visitor, de_animation_track_data_t* data)
+{
+	bool result = true;
+	/* reference counter is not saved: on load data is visited only when visitor allocates it, every
+	 * track that resolves to it takes a reference in de_animation_track_visit */
+	if (data->compressed && !visitor->is_reading) {
+		/* compressed keyframes are saved as plain keyframes */
+		de_animation_track_data_t* temp = de_animation_track_data_create();
+		de_compressed_track_decompress(data->compressed, temp);
+		result &= DE_OBJECT_VISITOR_VISIT_ARRAY(visitor, "Keyframes", temp->keyframes, (de_visit_callback_t)de_keyframe_visit);
+		de_animation_track_data_release(temp);
+	} else {
+		result &= DE_OBJECT_VISITOR_VISIT_ARRAY(visitor, "Keyframes", data->keyframes, (de_visit_callback_t)de_keyframe_visit);
+	}
+	return result;
+}
+
 bool de_animation_track_visit(de_object_visitor_t* visitor, de_animation_track_t* track)
 {
 	bool result = true;
 	result &= DE_OBJECT_VISITOR_VISIT_POINTER(visitor, "Animation", &track->parent_animation, de_animation_visit);
 	if (track->parent_animation && !track->parent_animation->resource) {
 		/* visit keyframes only if this animation was created during runtime, not from external resource */
-		result &= DE_OBJECT_VISITOR_VISIT_ARRAY(visitor, "Keyframes", track->keyframes, (de_visit_callback_t)de_keyframe_visit);
+		result &= DE_OBJECT_VISITOR_VISIT_POINTER(visitor, "Data", &track->data, de_animation_track_data_visit);
+		if (visitor->is_reading && track->data) {
+			/* freshly allocated data has zero references, so first track makes it one */
+			de_animation_track_data_add_ref(track->data);
+		}
 	}
 	result &= de_object_visitor_visit_bool(visitor, "Enabled", &track->enabled);
 	result &= de_object_visitor_visit_float(visitor, "MaxTime", &track->max_time);
@@ -110,8 +189,8 @@ void de_animation_resolve(de_animation_t* anim)
 				}
 
 				if (ref_track) {
-					/* copy keyframes from ref track */
-					DE_ARRAY_COPY(ref_track->keyframes, track->keyframes);
+					/* share keyframes of ref track */
+					de_animation_track_set_data(track, ref_track->data);
 				} else {
 					de_log("unable to resolve track resource dependencies");
 				}
@@ -122,7 +201,7 @@ void de_animation_resolve(de_animation_t* anim)
 
 void de_animation_track_free(de_animation_track_t* track)
 {
-	DE_ARRAY_FREE(track->keyframes);
+	de_animation_track_set_data(track, NULL);
 
 	de_free(track);
 }
@@ -136,9 +215,8 @@ de_animation_track_t* de_animation_track_copy(de_animation_track_t* track, de_an
 {
 	de_animation_track_t* copy = DE_NEW(de_animation_track_t);
 	copy->parent_animation = dest_anim;
-	for (size_t i = 0; i < track->keyframes.size; ++i) {
-		DE_ARRAY_APPEND(copy->keyframes, track->keyframes.data[i]);
-	}
+	/* Keyframes are immutable while shared, so copy just references them. */
+	de_animation_track_set_data(copy, track->data);
 	copy->enabled = track->enabled;
 	copy->max_time = track->max_time;
 	/* Track copy will point on same node for further remapping. */
@@ -149,22 +227,40 @@ de_animation_track_t* de_animation_track_copy(de_animation_track_t* track, de_an
 void de_animation_track_add_keyframe(de_animation_track_t* track, const de_keyframe_t* keyframe)
 {
 	size_t i;
+	de_animation_track_data_t* data = de_animation_track_get_writable_data(track);
+
+	DE_ASSERT(!data->compressed);
 
 	if (keyframe->time > track->max_time) {
-		DE_ARRAY_APPEND(track->keyframes, *keyframe);
+		DE_ARRAY_APPEND(data->keyframes, *keyframe);
 
 		track->max_time = keyframe->time;
 	} else {
-		for (i = 0; i < track->keyframes.size; ++i) {
-			de_keyframe_t* other_keyframe = DE_ARRAY_AT(&track->keyframes, i);
+		for (i = 0; i < data->keyframes.size; ++i) {
+			de_keyframe_t* other_keyframe = &DE_ARRAY_AT(data->keyframes, i);
 
 			if (keyframe->time < other_keyframe->time) {
 				break;
 			}
 		}
 
-		DE_ARRAY_INSERT(track->keyframes, i, *keyframe);
+		DE_ARRAY_INSERT(data->keyframes, i, *keyframe);
 	}
+
+	/* Indices could be shifted, so cursor is not valid anymore */
+	track->cursor = 0;
+}
+
+void de_animation_track_compress(de_animation_track_t* track, const de_animation_compression_params_t* params)
+{
+	de_animation_track_data_t* data = track->data;
+	if (!data || data->compressed || !data->keyframes.size) {
+		return;
+	}
+	/* Compression does not change meaning of keyframes, so shared data is compressed in-place
+	 * and every track that shares it will benefit. */
+	data->compressed = de_compressed_track_create(data->keyframes.data, data->keyframes.size, params);
+	DE_ARRAY_FREE(data->keyframes);
 }
 
 void de_animation_free(de_animation_t* anim)
@@ -177,6 +273,7 @@ void de_animation_free(de_animation_t* anim)
 		de_animation_track_free(anim->tracks.data[i]);
 	}
 	DE_ARRAY_FREE(anim->tracks);
+	de_pose_free(&anim->pose);
 
 	if (anim->resource) {
 		de_resource_release(anim->resource);
@@ -202,98 +299,193 @@ de_animation_t* de_animation_copy(de_animation_t* anim, de_scene_t* dest_scene)
 	copy->time_position = anim->time_position;
 	copy->weight = anim->weight;
 	copy->fade_step = anim->fade_step;
+	copy->lod = anim->lod;
+	copy->pose_cache_step = anim->pose_cache_step;
+	copy->pose_cache_bucket = -1;
 	DE_LINKED_LIST_APPEND(dest_scene->animations, copy);
 	return copy;
 }
 
+/**
+ * @brief Returns index of first keyframe with time greater or equal to given time. Uses
+ * track cursor as a hint: for sequential playback right keyframe is either the same as on
+ * previous call or next one. Otherwise performs binary search.
+ */
+static size_t de_animation_track_find_right_index(de_animation_track_t* track, float time)
+{
+	const de_keyframe_t* keys = track->data->keyframes.data;
+	const size_t count = track->data->keyframes.size;
+
+	/* Try cursor and its neighbour first */
+	for (size_t i = track->cursor; i < count && i <= track->cursor + 1; ++i) {
+		if (keys[i].time >= time && (i == 0 || keys[i - 1].time < time)) {
+			track->cursor = i;
+			return i;
+		}
+	}
+
+	/* Seek or loop - do binary search */
+	size_t left = 0;
+	size_t right = count;
+	while (left < right) {
+		const size_t middle = left + (right - left) / 2;
+		if (keys[middle].time < time) {
+			left = middle + 1;
+		} else {
+			right = middle;
+		}
+	}
+
+	track->cursor = left;
+
+	return left;
+}
+
+static void de_keyframe_interpolate(const de_keyframe_t* left, const de_keyframe_t* right, float interpolator, de_keyframe_t* out_keyframe)
+{
+	if (interpolator == 0.0f) {
+		*out_keyframe = *left;
+	} else {
+		out_keyframe->time = de_lerp(left->time, right->time, interpolator);
+		de_vec3_lerp(&out_keyframe->position, &left->position, &right->position, interpolator);
+		de_vec3_lerp(&out_keyframe->scale, &left->scale, &right->scale, interpolator);
+		de_quat_slerp(&out_keyframe->rotation, &left->rotation, &right->rotation, interpolator);
+	}
+}
+
 void de_animation_track_get_keyframe(de_animation_track_t* track, float time, de_keyframe_t* out_keyframe)
 {
-	size_t i;
-	de_keyframe_t* left = NULL;
-	de_keyframe_t* right = NULL;
+	const de_keyframe_t* left;
+	const de_keyframe_t* right;
 	float interpolator = 0.0f;
 
+	const de_animation_track_data_t* data = track->data;
+
+	if (!data) {
+		return;
+	}
+
+	if (data->compressed) {
+		de_compressed_track_sample(data->compressed, &track->compressed_cursor, time, out_keyframe);
+		return;
+	}
+
+	if (!data->keyframes.size) {
+		return;
+	}
+
 	time = de_clamp(time, 0.0f, track->max_time);
 
 	if (time >= track->max_time) {
-		left = &DE_ARRAY_LAST(track->keyframes);
+		left = &DE_ARRAY_LAST(data->keyframes);
 		right = left;
-
-		interpolator = 0.0f;
 	} else {
-		int right_index = -1;
-
-		for (i = 0; i < track->keyframes.size; ++i) {
-			de_keyframe_t* keyframe = &DE_ARRAY_AT(track->keyframes, i);
-
-			if (keyframe->time >= time) {
-				right_index = i;
-				break;
-			}
-		}
+		const size_t right_index = de_animation_track_find_right_index(track, time);
 
 		if (right_index == 0) {
-			left = &DE_ARRAY_FIRST(track->keyframes);
+			left = &DE_ARRAY_FIRST(data->keyframes);
+			right = left;
+		} else if (right_index >= data->keyframes.size) {
+			left = &DE_ARRAY_LAST(data->keyframes);
 			right = left;
-
-			interpolator = 0.0f;
 		} else {
-			left = &DE_ARRAY_AT(track->keyframes, right_index - 1);
-			right = &DE_ARRAY_AT(track->keyframes, right_index);
+			left = &DE_ARRAY_AT(data->keyframes, right_index - 1);
+			right = &DE_ARRAY_AT(data->keyframes, right_index);
 
 			interpolator = (time - left->time) / (right->time - left->time);
 		}
 	}
 
-	if (left && right) {
-		if (interpolator == 0.0f) {
-			*out_keyframe = *left;
-		} else {
-			out_keyframe->time = de_lerp(left->time, right->time, interpolator);
-			de_vec3_lerp(&out_keyframe->position, &left->position, &right->position, interpolator);
-			de_vec3_lerp(&out_keyframe->scale, &left->scale, &right->scale, interpolator);
-			de_quat_slerp(&out_keyframe->rotation, &left->rotation, &right->rotation, interpolator);
-		}
+	de_keyframe_interpolate(left, right, interpolator, out_keyframe);
+}
+
+void de_pose_resize(de_pose_t* pose, size_t count)
+{
+	if (pose->positions.size < count) {
+		const size_t n = count - pose->positions.size;
+		DE_ARRAY_GROW(pose->positions, n);
+		DE_ARRAY_GROW(pose->rotations, n);
+		DE_ARRAY_GROW(pose->scales, n);
+	} else {
+		pose->positions.size = count;
+		pose->rotations.size = count;
+		pose->scales.size = count;
 	}
 }
 
-void de_animation_add_track(de_animation_t* anim, de_animation_track_t* track)
+void de_pose_free(de_pose_t* pose)
 {
-	DE_ARRAY_APPEND(anim->tracks, track);
+	DE_ARRAY_FREE(pose->positions);
+	DE_ARRAY_FREE(pose->rotations);
+	DE_ARRAY_FREE(pose->scales);
 }
 
-void de_animation_update(de_animation_t* anim, float dt)
-{	
-	float nextTimePos = anim->time_position + dt * anim->speed;
+void de_animation_set_lod(de_animation_t* anim, const de_animation_lod_t* lod)
+{
+	DE_ASSERT(lod->level_count <= DE_ANIMATION_MAX_LOD_LEVELS);
+	anim->lod = *lod;
+}
 
-	for (size_t i = 0; i < anim->tracks.size; ++i) {
-		de_animation_track_t* track;
-		de_keyframe_t keyframe;
-		de_node_t* node;
+void de_animation_set_lod_node(de_animation_t* anim, de_node_t* node)
+{
+	anim->lod_node = node;
+}
 
-		track = anim->tracks.data[i];
+void de_animation_set_pose_cache_step(de_animation_t* anim, float step)
+{
+	anim->pose_cache_step = step > 0.0f ? step : 0.0f;
+	anim->pose_cache_bucket = -1;
+}
 
-		node = track->node;
+/**
+ * @brief Returns amount of ancestors of node up to root (exclusive) or up to top of hierarchy.
+ */
+static uint32_t de_animation_get_node_depth(const de_node_t* node, const de_node_t* root)
+{
+	uint32_t depth = 0;
+	while (node && node != root) {
+		++depth;
+		node = node->parent;
+	}
+	return depth;
+}
 
-		if (!node) {
+/**
+ * @brief Samples tracks of animation, skipping tracks of nodes deeper than max_bone_depth
+ * below lod node. Zero max_bone_depth means no limit.
+ */
+static void de_animation_sample_lod(de_animation_t* anim, float time, de_pose_t* pose, uint32_t max_bone_depth)
+{
+	DE_ASSERT(pose->positions.size >= anim->tracks.size);
+	for (size_t i = 0; i < anim->tracks.size; ++i) {
+		if (max_bone_depth && de_animation_get_node_depth(anim->tracks.data[i]->node, anim->lod_node) > max_bone_depth) {
 			continue;
 		}
+		de_keyframe_t keyframe = {
+			.position = { 0, 0, 0 },
+			.scale = { 1, 1, 1 },
+			.rotation = { 0, 0, 0, 1 }
+		};
+		de_animation_track_get_keyframe(anim->tracks.data[i], time, &keyframe);
+		pose->positions.data[i] = keyframe.position;
+		pose->rotations.data[i] = keyframe.rotation;
+		pose->scales.data[i] = keyframe.scale;
+	}
+}
 
-		de_animation_track_get_keyframe(track, anim->time_position, &keyframe);
-
-		/* Accumulate position */
-		de_vec3_add(&node->position, &node->position, &keyframe.position);
-		
-		/* Accumulate rotation */
-		de_quat_mul(&node->rotation, &node->rotation, &keyframe.rotation);
+void de_animation_sample_all(de_animation_t* anim, float time, de_pose_t* pose)
+{
+	de_animation_sample_lod(anim, time, pose, 0);
+}
 
-		/* Accumulate scale */
-		node->scale.x *= keyframe.scale.x;
-		node->scale.y *= keyframe.scale.y;
-		node->scale.z *= keyframe.scale.z;
+void de_animation_add_track(de_animation_t* anim, de_animation_track_t* track)
+{
+	DE_ARRAY_APPEND(anim->tracks, track);
+}
 
-		node->transform_flags |= DE_TRANSFORM_FLAGS_LOCAL_TRANSFORM_NEED_UPDATE;
-	}
+void de_animation_update(de_animation_t* anim, float dt)
+{	
+	float nextTimePos = anim->time_position + dt * anim->speed;
 
 	de_animation_set_time_position(anim, nextTimePos);
 
@@ -335,6 +527,28 @@ void de_animation_reset_flags(de_animation_t* anim, uint32_t flags)
 	anim->flags &= ~flags;
 }
 
+void de_animation_compress(de_animation_t* anim, const de_animation_compression_params_t* params)
+{
+	for (size_t i = 0; i < anim->tracks.size; ++i) {
+		de_animation_track_compress(anim->tracks.data[i], params);
+	}
+}
+
+size_t de_animation_get_keyframes_size_bytes(de_animation_t* anim)
+{
+	size_t size = 0;
+	for (size_t i = 0; i < anim->tracks.size; ++i) {
+		de_animation_track_data_t* data = anim->tracks.data[i]->data;
+		if (data) {
+			size += DE_ARRAY_SIZE_BYTES(data->keyframes);
+			if (data->compressed) {
+				size += de_compressed_track_get_size_bytes(data->compressed);
+			}
+		}
+	}
+	return size;
+}
+
 void de_animation_clamp_length(de_animation_t* anim)
 {
 	size_t i;
@@ -369,4 +583,300 @@ de_animation_t* de_animation_extract(de_animation_t* anim, float from, float to)
 	}
 
 	return new_anim;
-}
\ No newline at end of file
+}
+
+static void de_animation_pipeline_sample_task(void* arg, size_t index)
+{
+	de_animation_pipeline_t* pipeline = (de_animation_pipeline_t*)arg;
+	de_animation_t* anim = pipeline->sampled.data[index];
+	de_animation_sample_lod(anim, pipeline->sample_times.data[index], &anim->pose, pipeline->max_bone_depths.data[index]);
+}
+
+/**
+ * @brief Returns true if both animations have same cached pose.
+ */
+static bool de_animation_pose_cache_match(const de_animation_t* a, const de_animation_t* b)
+{
+	if (a->pose_cache_bucket != b->pose_cache_bucket || a->pose_cache_step != b->pose_cache_step ||
+		a->tracks.size != b->tracks.size) {
+		return false;
+	}
+	for (size_t i = 0; i < a->tracks.size; ++i) {
+		if (a->tracks.data[i]->data != b->tracks.data[i]->data) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Looks up animation with same cached pose on current frame. If there is no such
+ * animation, adds given animation to cache and returns NULL.
+ */
+static de_animation_t* de_animation_pipeline_find_cached_pose(de_animation_pipeline_t* pipeline, de_animation_t* anim)
+{
+	const size_t mask = pipeline->pose_cache.size - 1;
+	size_t hash = ((size_t)anim->tracks.data[0]->data >> 4) * 2654435761u;
+	hash ^= (size_t)anim->pose_cache_bucket * 40503u;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		de_animation_t* cached = pipeline->pose_cache.data[i];
+		if (!cached) {
+			pipeline->pose_cache.data[i] = anim;
+			return NULL;
+		}
+		if (de_animation_pose_cache_match(cached, anim)) {
+			return cached;
+		}
+	}
+}
+
+static void de_pose_copy(de_pose_t* dest, const de_pose_t* src)
+{
+	DE_ASSERT(dest->positions.size == src->positions.size);
+	memcpy(dest->positions.data, src->positions.data, DE_ARRAY_SIZE_BYTES(src->positions));
+	memcpy(dest->rotations.data, src->rotations.data, DE_ARRAY_SIZE_BYTES(src->rotations));
+	memcpy(dest->scales.data, src->scales.data, DE_ARRAY_SIZE_BYTES(src->scales));
+}
+
+/**
+ * @brief Checks visibility of animation and selects its level of detail. Returns true if
+ * animation should be sampled on given frame.
+ */
+static bool de_animation_lod_update(de_animation_t* anim, const de_node_t* camera, const de_frustum_t* frustum,
+	uint32_t frame, uint32_t* max_bone_depth)
+{
+	*max_bone_depth = 0;
+	anim->culled = false;
+
+	if (!camera || !anim->lod_node) {
+		return true;
+	}
+
+	de_vec3_t position;
+	de_node_get_global_position(anim->lod_node, &position);
+
+	if (anim->lod.culling_mode != DE_ANIMATION_CULLING_MODE_NONE) {
+		if (!anim->lod_node->global_visibility || !de_frustum_sphere_intersection(frustum, &position, anim->lod.bounding_radius)) {
+			anim->culled = true;
+			return false;
+		}
+	}
+
+	if (!anim->lod.level_count) {
+		return true;
+	}
+
+	de_vec3_t camera_position;
+	de_node_get_global_position(camera, &camera_position);
+	const float distance = de_vec3_distance(&position, &camera_position);
+
+	const de_animation_lod_level_t* level = NULL;
+	for (size_t i = 0; i < anim->lod.level_count; ++i) {
+		if (distance >= anim->lod.levels[i].distance) {
+			level = &anim->lod.levels[i];
+		}
+	}
+	if (!level) {
+		return true;
+	}
+
+	*max_bone_depth = level->max_bone_depth;
+	return level->rate_divisor < 2 || (frame % level->rate_divisor) == 0;
+}
+
+static void de_animation_pipeline_blend(de_animation_pipeline_t* pipeline)
+{
+	/* Reset indices first, node could be animated on previous frame */
+	for (size_t k = 0; k < pipeline->animations.size; ++k) {
+		de_animation_t* anim = pipeline->animations.data[k];
+		for (size_t i = 0; i < anim->tracks.size; ++i) {
+			de_node_t* node = anim->tracks.data[i]->node;
+			if (node) {
+				node->pose_index = UINT32_MAX;
+			}
+		}
+	}
+
+	DE_ARRAY_CLEAR(pipeline->nodes);
+	DE_ARRAY_CLEAR(pipeline->weights);
+	de_pose_resize(&pipeline->pose, 0);
+
+	for (size_t k = 0; k < pipeline->animations.size; ++k) {
+		de_animation_t* anim = pipeline->animations.data[k];
+		const float weight = anim->weight;
+		for (size_t i = 0; i < anim->tracks.size; ++i) {
+			de_node_t* node = anim->tracks.data[i]->node;
+			if (!node) {
+				continue;
+			}
+
+			if (node->pose_index == UINT32_MAX) {
+				node->pose_index = (uint32_t)pipeline->nodes.size;
+				DE_ARRAY_APPEND(pipeline->nodes, node);
+				DE_ARRAY_APPEND(pipeline->weights, 0.0f);
+				de_pose_resize(&pipeline->pose, pipeline->nodes.size);
+				pipeline->pose.positions.data[node->pose_index] = (de_vec3_t) { 0, 0, 0 };
+				pipeline->pose.rotations.data[node->pose_index] = (de_quat_t) { 0, 0, 0, 0 };
+				pipeline->pose.scales.data[node->pose_index] = (de_vec3_t) { 0, 0, 0 };
+			}
+
+			const uint32_t n = node->pose_index;
+			const de_vec3_t* position = &anim->pose.positions.data[i];
+			const de_vec3_t* scale = &anim->pose.scales.data[i];
+			const de_quat_t* rotation = &anim->pose.rotations.data[i];
+			de_vec3_t* blend_position = &pipeline->pose.positions.data[n];
+			de_vec3_t* blend_scale = &pipeline->pose.scales.data[n];
+			de_quat_t* blend_rotation = &pipeline->pose.rotations.data[n];
+
+			blend_position->x += position->x * weight;
+			blend_position->y += position->y * weight;
+			blend_position->z += position->z * weight;
+
+			blend_scale->x += scale->x * weight;
+			blend_scale->y += scale->y * weight;
+			blend_scale->z += scale->z * weight;
+
+			/* q and -q are same rotation, accumulate in one hemisphere to not cancel out rotations */
+			const float rotation_weight = de_quat_dot(blend_rotation, rotation) < 0.0f ? -weight : weight;
+			blend_rotation->x += rotation->x * rotation_weight;
+			blend_rotation->y += rotation->y * rotation_weight;
+			blend_rotation->z += rotation->z * rotation_weight;
+			blend_rotation->w += rotation->w * rotation_weight;
+
+			pipeline->weights.data[n] += weight;
+		}
+	}
+}
+
+void de_animation_pipeline_update(de_animation_pipeline_t* pipeline, de_scene_t* scene, float dt)
+{
+	const de_node_t* camera = scene->active_camera;
+	de_frustum_t frustum;
+	if (camera) {
+		de_frustum_from_matrix(&frustum, &camera->s.camera.view_projection_matrix);
+	}
+
+	/* Gather animations which will affect nodes on this frame and prepare memory for
+	 * their poses here, because worker threads must not allocate memory. */
+	DE_ARRAY_CLEAR(pipeline->animations);
+	DE_ARRAY_CLEAR(pipeline->sampled);
+	DE_ARRAY_CLEAR(pipeline->max_bone_depths);
+	DE_ARRAY_CLEAR(pipeline->sample_times);
+	DE_ARRAY_CLEAR(pipeline->cache_users);
+	DE_ARRAY_CLEAR(pipeline->cache_sources);
+
+	/* Prepare pose cache table, keep load factor below 0.5 */
+	size_t cached_count = 0;
+	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, scene->animations)
+	{
+		if (anim->pose_cache_step > 0.0f) {
+			++cached_count;
+		}
+	}
+	DE_ARRAY_CLEAR(pipeline->pose_cache);
+	if (cached_count) {
+		size_t table_size = 1;
+		while (table_size < 2 * cached_count) {
+			table_size *= 2;
+		}
+		DE_ARRAY_GROW(pipeline->pose_cache, table_size);
+		memset(pipeline->pose_cache.data, 0, DE_ARRAY_SIZE_BYTES(pipeline->pose_cache));
+	}
+
+	uint32_t frame = pipeline->frame++;
+	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, scene->animations)
+	{
+		/* Each animation uses own frame number, so animations with lowered rate are
+		 * sampled on different frames. */
+		++frame;
+
+		if (!de_animation_is_flags_set(anim, DE_ANIMATION_FLAG_ENABLED) || anim->weight <= 0.0f) {
+			anim->culled = false;
+			continue;
+		}
+
+		uint32_t max_bone_depth;
+		bool need_sample = de_animation_lod_update(anim, camera, &frustum, frame, &max_bone_depth);
+
+		/* Animation must be fully sampled at least once to have valid pose */
+		if (anim->pose.positions.size != anim->tracks.size) {
+			de_pose_resize(&anim->pose, anim->tracks.size);
+			need_sample = true;
+			max_bone_depth = 0;
+			anim->pose_cache_bucket = -1;
+		}
+
+		float sample_time = anim->time_position;
+		if (need_sample && anim->pose_cache_step > 0.0f && max_bone_depth == 0 && anim->tracks.size && anim->tracks.data[0]->data) {
+			const int32_t bucket = (int32_t)(anim->time_position / anim->pose_cache_step);
+			if (bucket != anim->pose_cache_bucket) {
+				anim->pose_cache_bucket = bucket;
+				sample_time = bucket * anim->pose_cache_step;
+			} else {
+				/* Pose of this time step is already sampled */
+				need_sample = false;
+			}
+			de_animation_t* source = de_animation_pipeline_find_cached_pose(pipeline, anim);
+			if (source && need_sample) {
+				DE_ARRAY_APPEND(pipeline->cache_users, anim);
+				DE_ARRAY_APPEND(pipeline->cache_sources, source);
+				need_sample = false;
+			}
+		} else if (need_sample) {
+			anim->pose_cache_bucket = -1;
+		}
+
+		if (need_sample) {
+			DE_ARRAY_APPEND(pipeline->sampled, anim);
+			DE_ARRAY_APPEND(pipeline->max_bone_depths, max_bone_depth);
+			DE_ARRAY_APPEND(pipeline->sample_times, sample_time);
+		}
+
+		/* Nodes of out of view animations are left untouched */
+		if (!anim->culled) {
+			DE_ARRAY_APPEND(pipeline->animations, anim);
+		}
+	}
+
+	/* Sample poses in parallel */
+	de_thread_pool_parallel_for(scene->core ? de_core_get_thread_pool(scene->core) : NULL,
+		pipeline->sampled.size, de_animation_pipeline_sample_task, pipeline);
+
+	for (size_t i = 0; i < pipeline->cache_users.size; ++i) {
+		de_pose_copy(&pipeline->cache_users.data[i]->pose, &pipeline->cache_sources.data[i]->pose);
+	}
+
+	de_animation_pipeline_blend(pipeline);
+
+	/* Write final poses to nodes */
+	for (size_t i = 0; i < pipeline->nodes.size; ++i) {
+		de_node_t* node = pipeline->nodes.data[i];
+		const float k = 1.0f / pipeline->weights.data[i];
+		de_vec3_scale(&node->position, &pipeline->pose.positions.data[i], k);
+		de_vec3_scale(&node->scale, &pipeline->pose.scales.data[i], k);
+		de_quat_normalize(&node->rotation, &pipeline->pose.rotations.data[i]);
+		node->transform_flags |= DE_TRANSFORM_FLAGS_LOCAL_TRANSFORM_NEED_UPDATE;
+	}
+
+	/* Advance playback */
+	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, scene->animations)
+	{
+		if (!anim->culled || anim->lod.culling_mode != DE_ANIMATION_CULLING_MODE_PAUSE) {
+			de_animation_update(anim, dt);
+		}
+	}
+}
+
+void de_animation_pipeline_free(de_animation_pipeline_t* pipeline)
+{
+	DE_ARRAY_FREE(pipeline->animations);
+	DE_ARRAY_FREE(pipeline->sampled);
+	DE_ARRAY_FREE(pipeline->max_bone_depths);
+	DE_ARRAY_FREE(pipeline->sample_times);
+	DE_ARRAY_FREE(pipeline->pose_cache);
+	DE_ARRAY_FREE(pipeline->cache_users);
+	DE_ARRAY_FREE(pipeline->cache_sources);
+	DE_ARRAY_FREE(pipeline->nodes);
+	DE_ARRAY_FREE(pipeline->weights);
+	de_pose_free(&pipeline->pose);
+}
@@ -25,12 +25,26 @@ typedef struct de_animation_t de_animation_t;
 * @class de_keyframe_t
 * @brief Keyframe
 */
-typedef struct de_keyframe_t {
+struct de_keyframe_t {
 	de_vec3_t position; /**< Position of keyframe */
 	de_vec3_t scale;    /**< Scale of keyframe */
 	de_quat_t rotation; /**< Rotation quaternion of keyframe */
 	float time;         /**< Time of keyframe in seconds */
-} de_keyframe_t;
+};
+
+/**
+ * @class de_animation_track_data_t
+ * @brief Keyframes of animation track.
+ *
+ * Reference counted and shared between copies of a track, so every instance of a model
+ * references same keyframes. Shared data is immutable - modification of a track with
+ * shared data makes private copy of data first.
+ */
+struct de_animation_track_data_t {
+	int32_t ref_count;
+	DE_ARRAY_DECLARE(de_keyframe_t, keyframes); /**< Array of keyframes */
+	de_compressed_track_t* compressed; /**< Compressed keyframes. When not NULL, keyframes array is empty. */
+};
 
 /**
  * @class de_animation_track_t
@@ -40,12 +54,57 @@ typedef struct de_keyframe_t {
  */
 struct de_animation_track_t {
 	de_animation_t* parent_animation;
-	DE_ARRAY_DECLARE(de_keyframe_t, keyframes); /**< Array of keyframes */
+	de_animation_track_data_t* data; /**< Shared keyframes. Can be NULL if track have no keyframes. */
 	bool enabled;       /**< Is track enabled? */
 	float max_time;       /**< Private. Length of animation. */
 	de_node_t* node;
+	size_t cursor;      /**< Private. Index of right keyframe of last sampled interval. Used as a hint for next sampling. */
+	de_compressed_track_cursor_t compressed_cursor; /**< Private. Same as cursor, but for compressed keyframes. */
 };
 
+/**
+ * @class de_pose_t
+ * @brief Local transforms of a set of nodes in structure-of-arrays layout.
+ */
+typedef struct de_pose_t {
+	DE_ARRAY_DECLARE(de_vec3_t, positions);
+	DE_ARRAY_DECLARE(de_quat_t, rotations);
+	DE_ARRAY_DECLARE(de_vec3_t, scales);
+} de_pose_t;
+
+#define DE_ANIMATION_MAX_LOD_LEVELS 4
+
+typedef enum de_animation_culling_mode_t {
+	DE_ANIMATION_CULLING_MODE_NONE,         /**< Animation is sampled even if it is out of view */
+	DE_ANIMATION_CULLING_MODE_ADVANCE_TIME, /**< Out of view animation only advances playback position */
+	DE_ANIMATION_CULLING_MODE_PAUSE         /**< Out of view animation is paused */
+} de_animation_culling_mode_t;
+
+/**
+ * @class de_animation_lod_level_t
+ * @brief Level of detail of an animation.
+ */
+typedef struct de_animation_lod_level_t {
+	float distance;          /**< Distance to active camera starting from which level is used */
+	uint32_t rate_divisor;   /**< Animation is sampled once per rate_divisor frames. 0 or 1 - each frame */
+	uint32_t max_bone_depth; /**< Only tracks of nodes at most that deep below lod node are sampled. 0 - all tracks */
+} de_animation_lod_level_t;
+
+/**
+ * @class de_animation_lod_t
+ * @brief Level of detail settings of an animation.
+ *
+ * Distance and visibility are measured using lod node of animation, so settings have no
+ * effect until lod node is set. Nodes which are not sampled on a frame keep pose from
+ * last sampling.
+ */
+typedef struct de_animation_lod_t {
+	de_animation_lod_level_t levels[DE_ANIMATION_MAX_LOD_LEVELS]; /**< Levels sorted by distance in ascending order */
+	size_t level_count;
+	de_animation_culling_mode_t culling_mode;
+	float bounding_radius; /**< Radius of sphere around lod node which is used for visibility test */
+} de_animation_lod_t;
+
 typedef enum de_animation_flags_t {
 	DE_ANIMATION_FLAG_ENABLED = DE_BIT(0), /**< Is animation enabled? */
 	DE_ANIMATION_FLAG_LOOPED = DE_BIT(1)  /**< Is animation looped */
@@ -67,6 +126,12 @@ struct de_animation_t {
 	float time_position;        /**< Current time of animation (playback position) */
 	float weight;               /**< Weight of animation [0; 1]. Used for animation blending */
 	float fade_step;            /**< Speed of weight fading. Used for animation blending */
+	de_pose_t pose;             /**< Private. Local pose sampled on last update, i-th element corresponds to i-th track. */
+	de_animation_lod_t lod;     /**< Level of detail settings. Non-serializable. */
+	de_node_t* lod_node;        /**< Node which is used to select level of detail, usually root of model instance. Non-serializable. */
+	bool culled;                /**< Private. Animation was out of view on last update. */
+	float pose_cache_step;      /**< Time step of pose cache, zero if pose cache is disabled. Non-serializable. */
+	int32_t pose_cache_bucket;  /**< Private. Index of time step at which pose was sampled, -1 if pose is not cached. */
 	/* Pointer to resource from which this animation was instantiated.
 	 * For now resource type can be only DE_RESOURCE_TYPE_MODEL, because models
 	 * are the only source of animations. In future there can be added more types */
@@ -98,9 +163,59 @@ void de_animation_resolve(de_animation_t* anim);
 * @param track pointer to animation track
 * @param time time in seconds
 * @param out_keyframe pointer to output intepolated keyframe
+*
+* Track remembers interval found on previous call, so sequential sampling with growing
+* time is O(1). Seeks and loops fall back to binary search which is O(log(n)).
 */
 void de_animation_track_get_keyframe(de_animation_track_t* track, float time, de_keyframe_t* out_keyframe);
 
+/**
+ * @brief Samples every track of animation at specified time in one pass.
+ * @param anim pointer to animation
+ * @param time time in seconds
+ * @param pose pointer to pose resized to amount of tracks in animation, i-th element of pose
+ * will contain sample of i-th track.
+ *
+ * Does not allocate memory and touches only tracks of animation and pose, so different
+ * animations can be sampled on different threads.
+ */
+void de_animation_sample_all(de_animation_t* anim, float time, de_pose_t* pose);
+
+/**
+ * @brief Sets level of detail settings of animation.
+ */
+void de_animation_set_lod(de_animation_t* anim, const de_animation_lod_t* lod);
+
+/**
+ * @brief Sets node which position and visibility are used to select level of detail.
+ * Model instantiation sets root of instance as lod node of every instantiated animation.
+ */
+void de_animation_set_lod_node(de_animation_t* anim, de_node_t* node);
+
+/**
+ * @brief Enables pose cache for animation.
+ * @param anim pointer to animation
+ * @param step time step in seconds, zero disables cache
+ *
+ * Animation with pose cache is sampled at time positions rounded down to a multiple of
+ * step. Animations that share keyframes (i.e. same animation of different instances of
+ * a model) with same step and same rounded time position on a frame are sampled only
+ * once and the rest reuse the pose. Animation also is not resampled while its rounded
+ * time position stays the same. Useful for crowds playing same clips. Samplings limited
+ * by bone depth of level of detail bypass the cache.
+ */
+void de_animation_set_pose_cache_step(de_animation_t* anim, float step);
+
+/**
+ * @brief Sets amount of elements in pose. New elements are not initialized.
+ */
+void de_pose_resize(de_pose_t* pose, size_t count);
+
+/**
+ * @brief Frees memory.
+ */
+void de_pose_free(de_pose_t* pose);
+
 /**
  * @brief Adds animations track to an animation. Every animation can contain any number of tracks.
  */
@@ -117,12 +232,22 @@ de_animation_track_t* de_animation_track_create(de_animation_t* anim);
 void de_animation_track_free(de_animation_track_t* track);
 
 /**
- * @brief Adds a keyframe to animation track.
+ * @brief Adds a keyframe to animation track. Track must not be compressed.
  */
 void de_animation_track_add_keyframe(de_animation_track_t* track, const de_keyframe_t* keyframe);
 
+/**
+ * @brief Replaces keyframes of a track with compressed curves. Does nothing if track
+ * is already compressed or have no keyframes. Shared keyframes are compressed in-place,
+ * so every track that shares them will use compressed keyframes.
+ */
+void de_animation_track_compress(de_animation_track_t* track, const de_animation_compression_params_t* params);
+
 void de_animation_track_set_node(de_animation_track_t* track, de_node_t* node);
 
+/**
+ * @brief Copies track to other animation. Copy shares keyframes with source track.
+ */
 de_animation_track_t* de_animation_track_copy(de_animation_track_t* track, de_animation_t* dest_anim);
 
 /**
@@ -130,10 +255,14 @@ de_animation_track_t* de_animation_track_copy(de_animation_track_t* track, de_an
  */
 void de_animation_free(de_animation_t* anim);
 
+/**
+ * @brief Copies animation with every track to other scene. Keyframes are not copied, but shared.
+ */
 de_animation_t* de_animation_copy(de_animation_t* anim, de_scene_t* dest_scene);
 
 /**
- * @brief Updates animation. No need to call directly!
+ * @brief Advances playback position of animation and handles weight fading. Nodes are
+ * animated by de_animation_pipeline_update. No need to call directly!
  */
 void de_animation_update(de_animation_t* anim, float dt);
 
@@ -157,6 +286,20 @@ void de_animation_set_flags(de_animation_t* anim, uint32_t flags);
  */
 void de_animation_reset_flags(de_animation_t* anim, uint32_t flags);
 
+/**
+ * @brief Compresses every track of animation. See de_animation_compression_params_t.
+ *
+ * Compress animations of a model resource before instantiation, so every instance will
+ * get compressed tracks.
+ */
+void de_animation_compress(de_animation_t* anim, const de_animation_compression_params_t* params);
+
+/**
+ * @brief Returns amount of memory used by keyframes of every track of animation in bytes.
+ * Shared keyframes are counted too, even if they're referenced by other animations.
+ */
+size_t de_animation_get_keyframes_size_bytes(de_animation_t* anim);
+
 /**
  * @brief Clamps length of animation to longest track.
  */
@@ -169,4 +312,36 @@ void de_animation_clamp_length(de_animation_t* anim);
  * extract animations from it, to control them separately and perform blending
  * between them.
  */
-de_animation_t* de_animation_extract(de_animation_t* anim, float from, float to);
\ No newline at end of file
+de_animation_t* de_animation_extract(de_animation_t* anim, float from, float to);
+
+/**
+ * @class de_animation_pipeline_t
+ * @brief Internal. Per-scene state of animation pipeline.
+ *
+ * Each frame every enabled animation is sampled into its own local pose on worker
+ * threads, then poses are blended by weights of animations and final local transforms
+ * are written to nodes in one pass.
+ */
+typedef struct de_animation_pipeline_t {
+	DE_ARRAY_DECLARE(de_animation_t*, animations); /**< Animations blended on current frame */
+	DE_ARRAY_DECLARE(de_animation_t*, sampled);    /**< Animations sampled on current frame */
+	DE_ARRAY_DECLARE(uint32_t, max_bone_depths);   /**< Bone depth limit of i-th sampled animation */
+	DE_ARRAY_DECLARE(float, sample_times);         /**< Sampling time of i-th sampled animation */
+	DE_ARRAY_DECLARE(de_animation_t*, pose_cache); /**< Open addressing hash table of animations with cached pose on current frame */
+	DE_ARRAY_DECLARE(de_animation_t*, cache_users);   /**< Animations which take pose from cache... */
+	DE_ARRAY_DECLARE(de_animation_t*, cache_sources); /**< ...and animations from which pose is taken */
+	DE_ARRAY_DECLARE(de_node_t*, nodes);           /**< Animated nodes, i-th node gets i-th element of blended pose */
+	DE_ARRAY_DECLARE(float, weights);              /**< Total weight of animations per node */
+	de_pose_t pose;                                /**< Blended local pose of animated nodes */
+	uint32_t frame;                                /**< Counter of updates, used to distribute sampling of animations with lowered rate */
+} de_animation_pipeline_t;
+
+/**
+ * @brief Internal. Evaluates animations of a scene and writes result to animated nodes.
+ */
+void de_animation_pipeline_update(de_animation_pipeline_t* pipeline, de_scene_t* scene, float dt);
+
+/**
+ * @brief Internal. Frees memory.
+ */
+void de_animation_pipeline_free(de_animation_pipeline_t* pipeline);
\ No newline at end of file
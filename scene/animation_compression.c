@@ -0,0 +1,618 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+#define DE_COMPRESSED_TIME_MAX 65535.0f
+#define DE_QUANTIZED_VEC3_MAX 65535.0f
+/* Max part of error budget which can be taken by quantization of vec3 curve, curves with larger
+ * range are not quantized */
+#define DE_QUANTIZED_VEC3_MAX_ERROR_SHARE 0.5f
+/* Max part of error budget which can be taken by rounding of key times, times of faster curves are
+ * not quantized */
+#define DE_COMPRESSED_TIME_MAX_ERROR_SHARE 0.25f
+#define DE_PACKED_QUAT_COMPONENT_MAX 32767.0f
+#define DE_PACKED_QUAT_SQRT2 1.41421356f
+/* Max angle error in radians introduced by packing of a quaternion */
+#define DE_PACKED_QUAT_ERROR 0.0001f
+
+static uint16_t de_compressed_time_encode(float time, float max_time)
+{
+	if (max_time <= 0.0f) {
+		return 0;
+	}
+	return (uint16_t)(de_clamp(time / max_time, 0.0f, 1.0f) * DE_COMPRESSED_TIME_MAX + 0.5f);
+}
+
+static float de_compressed_time_decode(float time, float max_time)
+{
+	return time / DE_COMPRESSED_TIME_MAX * max_time;
+}
+
+static void de_compressed_times_add(de_compressed_times_t* times, float time, float max_time, bool quantize)
+{
+	if (quantize) {
+		DE_ARRAY_APPEND(times->quantized, de_compressed_time_encode(time, max_time));
+	} else {
+		const float raw = max_time > 0.0f ? de_clamp(time / max_time, 0.0f, 1.0f) * DE_COMPRESSED_TIME_MAX : 0.0f;
+		DE_ARRAY_APPEND(times->raw, raw);
+	}
+}
+
+static size_t de_compressed_times_count(const de_compressed_times_t* times)
+{
+	return times->quantized.size + times->raw.size;
+}
+
+static float de_compressed_times_get(const de_compressed_times_t* times, size_t i)
+{
+	return times->raw.size ? times->raw.data[i] : (float)times->quantized.data[i];
+}
+
+/**
+ * @brief Returns index of first key with time greater or equal to given time (in compressed
+ * units). Checks cursor and its neighbour first, then performs binary search.
+ */
+static size_t de_compressed_curve_find_right_index(const de_compressed_times_t* times, float time, size_t* cursor)
+{
+	const size_t count = de_compressed_times_count(times);
+
+	for (size_t i = *cursor; i < count && i <= *cursor + 1; ++i) {
+		if (de_compressed_times_get(times, i) >= time && (i == 0 || de_compressed_times_get(times, i - 1) < time)) {
+			*cursor = i;
+			return i;
+		}
+	}
+
+	size_t left = 0;
+	size_t right = count;
+	while (left < right) {
+		const size_t middle = left + (right - left) / 2;
+		if (de_compressed_times_get(times, middle) < time) {
+			left = middle + 1;
+		} else {
+			right = middle;
+		}
+	}
+
+	*cursor = left;
+
+	return left;
+}
+
+static const de_vec3_t* de_keyframe_get_vec3(const de_keyframe_t* keyframe, size_t offset)
+{
+	return (const de_vec3_t*)((const char*)keyframe + offset);
+}
+
+static float de_keyframe_get_interpolator(const de_keyframe_t* keyframes, size_t left, size_t right, size_t i)
+{
+	const float length = keyframes[right].time - keyframes[left].time;
+	return length > 0.0f ? (keyframes[i].time - keyframes[left].time) / length : 0.0f;
+}
+
+static void de_quantized_vec3_encode(de_quantized_vec3_t* out, const de_vec3_t* v, const de_vec3_t* min, const de_vec3_t* extent)
+{
+	out->x = extent->x > 0.0f ? (uint16_t)(de_clamp((v->x - min->x) / extent->x, 0.0f, 1.0f) * DE_QUANTIZED_VEC3_MAX + 0.5f) : 0;
+	out->y = extent->y > 0.0f ? (uint16_t)(de_clamp((v->y - min->y) / extent->y, 0.0f, 1.0f) * DE_QUANTIZED_VEC3_MAX + 0.5f) : 0;
+	out->z = extent->z > 0.0f ? (uint16_t)(de_clamp((v->z - min->z) / extent->z, 0.0f, 1.0f) * DE_QUANTIZED_VEC3_MAX + 0.5f) : 0;
+}
+
+static void de_quantized_vec3_decode(const de_quantized_vec3_t* q, const de_vec3_t* min, const de_vec3_t* extent, de_vec3_t* out)
+{
+	out->x = min->x + (float)q->x / DE_QUANTIZED_VEC3_MAX * extent->x;
+	out->y = min->y + (float)q->y / DE_QUANTIZED_VEC3_MAX * extent->y;
+	out->z = min->z + (float)q->z / DE_QUANTIZED_VEC3_MAX * extent->z;
+}
+
+static uint16_t de_packed_quat_encode_component(float c)
+{
+	return (uint16_t)((de_clamp(c * DE_PACKED_QUAT_SQRT2, -1.0f, 1.0f) * 0.5f + 0.5f) * DE_PACKED_QUAT_COMPONENT_MAX + 0.5f);
+}
+
+static float de_packed_quat_decode_component(uint16_t c)
+{
+	return ((float)c / DE_PACKED_QUAT_COMPONENT_MAX * 2.0f - 1.0f) / DE_PACKED_QUAT_SQRT2;
+}
+
+static void de_packed_quat_encode(de_packed_quat_t* out, const de_quat_t* q)
+{
+	float c[4] = { q->x, q->y, q->z, q->w };
+	float len = de_quat_len(q);
+	unsigned int largest = 0;
+	uint16_t v[3];
+	size_t k = 0;
+
+	if (len > 0.0f) {
+		for (unsigned int i = 0; i < 4; ++i) {
+			c[i] /= len;
+		}
+	}
+
+	for (unsigned int i = 1; i < 4; ++i) {
+		if (fabs(c[i]) > fabs(c[largest])) {
+			largest = i;
+		}
+	}
+
+	/* q and -q represents same rotation, so make largest component positive to be
+	 * able to restore it from other three */
+	const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+	for (unsigned int i = 0; i < 4; ++i) {
+		if (i != largest) {
+			v[k++] = de_packed_quat_encode_component(c[i] * sign);
+		}
+	}
+
+	out->a = (uint16_t)(v[0] | ((largest >> 1) << 15));
+	out->b = (uint16_t)(v[1] | ((largest & 1) << 15));
+	out->c = v[2];
+}
+
+static void de_packed_quat_decode(const de_packed_quat_t* p, de_quat_t* out)
+{
+	const unsigned int largest = ((unsigned int)(p->a >> 15) << 1) | (unsigned int)(p->b >> 15);
+	const float v[3] = {
+		de_packed_quat_decode_component(p->a & 0x7FFF),
+		de_packed_quat_decode_component(p->b & 0x7FFF),
+		de_packed_quat_decode_component(p->c & 0x7FFF)
+	};
+	float c[4];
+	float sqr_sum = 0.0f;
+	size_t k = 0;
+
+	for (unsigned int i = 0; i < 4; ++i) {
+		if (i != largest) {
+			c[i] = v[k++];
+			sqr_sum += c[i] * c[i];
+		}
+	}
+	c[largest] = (float)sqrt(de_maxf(1.0f - sqr_sum, 0.0f));
+
+	out->x = c[0];
+	out->y = c[1];
+	out->z = c[2];
+	out->w = c[3];
+}
+
+/**
+ * @brief Interpolates rotations using shortest arc.
+ */
+static void de_quat_slerp_shortest(de_quat_t* out, const de_quat_t* a, const de_quat_t* b, float t)
+{
+	de_quat_t near_b = *b;
+	if (de_quat_dot(a, b) < 0.0f) {
+		near_b.x = -b->x;
+		near_b.y = -b->y;
+		near_b.z = -b->z;
+		near_b.w = -b->w;
+	}
+	de_quat_slerp(out, a, &near_b, t);
+}
+
+/**
+ * @brief Returns angle of rotation which turns a into b. Computed in double: acos of float
+ * near 1 has resolution of ~0.0007 rad, which is comparable with error limits.
+ */
+static float de_quat_rotation_error(const de_quat_t* a, const de_quat_t* b)
+{
+	const double dot = (double)a->x * b->x + (double)a->y * b->y + (double)a->z * b->z + (double)a->w * b->w;
+	const double sqr_len_a = (double)a->x * a->x + (double)a->y * a->y + (double)a->z * a->z + (double)a->w * a->w;
+	const double sqr_len_b = (double)b->x * b->x + (double)b->y * b->y + (double)b->z * b->z + (double)b->w * b->w;
+	const double s = sqrt(sqr_len_a * sqr_len_b);
+	const double d = s > 0.0 ? fabs(dot) / s : 1.0;
+	return (float)(2.0 * acos(d < 1.0 ? d : 1.0));
+}
+
+/**
+ * @brief Returns speed of change between two keys over shortest of source and rounded intervals.
+ * Keys which collapse into same rounded time give infinite speed.
+ */
+static float de_compressed_time_speed(float distance, float left_time, float right_time, float max_time)
+{
+	if (distance <= 0.0f || right_time <= left_time) {
+		return 0.0f;
+	}
+	const float rounded_duration = de_compressed_time_decode(de_compressed_time_encode(right_time, max_time), max_time) -
+		de_compressed_time_decode(de_compressed_time_encode(left_time, max_time), max_time);
+	const float duration = de_minf(right_time - left_time, rounded_duration);
+	return duration > 0.0f ? distance / duration : FLT_MAX;
+}
+
+/**
+ * @brief Returns max deviation of curve caused by rounding times of keys to 16 bits. Each key moves
+ * by at most half of a step, so sampled value moves by at most that times fastest speed of curve.
+ */
+static float de_compressed_time_error(float max_speed, float max_time)
+{
+	return max_speed < FLT_MAX ? max_speed * 0.5f * max_time / DE_COMPRESSED_TIME_MAX : FLT_MAX;
+}
+
+static float de_vec3_curve_get_time_error(const de_keyframe_t* keyframes, size_t count, size_t offset, float max_time)
+{
+	float max_speed = 0.0f;
+	for (size_t i = 1; i < count; ++i) {
+		const float distance = de_vec3_distance(de_keyframe_get_vec3(&keyframes[i - 1], offset), de_keyframe_get_vec3(&keyframes[i], offset));
+		max_speed = de_maxf(max_speed, de_compressed_time_speed(distance, keyframes[i - 1].time, keyframes[i].time, max_time));
+	}
+	return de_compressed_time_error(max_speed, max_time);
+}
+
+static float de_quat_curve_get_time_error(const de_keyframe_t* keyframes, size_t count, float max_time)
+{
+	float max_speed = 0.0f;
+	for (size_t i = 1; i < count; ++i) {
+		const float angle = de_quat_rotation_error(&keyframes[i - 1].rotation, &keyframes[i].rotation);
+		max_speed = de_maxf(max_speed, de_compressed_time_speed(angle, keyframes[i - 1].time, keyframes[i].time, max_time));
+	}
+	return de_compressed_time_error(max_speed, max_time);
+}
+
+/**
+ * @brief Checks if every key between left and right can be restored by linear
+ * interpolation between left and right keys within given error.
+ */
+static bool de_vec3_segment_fits(const de_keyframe_t* keyframes, size_t offset, size_t left, size_t right, float error)
+{
+	const de_vec3_t* a = de_keyframe_get_vec3(&keyframes[left], offset);
+	const de_vec3_t* b = de_keyframe_get_vec3(&keyframes[right], offset);
+	for (size_t i = left + 1; i < right; ++i) {
+		de_vec3_t v;
+		de_vec3_lerp(&v, a, b, de_keyframe_get_interpolator(keyframes, left, right, i));
+		if (de_vec3_distance(&v, de_keyframe_get_vec3(&keyframes[i], offset)) > error) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool de_quat_segment_fits(const de_keyframe_t* keyframes, size_t left, size_t right, float error)
+{
+	const de_quat_t* a = &keyframes[left].rotation;
+	const de_quat_t* b = &keyframes[right].rotation;
+	for (size_t i = left + 1; i < right; ++i) {
+		de_quat_t q;
+		de_quat_slerp_shortest(&q, a, b, de_keyframe_get_interpolator(keyframes, left, right, i));
+		if (de_quat_rotation_error(&q, &keyframes[i].rotation) > error) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void de_vec3_curve_add_key(de_vec3_curve_t* curve, const de_keyframe_t* keyframe, size_t offset, float max_time, bool quantize_time, bool quantize)
+{
+	de_compressed_times_add(&curve->times, keyframe->time, max_time, quantize_time);
+	if (quantize) {
+		de_quantized_vec3_t value;
+		de_quantized_vec3_encode(&value, de_keyframe_get_vec3(keyframe, offset), &curve->min, &curve->extent);
+		DE_ARRAY_APPEND(curve->values, value);
+	} else {
+		DE_ARRAY_APPEND(curve->raw_values, *de_keyframe_get_vec3(keyframe, offset));
+	}
+}
+
+static void de_vec3_curve_get_key(const de_vec3_curve_t* curve, size_t i, de_vec3_t* out)
+{
+	if (curve->raw_values.size) {
+		*out = curve->raw_values.data[i];
+	} else {
+		de_quantized_vec3_decode(&curve->values.data[i], &curve->min, &curve->extent, out);
+	}
+}
+
+static void de_quat_curve_add_key(de_quat_curve_t* curve, const de_keyframe_t* keyframe, float max_time, bool quantize_time)
+{
+	de_packed_quat_t value;
+	de_packed_quat_encode(&value, &keyframe->rotation);
+	de_compressed_times_add(&curve->times, keyframe->time, max_time, quantize_time);
+	DE_ARRAY_APPEND(curve->values, value);
+}
+
+static void de_vec3_curve_build(de_vec3_curve_t* curve, const de_keyframe_t* keyframes, size_t count, size_t offset, float max_time, float error)
+{
+	de_vec3_t max;
+	bool constant = true;
+
+	/* Find quantization range */
+	curve->min = *de_keyframe_get_vec3(&keyframes[0], offset);
+	max = curve->min;
+	for (size_t i = 1; i < count; ++i) {
+		de_vec3_min_max(de_keyframe_get_vec3(&keyframes[i], offset), &curve->min, &max);
+	}
+	de_vec3_sub(&curve->extent, &max, &curve->min);
+
+	/* Rounding of key times moves curve in time, so it eats part of error budget too */
+	const float time_error = de_vec3_curve_get_time_error(keyframes, count, offset, max_time);
+	const bool quantize_time = time_error <= error * DE_COMPRESSED_TIME_MAX_ERROR_SHARE;
+	if (quantize_time) {
+		error -= time_error;
+	}
+
+	/* Rounding moves each component by at most half of a step, so quantization eats part of error
+	 * budget. If it would take too much, keys are kept as is and whole budget goes to key reduction */
+	const float quantization_error = 0.5f * de_vec3_len(&curve->extent) / DE_QUANTIZED_VEC3_MAX;
+	const bool quantize = quantization_error <= error * DE_QUANTIZED_VEC3_MAX_ERROR_SHARE;
+	if (quantize) {
+		error -= quantization_error;
+	}
+
+	/* Fold constant channel into single key */
+	for (size_t i = 1; i < count && constant; ++i) {
+		constant = de_vec3_distance(de_keyframe_get_vec3(&keyframes[i], offset), de_keyframe_get_vec3(&keyframes[0], offset)) <= error;
+	}
+	if (constant) {
+		de_vec3_curve_add_key(curve, &keyframes[0], offset, max_time, quantize_time, quantize);
+		return;
+	}
+
+	/* Remove keys which can be restored by interpolation */
+	size_t anchor = 0;
+	de_vec3_curve_add_key(curve, &keyframes[anchor], offset, max_time, quantize_time, quantize);
+	for (size_t i = 2; i < count; ++i) {
+		if (!de_vec3_segment_fits(keyframes, offset, anchor, i, error)) {
+			anchor = i - 1;
+			de_vec3_curve_add_key(curve, &keyframes[anchor], offset, max_time, quantize_time, quantize);
+		}
+	}
+	de_vec3_curve_add_key(curve, &keyframes[count - 1], offset, max_time, quantize_time, quantize);
+}
+
+static void de_quat_curve_build(de_quat_curve_t* curve, const de_keyframe_t* keyframes, size_t count, float max_time, float error)
+{
+	bool constant = true;
+
+	error = de_maxf(error - DE_PACKED_QUAT_ERROR, 0.0f);
+
+	const float time_error = de_quat_curve_get_time_error(keyframes, count, max_time);
+	const bool quantize_time = time_error <= error * DE_COMPRESSED_TIME_MAX_ERROR_SHARE;
+	if (quantize_time) {
+		error -= time_error;
+	}
+
+	for (size_t i = 1; i < count && constant; ++i) {
+		constant = de_quat_rotation_error(&keyframes[i].rotation, &keyframes[0].rotation) <= error;
+	}
+	if (constant) {
+		de_quat_curve_add_key(curve, &keyframes[0], max_time, quantize_time);
+		return;
+	}
+
+	size_t anchor = 0;
+	de_quat_curve_add_key(curve, &keyframes[anchor], max_time, quantize_time);
+	for (size_t i = 2; i < count; ++i) {
+		if (!de_quat_segment_fits(keyframes, anchor, i, error)) {
+			anchor = i - 1;
+			de_quat_curve_add_key(curve, &keyframes[anchor], max_time, quantize_time);
+		}
+	}
+	de_quat_curve_add_key(curve, &keyframes[count - 1], max_time, quantize_time);
+}
+
+static void de_vec3_curve_sample(const de_vec3_curve_t* curve, size_t* cursor, float time, de_vec3_t* out)
+{
+	const size_t count = de_compressed_times_count(&curve->times);
+	const size_t right = count > 1 ? de_compressed_curve_find_right_index(&curve->times, time, cursor) : 0;
+
+	if (right == 0) {
+		de_vec3_curve_get_key(curve, 0, out);
+	} else if (right >= count) {
+		de_vec3_curve_get_key(curve, count - 1, out);
+	} else {
+		const size_t left = right - 1;
+		const float left_time = de_compressed_times_get(&curve->times, left);
+		const float length = de_compressed_times_get(&curve->times, right) - left_time;
+		de_vec3_t a, b;
+		de_vec3_curve_get_key(curve, left, &a);
+		de_vec3_curve_get_key(curve, right, &b);
+		de_vec3_lerp(out, &a, &b, length > 0.0f ? (time - left_time) / length : 0.0f);
+	}
+}
+
+static void de_quat_curve_sample(const de_quat_curve_t* curve, size_t* cursor, float time, de_quat_t* out)
+{
+	const size_t count = curve->values.size;
+	const size_t right = count > 1 ? de_compressed_curve_find_right_index(&curve->times, time, cursor) : 0;
+
+	if (right == 0) {
+		de_packed_quat_decode(&curve->values.data[0], out);
+	} else if (right >= count) {
+		de_packed_quat_decode(&curve->values.data[count - 1], out);
+	} else {
+		const size_t left = right - 1;
+		const float left_time = de_compressed_times_get(&curve->times, left);
+		const float length = de_compressed_times_get(&curve->times, right) - left_time;
+		de_quat_t a, b;
+		de_packed_quat_decode(&curve->values.data[left], &a);
+		de_packed_quat_decode(&curve->values.data[right], &b);
+		de_quat_slerp_shortest(out, &a, &b, length > 0.0f ? (time - left_time) / length : 0.0f);
+	}
+}
+
+/**
+ * @brief Shrinks arrays of key times to their size. Only one of arrays is used.
+ */
+static void de_compressed_times_compact(de_compressed_times_t* times)
+{
+	if (times->raw.size) {
+		DE_ARRAY_COMPACT(times->raw);
+	} else {
+		DE_ARRAY_COMPACT(times->quantized);
+	}
+}
+
+static void de_compressed_times_copy(const de_compressed_times_t* times, de_compressed_times_t* dest)
+{
+	if (times->raw.size) {
+		DE_ARRAY_COPY(times->raw, dest->raw);
+	} else {
+		DE_ARRAY_COPY(times->quantized, dest->quantized);
+	}
+}
+
+static void de_compressed_times_free(de_compressed_times_t* times)
+{
+	DE_ARRAY_FREE(times->quantized);
+	DE_ARRAY_FREE(times->raw);
+}
+
+static size_t de_compressed_times_get_size_bytes(const de_compressed_times_t* times)
+{
+	return DE_ARRAY_SIZE_BYTES(times->quantized) + DE_ARRAY_SIZE_BYTES(times->raw);
+}
+
+/**
+ * @brief Shrinks arrays of a curve to its size. Only one of key arrays is used.
+ */
+static void de_vec3_curve_compact(de_vec3_curve_t* curve)
+{
+	de_compressed_times_compact(&curve->times);
+	if (curve->raw_values.size) {
+		DE_ARRAY_COMPACT(curve->raw_values);
+	} else {
+		DE_ARRAY_COMPACT(curve->values);
+	}
+}
+
+void de_animation_compression_params_default(de_animation_compression_params_t* params)
+{
+	DE_ASSERT(params);
+	params->position_error = 0.001f;
+	params->rotation_error = 0.001f;
+	params->scale_error = 0.001f;
+}
+
+de_compressed_track_t* de_compressed_track_create(const de_keyframe_t* keyframes, size_t count, const de_animation_compression_params_t* params)
+{
+	DE_ASSERT(keyframes);
+	DE_ASSERT(count);
+	DE_ASSERT(params);
+
+	de_compressed_track_t* track = DE_NEW(de_compressed_track_t);
+	track->max_time = keyframes[count - 1].time;
+	de_vec3_curve_build(&track->position, keyframes, count, offsetof(de_keyframe_t, position), track->max_time, params->position_error);
+	de_quat_curve_build(&track->rotation, keyframes, count, track->max_time, params->rotation_error);
+	de_vec3_curve_build(&track->scale, keyframes, count, offsetof(de_keyframe_t, scale), track->max_time, params->scale_error);
+	de_vec3_curve_compact(&track->position);
+	de_compressed_times_compact(&track->rotation.times);
+	DE_ARRAY_COMPACT(track->rotation.values);
+	de_vec3_curve_compact(&track->scale);
+	return track;
+}
+
+static void de_vec3_curve_copy(const de_vec3_curve_t* curve, de_vec3_curve_t* dest)
+{
+	de_compressed_times_copy(&curve->times, &dest->times);
+	if (curve->raw_values.size) {
+		DE_ARRAY_COPY(curve->raw_values, dest->raw_values);
+	} else {
+		DE_ARRAY_COPY(curve->values, dest->values);
+	}
+	dest->min = curve->min;
+	dest->extent = curve->extent;
+}
+
+de_compressed_track_t* de_compressed_track_copy(const de_compressed_track_t* track)
+{
+	DE_ASSERT(track);
+	de_compressed_track_t* copy = DE_NEW(de_compressed_track_t);
+	de_vec3_curve_copy(&track->position, &copy->position);
+	de_compressed_times_copy(&track->rotation.times, &copy->rotation.times);
+	DE_ARRAY_COPY(track->rotation.values, copy->rotation.values);
+	de_vec3_curve_copy(&track->scale, &copy->scale);
+	copy->max_time = track->max_time;
+	return copy;
+}
+
+void de_compressed_track_free(de_compressed_track_t* track)
+{
+	DE_ASSERT(track);
+	de_compressed_times_free(&track->position.times);
+	DE_ARRAY_FREE(track->position.values);
+	DE_ARRAY_FREE(track->position.raw_values);
+	de_compressed_times_free(&track->rotation.times);
+	DE_ARRAY_FREE(track->rotation.values);
+	de_compressed_times_free(&track->scale.times);
+	DE_ARRAY_FREE(track->scale.values);
+	DE_ARRAY_FREE(track->scale.raw_values);
+	de_free(track);
+}
+
+void de_compressed_track_sample(const de_compressed_track_t* track, de_compressed_track_cursor_t* cursor, float time, de_keyframe_t* out_keyframe)
+{
+	DE_ASSERT(track);
+	DE_ASSERT(cursor);
+	DE_ASSERT(out_keyframe);
+	time = de_clamp(time, 0.0f, track->max_time);
+	const float compressed_time = track->max_time > 0.0f ? time / track->max_time * DE_COMPRESSED_TIME_MAX : 0.0f;
+	de_vec3_curve_sample(&track->position, &cursor->position, compressed_time, &out_keyframe->position);
+	de_quat_curve_sample(&track->rotation, &cursor->rotation, compressed_time, &out_keyframe->rotation);
+	de_vec3_curve_sample(&track->scale, &cursor->scale, compressed_time, &out_keyframe->scale);
+	out_keyframe->time = time;
+}
+
+void de_compressed_track_decompress(const de_compressed_track_t* track, de_animation_track_data_t* dest)
+{
+	DE_ASSERT(track);
+	DE_ASSERT(dest);
+	de_compressed_track_cursor_t cursor = { 0, 0, 0 };
+	size_t p = 0, r = 0, s = 0;
+	for (;;) {
+		/* Take smallest time of next key among every curve */
+		float time = FLT_MAX;
+		if (p < de_compressed_times_count(&track->position.times)) {
+			time = de_compressed_times_get(&track->position.times, p);
+		}
+		if (r < de_compressed_times_count(&track->rotation.times)) {
+			time = de_minf(time, de_compressed_times_get(&track->rotation.times, r));
+		}
+		if (s < de_compressed_times_count(&track->scale.times)) {
+			time = de_minf(time, de_compressed_times_get(&track->scale.times, s));
+		}
+		if (time == FLT_MAX) {
+			break;
+		}
+
+		de_keyframe_t keyframe;
+		de_compressed_track_sample(track, &cursor, de_compressed_time_decode(time, track->max_time), &keyframe);
+		DE_ARRAY_APPEND(dest->keyframes, keyframe);
+
+		/* Skip keys with same time */
+		while (p < de_compressed_times_count(&track->position.times) && de_compressed_times_get(&track->position.times, p) == time) {
+			++p;
+		}
+		while (r < de_compressed_times_count(&track->rotation.times) && de_compressed_times_get(&track->rotation.times, r) == time) {
+			++r;
+		}
+		while (s < de_compressed_times_count(&track->scale.times) && de_compressed_times_get(&track->scale.times, s) == time) {
+			++s;
+		}
+	}
+}
+
+size_t de_compressed_track_get_size_bytes(const de_compressed_track_t* track)
+{
+	DE_ASSERT(track);
+	return sizeof(*track) +
+		de_compressed_times_get_size_bytes(&track->position.times) + DE_ARRAY_SIZE_BYTES(track->position.values) +
+		DE_ARRAY_SIZE_BYTES(track->position.raw_values) +
+		de_compressed_times_get_size_bytes(&track->rotation.times) + DE_ARRAY_SIZE_BYTES(track->rotation.values) +
+		de_compressed_times_get_size_bytes(&track->scale.times) + DE_ARRAY_SIZE_BYTES(track->scale.values) +
+		DE_ARRAY_SIZE_BYTES(track->scale.raw_values);
+}
@@ -0,0 +1,147 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+/**
+ * Compressed animation tracks.
+ *
+ * Keyframes baked from FBX store full position, scale and rotation for every key even
+ * if a channel is constant or changes linearly. Compressed track splits keyframes into
+ * separate per-channel curves, folds constant channels into single key, removes keys that
+ * can be restored by interpolation within given error and quantizes what is left:
+ *  - time of a key is stored as 16-bit fraction of track length, if shift of keys fits error.
+ *  - position and scale are stored as 16-bit per component within bounds of a curve.
+ *  - rotation is stored as 48-bit "smallest three" quaternion.
+ */
+
+/**
+ * @brief Parameters of animation compression. Each error is maximum allowed deviation of
+ * compressed curve from source keyframes.
+ */
+typedef struct de_animation_compression_params_t {
+	float position_error; /**< Maximum position error in units */
+	float rotation_error; /**< Maximum rotation error in radians */
+	float scale_error;    /**< Maximum scale error */
+} de_animation_compression_params_t;
+
+/**
+ * @brief 3D vector quantized to 16 bits per component within bounds of a curve.
+ */
+typedef struct de_quantized_vec3_t {
+	uint16_t x;
+	uint16_t y;
+	uint16_t z;
+} de_quantized_vec3_t;
+
+/**
+ * @brief Rotation quaternion packed using "smallest three" method: largest component is dropped
+ * and restored from unit length constraint, other three are stored with 15 bits per component.
+ * Index of dropped component is stored in high bits of first two components.
+ */
+typedef struct de_packed_quat_t {
+	uint16_t a;
+	uint16_t b;
+	uint16_t c;
+} de_packed_quat_t;
+
+/**
+ * @brief Times of keys of a curve. Shifting a key to 16-bit time moves sampled values, so times
+ * of curves which change too fast for track length to fit error budget are kept unquantized.
+ */
+typedef struct de_compressed_times_t {
+	DE_ARRAY_DECLARE(uint16_t, quantized); /**< Time of each key as fraction of track length in [0; 65535] */
+	DE_ARRAY_DECLARE(float, raw);          /**< Used instead of quantized, same units but not rounded */
+} de_compressed_times_t;
+
+/**
+ * @brief Curve of 3D vector (position or scale) with quantized keys. Curves with range too large
+ * to be quantized within error budget (long root motion) keep keys unquantized.
+ */
+typedef struct de_vec3_curve_t {
+	de_compressed_times_t times;
+	DE_ARRAY_DECLARE(de_quantized_vec3_t, values);
+	DE_ARRAY_DECLARE(de_vec3_t, raw_values); /**< Used instead of values when range is too large */
+	de_vec3_t min;    /**< Minimal value of a curve, origin of quantization range */
+	de_vec3_t extent; /**< Size of quantization range */
+} de_vec3_curve_t;
+
+/**
+ * @brief Curve of rotation with packed keys.
+ */
+typedef struct de_quat_curve_t {
+	de_compressed_times_t times;
+	DE_ARRAY_DECLARE(de_packed_quat_t, values);
+} de_quat_curve_t;
+
+/**
+ * @brief Playback position in compressed track. Compressed track is immutable and can be shared
+ * between instances of animation, so each instance keeps its own cursor.
+ */
+typedef struct de_compressed_track_cursor_t {
+	size_t position; /**< Index of right key of last sampled interval of position curve. */
+	size_t rotation; /**< Index of right key of last sampled interval of rotation curve. */
+	size_t scale;    /**< Index of right key of last sampled interval of scale curve. */
+} de_compressed_track_cursor_t;
+
+typedef struct de_compressed_track_t {
+	de_vec3_curve_t position;
+	de_quat_curve_t rotation;
+	de_vec3_curve_t scale;
+	float max_time; /**< Length of track in seconds. Used to decode time of keys. */
+} de_compressed_track_t;
+
+/**
+ * @brief Fills compression parameters with values which gives visually lossless result for
+ * most of humanoid animations.
+ */
+void de_animation_compression_params_default(de_animation_compression_params_t* params);
+
+/**
+ * @brief Creates compressed track from given keyframes. Keyframes must be sorted by time.
+ */
+de_compressed_track_t* de_compressed_track_create(const de_keyframe_t* keyframes, size_t count, const de_animation_compression_params_t* params);
+
+/**
+ * @brief Makes full copy of compressed track.
+ */
+de_compressed_track_t* de_compressed_track_copy(const de_compressed_track_t* track);
+
+/**
+ * @brief Frees memory.
+ */
+void de_compressed_track_free(de_compressed_track_t* track);
+
+/**
+ * @brief Writes out intepolated keyframe from compressed track at specified time. Sequential
+ * sampling is O(1), seeks fall back to binary search.
+ * @param cursor playback position of caller, updated on each call.
+ */
+void de_compressed_track_sample(const de_compressed_track_t* track, de_compressed_track_cursor_t* cursor, float time, de_keyframe_t* out_keyframe);
+
+/**
+ * @brief Appends keyframes restored from compressed track to track data. One keyframe will be
+ * added per each unique time of key in any of curves.
+ */
+void de_compressed_track_decompress(const de_compressed_track_t* track, de_animation_track_data_t* dest);
+
+/**
+ * @brief Returns total amount of memory used by compressed track in bytes.
+ */
+size_t de_compressed_track_get_size_bytes(const de_compressed_track_t* track);
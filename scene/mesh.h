@@ -26,6 +26,7 @@
 */
 struct de_mesh_t {
 	DE_ARRAY_DECLARE(de_surface_t*, surfaces); /**< Array of pointer to surfaces */
+	bool batched; /**< Private. Surfaces are merged into static batches of scene and not rendered separately */
 };
 
 struct de_node_dispatch_table_t* de_mesh_get_dispatch_table(void);
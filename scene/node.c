@@ -165,7 +165,7 @@ de_node_t* de_node_create(de_scene_t* scene, de_node_type_t type)
 	return node;
 }
 
-static de_node_t* de_node_copy_internal(de_scene_t* dest_scene, de_node_t* node)
+de_node_t* de_node_copy_single(de_scene_t* dest_scene, de_node_t* node)
 {
 	de_node_t* copy = DE_NEW(de_node_t);
 	copy->dispatch_table = node->dispatch_table;
@@ -198,12 +198,18 @@ static de_node_t* de_node_copy_internal(de_scene_t* dest_scene, de_node_t* node)
 	if (body) {
 		copy->body = de_body_copy(dest_scene, body);
 	}
-	for (size_t i = 0; i < node->children.size; ++i) {
-		de_node_attach(de_node_copy_internal(dest_scene, node->children.data[i]), copy);
-	}
 	if (node->dispatch_table->copy) {
 		node->dispatch_table->copy(node, copy);
 	}
+	return copy;
+}
+
+static de_node_t* de_node_copy_internal(de_scene_t* dest_scene, de_node_t* node)
+{
+	de_node_t* copy = de_node_copy_single(dest_scene, node);
+	for (size_t i = 0; i < node->children.size; ++i) {
+		de_node_attach(de_node_copy_internal(dest_scene, node->children.data[i]), copy);
+	}
 	de_node_calculate_transforms_ascending(copy);
 	return copy;
 }
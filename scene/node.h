@@ -94,6 +94,7 @@ struct de_node_t {
 	float depth_hack; /**< Depth hack value for node, will be used to hack projection matrix on render. Used to make object render on-top of other. */
 	de_resource_t* model_resource; /**< Pointer to model from which this node was instantiated.  */
 	de_node_dispatch_table_t* dispatch_table;
+	uint32_t pose_index; /**< Internal. Index of node in blended pose of animation pipeline. Valid only during animation update. */
 	DE_LINKED_LIST_ITEM(struct de_node_t);
 	/* Specialization. Avoid accessing these directly, use de_node_to_xxx instead. */
 	union {
@@ -115,6 +116,13 @@ de_node_t* de_node_create(de_scene_t* scene, de_node_type_t type);
  */
 de_node_t* de_node_copy(de_scene_t* dest_scene, de_node_t* node_handle);
 
+/**
+ * @brief Internal. Copies a single node without its children to destination scene. Type-specific
+ * data is copied too, but references to other nodes (i.e. surface bones) are left pointing to
+ * nodes of source scene and must be remapped by caller.
+ */
+de_node_t* de_node_copy_single(de_scene_t* dest_scene, de_node_t* node);
+
 /**
 * @brief Frees scene node.
 * @param node node reference
@@ -32,6 +32,104 @@ static void de_particle_system_emitter_free(de_particle_system_emitter_t* emitte
 	de_free(emitter);
 }
 
+/**
+ * @brief Makes sure that storage can hold at least specified amount of particles. All streams
+ * are placed in one memory block, each stream is aligned and padded to DE_PARTICLE_STREAM_ALIGNMENT.
+ */
+static void de_particle_storage_reserve(de_particle_storage_t* storage, size_t capacity)
+{
+	if (capacity <= storage->capacity) {
+		return;
+	}
+
+	/* Capacity is always power of two which is not less than 64, so it is multiple of any vector width */
+	size_t new_capacity = storage->capacity ? storage->capacity : 64;
+	while (new_capacity < capacity) {
+		new_capacity *= 2;
+	}
+
+	struct {
+		void** data;
+		size_t element_size;
+	} streams[] = {
+		{ (void**)&storage->position_x, sizeof(float) },
+		{ (void**)&storage->position_y, sizeof(float) },
+		{ (void**)&storage->position_z, sizeof(float) },
+		{ (void**)&storage->velocity_x, sizeof(float) },
+		{ (void**)&storage->velocity_y, sizeof(float) },
+		{ (void**)&storage->velocity_z, sizeof(float) },
+		{ (void**)&storage->size, sizeof(float) },
+		{ (void**)&storage->size_modifier, sizeof(float) },
+		{ (void**)&storage->rotation, sizeof(float) },
+		{ (void**)&storage->rotation_speed, sizeof(float) },
+		{ (void**)&storage->lifetime, sizeof(float) },
+		{ (void**)&storage->inv_initial_lifetime, sizeof(float) },
+		{ (void**)&storage->color, sizeof(uint32_t) },
+		{ (void**)&storage->owner, sizeof(de_particle_system_emitter_t*) },
+	};
+	const size_t stream_count = sizeof(streams) / sizeof(streams[0]);
+	const size_t alignment = DE_PARTICLE_STREAM_ALIGNMENT;
+
+	size_t total_size = alignment;
+	for (size_t i = 0; i < stream_count; ++i) {
+		total_size += (new_capacity * streams[i].element_size + alignment - 1) & ~(alignment - 1);
+	}
+
+	/* Zeroed memory makes padding harmless for vector kernels */
+	uint8_t* memory = de_calloc(1, total_size);
+	uint8_t* ptr = (uint8_t*)(((uintptr_t)memory + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	for (size_t i = 0; i < stream_count; ++i) {
+		if (*streams[i].data) {
+			memcpy(ptr, *streams[i].data, storage->count * streams[i].element_size);
+		}
+		*streams[i].data = ptr;
+		ptr += (new_capacity * streams[i].element_size + alignment - 1) & ~(alignment - 1);
+	}
+
+	de_free(storage->memory);
+	storage->memory = memory;
+	storage->capacity = new_capacity;
+}
+
+static void de_particle_storage_free(de_particle_storage_t* storage)
+{
+	de_free(storage->memory);
+	memset(storage, 0, sizeof(*storage));
+}
+
+/**
+ * @brief Adds new particle to the end of storage and returns its index. Particle is not initialized.
+ */
+static size_t de_particle_storage_add(de_particle_storage_t* storage)
+{
+	de_particle_storage_reserve(storage, storage->count + 1);
+	return storage->count++;
+}
+
+/**
+ * @brief Removes particle by moving last particle in its place.
+ */
+static void de_particle_storage_remove(de_particle_storage_t* storage, size_t index)
+{
+	const size_t last = --storage->count;
+	if (index != last) {
+		storage->position_x[index] = storage->position_x[last];
+		storage->position_y[index] = storage->position_y[last];
+		storage->position_z[index] = storage->position_z[last];
+		storage->velocity_x[index] = storage->velocity_x[last];
+		storage->velocity_y[index] = storage->velocity_y[last];
+		storage->velocity_z[index] = storage->velocity_z[last];
+		storage->size[index] = storage->size[last];
+		storage->size_modifier[index] = storage->size_modifier[last];
+		storage->rotation[index] = storage->rotation[last];
+		storage->rotation_speed[index] = storage->rotation_speed[last];
+		storage->lifetime[index] = storage->lifetime[last];
+		storage->inv_initial_lifetime[index] = storage->inv_initial_lifetime[last];
+		storage->color[index] = storage->color[last];
+		storage->owner[index] = storage->owner[last];
+	}
+}
+
 static void de_particle_system_free(de_node_t* node)
 {
 	de_particle_system_t* particle_system = &node->s.particle_system;
@@ -39,15 +137,20 @@ static void de_particle_system_free(de_node_t* node)
 		de_particle_system_emitter_free(particle_system->emitters.data[i]);
 	}
 	DE_ARRAY_FREE(particle_system->emitters);
-	DE_ARRAY_FREE(particle_system->particles);
-	DE_ARRAY_FREE(particle_system->vertices);
-	DE_ARRAY_FREE(particle_system->indices);
-	DE_ARRAY_FREE(particle_system->free_particles);
+	de_particle_storage_free(&particle_system->particles);
+	DE_ARRAY_FREE(particle_system->instances);
 	DE_ARRAY_FREE(particle_system->sorted_particles);
+	DE_ARRAY_FREE(particle_system->sort_buffer);
 	de_color_gradient_free(&particle_system->color_gradient_over_lifetime);
 	if (particle_system->texture) {
 		de_resource_release(de_resource_from_texture(particle_system->texture));
 	}
+
+	/* Delete buffers, they're created by renderer on first draw */
+	if (particle_system->vertex_array_object) {
+		glDeleteBuffers(1, &particle_system->instance_buffer);
+		glDeleteVertexArrays(1, &particle_system->vertex_array_object);
+	}
 }
 
 static bool de_particle_visit(de_object_visitor_t* visitor, de_particle_t* particle)
@@ -126,106 +229,167 @@ static bool de_particle_system_visit(de_object_visitor_t* visitor, de_node_t* no
 {
 	bool result = true;
 	de_particle_system_t* particle_system = &node->s.particle_system;
-	result &= DE_OBJECT_VISITOR_VISIT_ARRAY(visitor, "Particles", particle_system->particles, de_particle_visit);
+	de_particle_storage_t* storage = &particle_system->particles;
+
+	/* Particles are serialized in array-of-structures form */
+	DE_ARRAY_DECLARE(de_particle_t, particles);
+	DE_ARRAY_INIT(particles);
+	if (!visitor->is_reading) {
+		de_particle_t* particle = DE_ARRAY_GROW(particles, storage->count);
+		for (size_t i = 0; i < storage->count; ++i, ++particle) {
+			particle->owner = storage->owner[i];
+			particle->position = (de_vec3_t) { storage->position_x[i], storage->position_y[i], storage->position_z[i] };
+			particle->velocity = (de_vec3_t) { storage->velocity_x[i], storage->velocity_y[i], storage->velocity_z[i] };
+			particle->size = storage->size[i];
+			particle->alive = true;
+			particle->size_modifier = storage->size_modifier[i];
+			particle->lifetime = storage->lifetime[i];
+			particle->initial_lifetime = 1.0f / storage->inv_initial_lifetime[i];
+			particle->rotation_speed = storage->rotation_speed[i];
+			particle->rotation = storage->rotation[i];
+			memcpy(&particle->color, &storage->color[i], sizeof(particle->color));
+		}
+	}
+	result &= DE_OBJECT_VISITOR_VISIT_ARRAY(visitor, "Particles", particles, de_particle_visit);
+	if (visitor->is_reading) {
+		storage->count = 0;
+		for (size_t k = 0; k < particles.size; ++k) {
+			const de_particle_t* particle = particles.data + k;
+			if (particle->alive) {
+				const size_t i = de_particle_storage_add(storage);
+				storage->owner[i] = particle->owner;
+				storage->position_x[i] = particle->position.x;
+				storage->position_y[i] = particle->position.y;
+				storage->position_z[i] = particle->position.z;
+				storage->velocity_x[i] = particle->velocity.x;
+				storage->velocity_y[i] = particle->velocity.y;
+				storage->velocity_z[i] = particle->velocity.z;
+				storage->size[i] = particle->size;
+				storage->size_modifier[i] = particle->size_modifier;
+				storage->lifetime[i] = particle->lifetime;
+				storage->inv_initial_lifetime[i] = particle->initial_lifetime > 0.0f ? 1.0f / particle->initial_lifetime : FLT_MAX;
+				storage->rotation_speed[i] = particle->rotation_speed;
+				storage->rotation[i] = particle->rotation;
+				storage->color[i] = de_color_to_int(&particle->color);
+			}
+		}
+	}
+	DE_ARRAY_FREE(particles);
+
 	de_resource_t* tex_resource = particle_system->texture ? de_resource_from_texture(particle_system->texture) : NULL;
 	result &= DE_OBJECT_VISITOR_VISIT_POINTER(visitor, "Texture", &tex_resource, de_resource_visit);
 	if (visitor->is_reading && tex_resource) {
 		de_particle_system_set_texture(particle_system, de_resource_to_texture(tex_resource));
 	}
 	result &= DE_OBJECT_VISITOR_VISIT_POINTER_ARRAY(visitor, "Emitters", particle_system->emitters, de_particle_system_emitter_visit);
-	result &= DE_OBJECT_VISITOR_VISIT_PRIMITIVE_ARRAY(visitor, "FreeParticles", particle_system->free_particles);
 	result &= de_color_gradient_visit(visitor, &particle_system->color_gradient_over_lifetime);
+	result &= DE_OBJECT_VISITOR_VISIT_ENUM(visitor, "BlendMode", &particle_system->blend_mode);
 	return result;
 }
 
-static de_particle_t* de_particle_system_spawn_particle(de_particle_system_t* particle_system, de_particle_system_emitter_t* owner)
+static size_t de_particle_system_spawn_particle(de_particle_system_t* particle_system, de_particle_system_emitter_t* owner)
 {
-	de_particle_t* particle;
-	if (particle_system->free_particles.size > 0) {
-		int alive_index = DE_ARRAY_POP(particle_system->free_particles);
-		particle = particle_system->particles.data + alive_index;
-	} else {
-		particle = DE_ARRAY_GROW(particle_system->particles, 1);
-	}
-	particle->owner = owner;
-	particle->alive = true;
+	const size_t index = de_particle_storage_add(&particle_system->particles);
+	particle_system->particles.owner[index] = owner;
 	++owner->alive_particles;
-	return particle;
+	return index;
 }
 
-static void de_particle_system_kill_particle(de_particle_system_t* particle_system, de_particle_t* particle, int index)
+/**
+ * @brief Spawns one particle with random parameters from ranges of emitter. Returns index of particle.
+ */
+static size_t de_particle_system_emitter_spawn(de_particle_system_emitter_t* emitter)
 {
-	DE_ARRAY_APPEND(particle_system->free_particles, index);
-	--particle->owner->alive_particles;
-	particle->alive = false;
-	particle->lifetime = particle->initial_lifetime;
+	de_particle_storage_t* storage = &emitter->particle_system->particles;
+	const size_t i = de_particle_system_spawn_particle(emitter->particle_system, emitter);
+	const float initial_lifetime = de_frand(emitter->min_lifetime, emitter->max_lifetime);
+	const de_color_t white = { 255, 255, 255, 255 };
+	storage->lifetime[i] = 0.0f;
+	storage->inv_initial_lifetime[i] = initial_lifetime > 0.0f ? 1.0f / initial_lifetime : FLT_MAX;
+	storage->color[i] = de_color_to_int(&white);
+	storage->size[i] = de_frand(emitter->min_size, emitter->max_size);
+	storage->size_modifier[i] = de_frand(emitter->min_size_modifier, emitter->max_size_modifier);
+	storage->velocity_x[i] = de_frand(emitter->min_x_velocity, emitter->max_x_velocity);
+	storage->velocity_y[i] = de_frand(emitter->min_y_velocity, emitter->max_y_velocity);
+	storage->velocity_z[i] = de_frand(emitter->min_z_velocity, emitter->max_z_velocity);
+	storage->rotation[i] = de_frand(emitter->min_rotation, emitter->max_rotation);
+	storage->rotation_speed[i] = de_frand(emitter->min_rotation_speed, emitter->max_rotation_speed);
+	/* position defined by emitter type */
+	de_vec3_t position = { 0, 0, 0 };
+	switch (emitter->type) {
+		case DE_PARTICLE_SYSTEM_EMITTER_TYPE_BOX: {
+			de_particle_system_box_emitter_t* box_emitter = &emitter->s.box;
+			position = (de_vec3_t) {
+				.x = emitter->position.x + de_frand(-box_emitter->half_width, box_emitter->half_width),
+				.y = emitter->position.y + de_frand(-box_emitter->half_height, box_emitter->half_height),
+				.z = emitter->position.z + de_frand(-box_emitter->half_depth, box_emitter->half_depth)
+			};
+			break;
+		}
+		case DE_PARTICLE_SYSTEM_EMITTER_TYPE_POINT: {
+			position = (de_vec3_t) { .x = 0, .y = 0, .z = 0 };
+			break;
+		}
+		case DE_PARTICLE_SYSTEM_EMITTER_TYPE_SPHERE: {
+			de_particle_system_sphere_emitter_t* sphere_emitter = &emitter->s.sphere;
+			/* generate random spherical coordinates and convert to cartesian */
+			const float phi = de_frand(0.0f, (float)M_PI);
+			const float theta = de_frand(0.0f, 2.0f * (float)M_PI);
+			const float radius = de_frand(0.0f, sphere_emitter->radius);
+			const float cos_theta = (float)cos(theta);
+			const float sin_theta = (float)sin(theta);
+			const float cos_phi = (float)cos(phi);
+			const float sin_phi = (float)sin(phi);
+			position = (de_vec3_t) {
+				.x = radius * sin_theta * cos_phi,
+				.y = radius * sin_theta * sin_phi,
+				.z = radius * cos_theta
+			};
+			break;
+		}
+		default:
+			break;
+	}
+	storage->position_x[i] = position.x;
+	storage->position_y[i] = position.y;
+	storage->position_z[i] = position.z;
+	return i;
 }
 
-static void de_particle_system_emitter_emit(de_particle_system_emitter_t* emitter, float dt)
+/**
+ * @brief Advances time of emitter and returns amount of particles it should spawn.
+ */
+static int de_particle_system_emitter_get_spawn_count(de_particle_system_emitter_t* emitter, float dt)
 {
 	emitter->time += dt;
 	const float time_amount_per_particle = 1.0f / emitter->particle_spawn_rate; /* in seconds */
 	/* determine how much particles we must spawn per update tick */
 	int particle_count = (int)(emitter->time / time_amount_per_particle);
+	if (particle_count <= 0) {
+		return 0;
+	}
+	/* modify time so we do not lose fraction */
+	emitter->time -= time_amount_per_particle * particle_count;
+	if (emitter->max_particles >= 0) {
+		/* make sure that we do not exceed maximum amount of particles */
+		if (emitter->alive_particles >= emitter->max_particles) {
+			return 0;
+		}
+		if (emitter->alive_particles + particle_count > emitter->max_particles) {
+			particle_count = emitter->max_particles - emitter->alive_particles;
+		}
+	}
+	return particle_count;
+}
+
+static void de_particle_system_emitter_emit(de_particle_system_emitter_t* emitter, float dt)
+{
+	const int particle_count = de_particle_system_emitter_get_spawn_count(emitter, dt);
 	if (particle_count > 0) {
-		/* modify time so we do not lose fraction */
-		emitter->time -= time_amount_per_particle * particle_count;
-		/* spawn particles */
-		if (emitter->max_particles < 0 || emitter->alive_particles < emitter->max_particles) {
-			if (emitter->alive_particles + particle_count > emitter->max_particles) {
-				/* make sure that we do not exceed maximum amount of particles */
-				particle_count = emitter->max_particles - particle_count;
-			}
-			for (int i = 0; i < particle_count; ++i) {
-				de_particle_t* particle = de_particle_system_spawn_particle(emitter->particle_system, emitter);
-				particle->lifetime = 0.0f;
-				particle->initial_lifetime = de_frand(emitter->min_lifetime, emitter->max_lifetime);
-				particle->color = (de_color_t) { 255, 255, 255, 255 };
-				particle->size = de_frand(emitter->min_size, emitter->max_size);
-				particle->size_modifier = de_frand(emitter->min_size_modifier, emitter->max_size_modifier);
-				particle->velocity = (de_vec3_t) {
-					.x = de_frand(emitter->min_x_velocity, emitter->max_x_velocity),
-					.y = de_frand(emitter->min_y_velocity, emitter->max_y_velocity),
-					.z = de_frand(emitter->min_z_velocity, emitter->max_z_velocity)
-				};
-				particle->rotation = de_frand(emitter->min_rotation, emitter->max_rotation);
-				particle->rotation_speed = de_frand(emitter->min_rotation_speed, emitter->max_rotation_speed);
-				/* position defined by emitter type */
-				switch (emitter->type) {
-					case DE_PARTICLE_SYSTEM_EMITTER_TYPE_BOX: {						
-						de_particle_system_box_emitter_t* box_emitter = &emitter->s.box;
-						particle->position = (de_vec3_t) { 
-							.x = emitter->position.x + de_frand(-box_emitter->half_width, box_emitter->half_width),
-							.y = emitter->position.y + de_frand(-box_emitter->half_height, box_emitter->half_height),
-							.z = emitter->position.z + de_frand(-box_emitter->half_depth, box_emitter->half_depth)
-						};								
-						break;
-					}
-					case DE_PARTICLE_SYSTEM_EMITTER_TYPE_POINT: {
-						particle->position = (de_vec3_t) { .x = 0, .y = 0, .z = 0 };
-						break;
-					}
-					case DE_PARTICLE_SYSTEM_EMITTER_TYPE_SPHERE: {
-						de_particle_system_sphere_emitter_t* sphere_emitter = &emitter->s.sphere;
-						/* generate random spherical coordinates and convert to cartesian */
-						const float phi = de_frand(0.0f, (float)M_PI);
-						const float theta = de_frand(0.0f, 2.0f * (float)M_PI);
-						const float radius = de_frand(0.0f, sphere_emitter->radius);
-						const float cos_theta = (float)cos(theta);
-						const float sin_theta = (float)sin(theta);
-						const float cos_phi = (float)cos(phi);
-						const float sin_phi = (float)sin(phi);
-						particle->position = (de_vec3_t) { 
-							.x = radius * sin_theta * cos_phi,
-							.y = radius * sin_theta * sin_phi,
-							.z = radius * cos_theta
-						};
-						break;
-                    default:
-                        break;
-					}
-				}
-			}
+		de_particle_storage_t* storage = &emitter->particle_system->particles;
+		de_particle_storage_reserve(storage, storage->count + particle_count);
+		for (int k = 0; k < particle_count; ++k) {
+			de_particle_system_emitter_spawn(emitter);
 		}
 	}
 }
@@ -240,12 +404,166 @@ de_node_dispatch_table_t* de_particle_system_get_dispatch_table()
 	return &table;
 }
 
-void de_particle_system_update(de_particle_system_t* particle_system, float dt)
+/**
+ * @brief Integrates velocities, positions, sizes, rotations and lifetimes of every alive particle.
+ * Streams are padded to vector width, so tails are processed by full vectors too.
+ */
+static void de_particle_system_integrate(de_particle_storage_t* storage, const de_vec3_t* accel_offset, float dt)
+{
+	const size_t count = storage->count;
+	float* const position_x = storage->position_x;
+	float* const position_y = storage->position_y;
+	float* const position_z = storage->position_z;
+	float* const velocity_x = storage->velocity_x;
+	float* const velocity_y = storage->velocity_y;
+	float* const velocity_z = storage->velocity_z;
+	float* const size = storage->size;
+	const float* const size_modifier = storage->size_modifier;
+	float* const rotation = storage->rotation;
+	const float* const rotation_speed = storage->rotation_speed;
+	float* const lifetime = storage->lifetime;
+#if DE_AVX
+	const __m256 ax = _mm256_set1_ps(accel_offset->x);
+	const __m256 ay = _mm256_set1_ps(accel_offset->y);
+	const __m256 az = _mm256_set1_ps(accel_offset->z);
+	const __m256 vdt = _mm256_set1_ps(dt);
+	for (size_t i = 0; i < count; i += 8) {
+		const __m256 vx = _mm256_add_ps(_mm256_load_ps(velocity_x + i), ax);
+		const __m256 vy = _mm256_add_ps(_mm256_load_ps(velocity_y + i), ay);
+		const __m256 vz = _mm256_add_ps(_mm256_load_ps(velocity_z + i), az);
+		_mm256_store_ps(velocity_x + i, vx);
+		_mm256_store_ps(velocity_y + i, vy);
+		_mm256_store_ps(velocity_z + i, vz);
+		_mm256_store_ps(position_x + i, _mm256_add_ps(_mm256_load_ps(position_x + i), vx));
+		_mm256_store_ps(position_y + i, _mm256_add_ps(_mm256_load_ps(position_y + i), vy));
+		_mm256_store_ps(position_z + i, _mm256_add_ps(_mm256_load_ps(position_z + i), vz));
+		_mm256_store_ps(size + i, _mm256_add_ps(_mm256_load_ps(size + i), _mm256_load_ps(size_modifier + i)));
+		_mm256_store_ps(rotation + i, _mm256_add_ps(_mm256_load_ps(rotation + i), _mm256_load_ps(rotation_speed + i)));
+		_mm256_store_ps(lifetime + i, _mm256_add_ps(_mm256_load_ps(lifetime + i), vdt));
+	}
+#elif DE_SSE
+	const __m128 ax = _mm_set1_ps(accel_offset->x);
+	const __m128 ay = _mm_set1_ps(accel_offset->y);
+	const __m128 az = _mm_set1_ps(accel_offset->z);
+	const __m128 vdt = _mm_set1_ps(dt);
+	for (size_t i = 0; i < count; i += 4) {
+		const __m128 vx = _mm_add_ps(_mm_load_ps(velocity_x + i), ax);
+		const __m128 vy = _mm_add_ps(_mm_load_ps(velocity_y + i), ay);
+		const __m128 vz = _mm_add_ps(_mm_load_ps(velocity_z + i), az);
+		_mm_store_ps(velocity_x + i, vx);
+		_mm_store_ps(velocity_y + i, vy);
+		_mm_store_ps(velocity_z + i, vz);
+		_mm_store_ps(position_x + i, _mm_add_ps(_mm_load_ps(position_x + i), vx));
+		_mm_store_ps(position_y + i, _mm_add_ps(_mm_load_ps(position_y + i), vy));
+		_mm_store_ps(position_z + i, _mm_add_ps(_mm_load_ps(position_z + i), vz));
+		_mm_store_ps(size + i, _mm_add_ps(_mm_load_ps(size + i), _mm_load_ps(size_modifier + i)));
+		_mm_store_ps(rotation + i, _mm_add_ps(_mm_load_ps(rotation + i), _mm_load_ps(rotation_speed + i)));
+		_mm_store_ps(lifetime + i, _mm_add_ps(_mm_load_ps(lifetime + i), vdt));
+	}
+#else
+	for (size_t i = 0; i < count; ++i) {
+		velocity_x[i] += accel_offset->x;
+		velocity_y[i] += accel_offset->y;
+		velocity_z[i] += accel_offset->z;
+		position_x[i] += velocity_x[i];
+		position_y[i] += velocity_y[i];
+		position_z[i] += velocity_z[i];
+		size[i] += size_modifier[i];
+		rotation[i] += rotation_speed[i];
+		lifetime[i] += dt;
+	}
+#endif
+}
+
+/**
+ * @brief Rebuilds color-over-lifetime lookup table if gradient was changed.
+ */
+static void de_particle_system_update_color_lut(de_particle_system_t* particle_system)
+{
+	const de_color_gradient_t* gradient = &particle_system->color_gradient_over_lifetime;
+	if (particle_system->color_lut_valid && particle_system->color_lut_revision == gradient->revision) {
+		return;
+	}
+	for (size_t i = 0; i < DE_PARTICLE_COLOR_LUT_SIZE; ++i) {
+		const de_color_t color = de_color_gradient_get_color(gradient, i / (float)(DE_PARTICLE_COLOR_LUT_SIZE - 1));
+		particle_system->color_lut[i] = de_color_to_int(&color);
+	}
+	particle_system->color_lut_revision = gradient->revision;
+	particle_system->color_lut_valid = true;
+}
+
+/**
+ * @brief Removes dead particles, picks colors of alive ones and recalculates bounds.
+ */
+static void de_particle_system_finalize(de_particle_system_t* particle_system)
+{
+	de_particle_storage_t* storage = &particle_system->particles;
+
+	de_particle_system_update_color_lut(particle_system);
+	const float lut_scale = (float)(DE_PARTICLE_COLOR_LUT_SIZE - 1);
+	de_vec3_t min = { FLT_MAX, FLT_MAX, FLT_MAX };
+	de_vec3_t max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = 0; i < storage->count;) {
+		const float age = storage->lifetime[i] * storage->inv_initial_lifetime[i];
+		if (age >= 1.0f) {
+			--storage->owner[i]->alive_particles;
+			/* Last particle moved in place of dead one, so do not advance */
+			de_particle_storage_remove(storage, i);
+		} else {
+			storage->color[i] = particle_system->color_lut[(size_t)(age * lut_scale)];
+			const float size = storage->size[i];
+			min.x = de_minf(min.x, storage->position_x[i] - size);
+			min.y = de_minf(min.y, storage->position_y[i] - size);
+			min.z = de_minf(min.z, storage->position_z[i] - size);
+			max.x = de_maxf(max.x, storage->position_x[i] + size);
+			max.y = de_maxf(max.y, storage->position_y[i] + size);
+			max.z = de_maxf(max.z, storage->position_z[i] + size);
+			++i;
+		}
+	}
+
+	/* Emitters are part of bounds too, so new particles will not be culled */
+	for (size_t i = 0; i < particle_system->emitters.size; ++i) {
+		const de_particle_system_emitter_t* emitter = particle_system->emitters.data[i];
+		de_vec3_t center = { 0, 0, 0 };
+		de_vec3_t extent = { 0, 0, 0 };
+		switch (emitter->type) {
+			case DE_PARTICLE_SYSTEM_EMITTER_TYPE_BOX:
+				center = emitter->position;
+				extent = (de_vec3_t) { emitter->s.box.half_width, emitter->s.box.half_height, emitter->s.box.half_depth };
+				break;
+			case DE_PARTICLE_SYSTEM_EMITTER_TYPE_SPHERE:
+				extent = (de_vec3_t) { emitter->s.sphere.radius, emitter->s.sphere.radius, emitter->s.sphere.radius };
+				break;
+			default:
+				break;
+		}
+		extent.x += emitter->max_size;
+		extent.y += emitter->max_size;
+		extent.z += emitter->max_size;
+		min.x = de_minf(min.x, center.x - extent.x);
+		min.y = de_minf(min.y, center.y - extent.y);
+		min.z = de_minf(min.z, center.z - extent.z);
+		max.x = de_maxf(max.x, center.x + extent.x);
+		max.y = de_maxf(max.y, center.y + extent.y);
+		max.z = de_maxf(max.z, center.z + extent.z);
+	}
+
+	if (min.x > max.x) {
+		min = max = (de_vec3_t) { 0, 0, 0 };
+	}
+	de_aabb_set(&particle_system->bounds, &min, &max);
+}
+
+/**
+ * @brief Regular simulation step.
+ */
+static void de_particle_system_simulate(de_particle_system_t* particle_system, float dt, float spawn_rate_scale)
 {
 	/* Emit particles first */
 	for (size_t i = 0; i < particle_system->emitters.size; ++i) {
 		de_particle_system_emitter_t* emitter = particle_system->emitters.data[i];
-		de_particle_system_emitter_emit(emitter, dt);
+		de_particle_system_emitter_emit(emitter, dt * spawn_rate_scale);
 	}
 
 	/* Precalculate velocity offset from acceleration */
@@ -253,113 +571,302 @@ void de_particle_system_update(de_particle_system_t* particle_system, float dt)
 	de_vec3_scale(&accel_offset, &particle_system->acceleration, dt * dt);
 
 	/* Then update them */
-	for (size_t i = 0; i < particle_system->particles.size; ++i) {
-		de_particle_t* particle = particle_system->particles.data + i;
-
-		if (particle->alive) {
-			particle->lifetime += dt;
-			if (particle->lifetime >= particle->initial_lifetime) {
-				de_particle_system_kill_particle(particle_system, particle, i);
-			} else {
-				de_vec3_add(&particle->velocity, &particle->velocity, &accel_offset);
-				de_vec3_add(&particle->position, &particle->position, &particle->velocity);				
-				particle->size += particle->size_modifier;
-				particle->color = de_color_gradient_get_color(&particle_system->color_gradient_over_lifetime, particle->lifetime / particle->initial_lifetime);
-				particle->rotation += particle->rotation_speed;
-			}
+	de_particle_system_integrate(&particle_system->particles, &accel_offset, dt);
+
+	de_particle_system_finalize(particle_system);
+}
+
+/**
+ * @brief Moves particle by amount of regular update ticks at once. Velocity changes by same
+ * amount each tick, so result is a sum of arithmetic progression.
+ */
+static void de_particle_system_advance_particle(de_particle_storage_t* storage, size_t i, const de_vec3_t* accel_offset, float ticks)
+{
+	const float progression = ticks * (ticks + 1.0f) * 0.5f;
+	storage->position_x[i] += storage->velocity_x[i] * ticks + accel_offset->x * progression;
+	storage->position_y[i] += storage->velocity_y[i] * ticks + accel_offset->y * progression;
+	storage->position_z[i] += storage->velocity_z[i] * ticks + accel_offset->z * progression;
+	storage->velocity_x[i] += accel_offset->x * ticks;
+	storage->velocity_y[i] += accel_offset->y * ticks;
+	storage->velocity_z[i] += accel_offset->z * ticks;
+	storage->size[i] += storage->size_modifier[i] * ticks;
+	storage->rotation[i] += storage->rotation_speed[i] * ticks;
+}
+
+/**
+ * @brief Coarse simulation step. Advances particle system by given time at once, as if it was
+ * updated by regular steps of tick seconds.
+ *
+ * Existing particles are moved analytically. Emitters spawn only particles which would be still
+ * alive, with ages spread over elapsed time, so particle system looks like it was simulated all
+ * the time.
+ */
+static void de_particle_system_advance(de_particle_system_t* particle_system, float time, float tick, float spawn_rate_scale)
+{
+	de_particle_storage_t* storage = &particle_system->particles;
+
+	if (tick <= 0.0f) {
+		return;
+	}
+
+	de_vec3_t accel_offset;
+	de_vec3_scale(&accel_offset, &particle_system->acceleration, tick * tick);
+
+	const float ticks = time / tick;
+	for (size_t i = 0; i < storage->count; ++i) {
+		storage->lifetime[i] += time;
+		de_particle_system_advance_particle(storage, i, &accel_offset, ticks);
+	}
+
+	for (size_t k = 0; k < particle_system->emitters.size; ++k) {
+		de_particle_system_emitter_t* emitter = particle_system->emitters.data[k];
+		int particle_count = de_particle_system_emitter_get_spawn_count(emitter, time * spawn_rate_scale);
+		if (particle_count <= 0) {
+			continue;
+		}
+
+		/* Only particles emitted during last max_lifetime seconds can be alive */
+		const float window = de_minf(time, emitter->max_lifetime);
+		particle_count = (int)ceilf(particle_count * (window / time));
+
+		de_particle_storage_reserve(storage, storage->count + particle_count);
+		for (int n = 0; n < particle_count; ++n) {
+			const size_t i = de_particle_system_emitter_spawn(emitter);
+			const float age = de_frand(0.0f, window);
+			storage->lifetime[i] = age;
+			de_particle_system_advance_particle(storage, i, &accel_offset, age / tick);
 		}
 	}
+
+	de_particle_system_finalize(particle_system);
+}
+
+void de_particle_system_update(de_particle_system_t* particle_system, float dt)
+{
+	de_particle_system_simulate(particle_system, dt, 1.0f);
+}
+
+bool de_particle_system_is_in_frustum(de_particle_system_t* particle_system, const de_frustum_t* frustum)
+{
+	const de_node_t* node = de_node_from_particle_system(particle_system);
+	return de_frustum_box_intersection_transform(frustum, &particle_system->bounds, &node->global_matrix) != 0;
+}
+
+void de_particle_system_update_lod(de_particle_system_t* particle_system, float dt, const de_node_t* camera, const de_frustum_t* frustum)
+{
+	const de_node_t* node = de_node_from_particle_system(particle_system);
+	const de_particle_system_lod_t* lod = &particle_system->lod;
+	float spawn_rate_scale = 1.0f;
+	bool visible = true;
+
+	if (camera) {
+		if (lod->fade_end_distance > lod->fade_start_distance) {
+			de_vec3_t position, camera_position;
+			de_node_get_global_position(node, &position);
+			de_node_get_global_position(camera, &camera_position);
+			const float distance = de_vec3_distance(&position, &camera_position);
+			const float t = de_clamp((distance - lod->fade_start_distance) / (lod->fade_end_distance - lod->fade_start_distance), 0.0f, 1.0f);
+			spawn_rate_scale = de_lerp(1.0f, lod->min_spawn_rate_scale, t);
+		}
+		visible = node->global_visibility && de_particle_system_is_in_frustum(particle_system, frustum);
+	}
+
+	if (lod->coarse_offscreen && !visible) {
+		particle_system->offscreen_time += dt;
+		if (particle_system->offscreen_time >= lod->offscreen_step) {
+			de_particle_system_advance(particle_system, particle_system->offscreen_time, dt, spawn_rate_scale);
+			particle_system->offscreen_time = 0.0f;
+		}
+		return;
+	}
+
+	/* Catch up when particle system comes back into view */
+	if (particle_system->offscreen_time > 0.0f) {
+		de_particle_system_advance(particle_system, particle_system->offscreen_time, dt, spawn_rate_scale);
+		particle_system->offscreen_time = 0.0f;
+	}
+
+	de_particle_system_simulate(particle_system, dt, spawn_rate_scale);
+}
+
+void de_particle_system_set_lod(de_particle_system_t* particle_system, const de_particle_system_lod_t* lod)
+{
+	particle_system->lod = *lod;
 }
 
-static int de_particle_distance_compare(const void* a, const void* b) 
+/**
+ * @brief Sorts particle keys in ascending order by LSD radix sort with 11-bit digits. Passes
+ * where every key has same digit are skipped.
+ */
+static void de_particle_radix_sort(de_particle_depth_t* data, de_particle_depth_t* buffer, size_t count)
 {
-	const de_particle_t* particle_a = *(de_particle_t**)a;
-	const de_particle_t* particle_b = *(de_particle_t**)b;
-	if(particle_a->sqr_distance_to_camera < particle_b->sqr_distance_to_camera) {
-		return 1;
-	} else if(particle_a->sqr_distance_to_camera > particle_b->sqr_distance_to_camera) {
-		return -1;
+	enum {
+		digit_bits = 11,
+		bucket_count = 1 << digit_bits
+	};
+	uint32_t histograms[3][bucket_count];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; ++i) {
+		const uint32_t key = data[i].key;
+		++histograms[0][key & (bucket_count - 1)];
+		++histograms[1][(key >> digit_bits) & (bucket_count - 1)];
+		++histograms[2][key >> (2 * digit_bits)];
+	}
+
+	de_particle_depth_t* src = data;
+	de_particle_depth_t* dst = buffer;
+	for (int pass = 0; pass < 3; ++pass) {
+		uint32_t* histogram = histograms[pass];
+		const int shift = pass * digit_bits;
+		if (histogram[(src[0].key >> shift) & (bucket_count - 1)] == count) {
+			continue;
+		}
+		uint32_t offset = 0;
+		for (size_t i = 0; i < bucket_count; ++i) {
+			const uint32_t n = histogram[i];
+			histogram[i] = offset;
+			offset += n;
+		}
+		for (size_t i = 0; i < count; ++i) {
+			dst[histogram[(src[i].key >> shift) & (bucket_count - 1)]++] = src[i];
+		}
+		de_particle_depth_t* temp = src;
+		src = dst;
+		dst = temp;
+	}
+
+	if (src != data) {
+		memcpy(data, src, count * sizeof(*data));
 	}
-	return 0;
 }
 
-void de_particle_system_generate_vertices(de_particle_system_t* particle_system, const de_vec3_t* camera_pos)
+/**
+ * @brief Fills array of sorted particles. Particles are ordered back-to-front for alpha
+ * blending, or kept in storage order for additive blending.
+ *
+ * Order of previous frame is used as initial order, so if particles and camera moved a bit
+ * array usually is already sorted or almost sorted. Almost sorted array is fixed by insertion
+ * sort with limited amount of moves, otherwise radix sort is used.
+ */
+static void de_particle_system_sort(de_particle_system_t* particle_system, const de_vec3_t* camera_pos)
 {
+	const de_particle_storage_t* storage = &particle_system->particles;
+	const size_t count = storage->count;
+	const size_t prev_count = particle_system->sorted_particles.size;
+	de_particle_depth_t* sorted;
+
+	if (particle_system->blend_mode != DE_PARTICLE_SYSTEM_BLEND_MODE_ALPHA) {
+		DE_ARRAY_CLEAR(particle_system->sorted_particles);
+		if (count) {
+			sorted = DE_ARRAY_GROW(particle_system->sorted_particles, count);
+			for (size_t i = 0; i < count; ++i) {
+				sorted[i].key = 0;
+				sorted[i].index = (uint32_t)i;
+			}
+		}
+		return;
+	}
+
+	/* Build permutation of [0; count) from order of previous frame: drop indices of removed
+	 * particles, append indices of new ones. */
+	size_t n = 0;
+	for (size_t i = 0; i < prev_count; ++i) {
+		const uint32_t index = particle_system->sorted_particles.data[i].index;
+		if (index < count) {
+			particle_system->sorted_particles.data[n++].index = index;
+		}
+	}
+	particle_system->sorted_particles.size = n;
+	if (count > n) {
+		DE_ARRAY_GROW(particle_system->sorted_particles, count - n);
+		for (size_t i = prev_count < count ? prev_count : count; i < count; ++i) {
+			particle_system->sorted_particles.data[n++].index = (uint32_t)i;
+		}
+	}
+	DE_ASSERT(n == count);
+	if (!count) {
+		return;
+	}
+	sorted = particle_system->sorted_particles.data;
+
+	/* Calculate keys from distances to camera */
 	const de_node_t* node = de_node_from_particle_system(particle_system);
 	de_vec3_t particle_system_global_position;
 	de_node_get_global_position(node, &particle_system_global_position);
+	bool is_sorted = true;
+	for (size_t i = 0; i < count; ++i) {
+		const uint32_t k = sorted[i].index;
+		/* Transform position from local space of particle system to global space
+		 * TODO: For performance reasons now it uses only position of particle system
+		 * node, but ideally it should use global transform of node which also takes
+		 * rotation into account. */
+		const de_vec3_t actual_position = {
+			storage->position_x[k] + particle_system_global_position.x,
+			storage->position_y[k] + particle_system_global_position.y,
+			storage->position_z[k] + particle_system_global_position.z
+		};
+		/* Square distance is non-negative, so its bits have same order as value */
+		const float sqr_distance = de_vec3_sqr_distance(camera_pos, &actual_position);
+		uint32_t bits;
+		memcpy(&bits, &sqr_distance, sizeof(bits));
+		sorted[i].key = ~bits;
+		if (i > 0 && sorted[i - 1].key > sorted[i].key) {
+			is_sorted = false;
+		}
+	}
 
-	/* Step 1. Sort particles back-to-front */
+	if (is_sorted) {
+		return;
+	}
 
-	/* Fill array of pointers to alive particles which we'll sort next. */
-	DE_ARRAY_CLEAR(particle_system->sorted_particles);
-	for (size_t i = 0; i < particle_system->particles.size; ++i) {
-		de_particle_t* particle = particle_system->particles.data + i;
-		if (particle->alive) {			
-			/* Transform position from local space of particle system to global space 
-			 * TODO: For performance reasons now it uses only position of particle system 
-			 * node, but ideally it should use global transform of node which also takes 
-			 * rotation into account. */
-			de_vec3_t actual_position;
-			de_vec3_add(&actual_position, &particle->position, &particle_system_global_position);
-			particle->sqr_distance_to_camera = de_vec3_sqr_distance(camera_pos, &actual_position);
-			DE_ARRAY_APPEND(particle_system->sorted_particles, particle);
+	/* Try insertion sort, it is linear on almost sorted arrays */
+	size_t moves_left = count;
+	size_t i = 1;
+	for (; i < count && moves_left; ++i) {
+		const de_particle_depth_t depth = sorted[i];
+		size_t j = i;
+		while (j > 0 && sorted[j - 1].key > depth.key && moves_left) {
+			sorted[j] = sorted[j - 1];
+			--j;
+			--moves_left;
 		}
+		sorted[j] = depth;
 	}
-	/* Sort from back-to-front using pre-calculated distance to camera. */
-	DE_ARRAY_QSORT(particle_system->sorted_particles, de_particle_distance_compare);
-
-	/* Step 2. Generate vertices */
-	DE_ARRAY_CLEAR(particle_system->indices);
-	DE_ARRAY_CLEAR(particle_system->vertices);
-	for (size_t i = 0; i < particle_system->sorted_particles.size; ++i) {
-		const de_particle_t* particle = particle_system->sorted_particles.data[i];
-
-		const uint32_t packed_color = de_color_to_int(&particle->color);
-
-		/* Prepare quad vertices */
-		de_particle_vertex_t* vertex = DE_ARRAY_GROW(particle_system->vertices, 4);
-		vertex->position = particle->position;
-		vertex->tex_coord = (de_vec2_t) { 0.0f, 0.0f };
-		vertex->size = particle->size;
-		vertex->color = packed_color;
-		vertex->rotation = particle->rotation;
-
-		++vertex;
-		vertex->position = particle->position;
-		vertex->tex_coord = (de_vec2_t) { 1.0f, 0.0f };
-		vertex->size = particle->size;
-		vertex->color = packed_color;
-		vertex->rotation = particle->rotation;
-
-		++vertex;
-		vertex->position = particle->position;
-		vertex->tex_coord = (de_vec2_t) { 1.0f, 1.0f };
-		vertex->size = particle->size;
-		vertex->color = packed_color;
-		vertex->rotation = particle->rotation;
-
-		++vertex;
-		vertex->position = particle->position;
-		vertex->tex_coord = (de_vec2_t) { 0.0f, 1.0f };
-		vertex->size = particle->size;
-		vertex->color = packed_color;
-		vertex->rotation = particle->rotation;
-
-		/* Prepare indices */
-		int* index = DE_ARRAY_GROW(particle_system->indices, 6);
-		const int base_index = i * 4;
-
-		*index = base_index;
-		*(++index) = base_index + 1;
-		*(++index) = base_index + 2;
-
-		*(++index) = base_index;
-		*(++index) = base_index + 2;
-		*(++index) = base_index + 3;
+
+	if (i < count || !moves_left) {
+		DE_ARRAY_CLEAR(particle_system->sort_buffer);
+		DE_ARRAY_GROW(particle_system->sort_buffer, count);
+		de_particle_radix_sort(sorted, particle_system->sort_buffer.data, count);
 	}
 }
 
+void de_particle_system_generate_instances(de_particle_system_t* particle_system, const de_vec3_t* camera_pos)
+{
+	const de_particle_storage_t* storage = &particle_system->particles;
+
+	/* Step 1. Sort particles back-to-front */
+	de_particle_system_sort(particle_system, camera_pos);
+
+	/* Step 2. Generate instances */
+	DE_ARRAY_CLEAR(particle_system->instances);
+	if (!storage->count) {
+		return;
+	}
+	de_particle_instance_t* instance = DE_ARRAY_GROW(particle_system->instances, storage->count);
+	for (size_t i = 0; i < particle_system->sorted_particles.size; ++i, ++instance) {
+		const size_t k = particle_system->sorted_particles.data[i].index;
+		instance->position = (de_vec3_t) { storage->position_x[k], storage->position_y[k], storage->position_z[k] };
+		instance->size = storage->size[k];
+		instance->rotation = storage->rotation[k];
+		instance->color = storage->color[k];
+	}
+}
+
+void de_particle_system_set_blend_mode(de_particle_system_t* particle_system, de_particle_system_blend_mode_t mode)
+{
+	particle_system->blend_mode = mode;
+}
+
 void de_particle_system_set_texture(de_particle_system_t* particle_system, de_texture_t* texture)
 {
 	if (particle_system->texture) {
@@ -19,14 +19,23 @@
 * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
 
-typedef struct de_particle_vertex_t {
+/**
+ * @class de_particle_instance_t
+ * @brief Per-particle data for instanced rendering. Each instance is expanded to a quad
+ * facing camera in vertex shader.
+ */
+typedef struct de_particle_instance_t {
 	de_vec3_t position;	/**< Position of particle. */
-	de_vec2_t tex_coord;
 	float size; /**< Size of particle. */
 	float rotation; /**< Rotation of particle around axis to camera. */
 	uint32_t color; /**< Packed RGBA color. */
-} de_particle_vertex_t;
+} de_particle_instance_t;
 
+/**
+ * @class de_particle_t
+ * @brief Particle in array-of-structures form. Particle system stores particles in
+ * de_particle_storage_t, this structure is used only for serialization.
+ */
 typedef struct de_particle_t {
 	struct de_particle_system_emitter_t* owner;
 	de_vec3_t position;
@@ -39,9 +48,55 @@ typedef struct de_particle_t {
 	float rotation_speed;
 	float rotation;	
 	de_color_t color;
-	float sqr_distance_to_camera; /**< Non-serializable. Valid only for 1 frame. */
 } de_particle_t;
 
+/* Streams of particle storage are aligned and padded to this amount of bytes, so they can be
+ * processed by vectors of any available width without remainder loops. */
+#define DE_PARTICLE_STREAM_ALIGNMENT 32
+
+/* Size of color-over-lifetime lookup table */
+#define DE_PARTICLE_COLOR_LUT_SIZE 256
+
+/**
+ * @class de_particle_storage_t
+ * @brief Particles in structure-of-arrays layout.
+ *
+ * Alive particles are densely packed in [0; count) range of every stream. Dead particle is
+ * removed by moving last alive particle in its place, so order of particles is not preserved.
+ */
+typedef struct de_particle_storage_t {
+	size_t count;    /**< Count of alive particles */
+	size_t capacity; /**< Count of particles that fit in streams */
+	void* memory;    /**< Single memory block which holds every stream */
+	float* position_x;
+	float* position_y;
+	float* position_z;
+	float* velocity_x;
+	float* velocity_y;
+	float* velocity_z;
+	float* size;
+	float* size_modifier;
+	float* rotation;
+	float* rotation_speed;
+	float* lifetime;
+	float* inv_initial_lifetime; /**< 1 / initial lifetime, so normalized age is a product instead of a division */
+	uint32_t* color;             /**< Packed RGBA color */
+	struct de_particle_system_emitter_t** owner;
+} de_particle_storage_t;
+
+/**
+ * @brief Sort key of a particle.
+ */
+typedef struct de_particle_depth_t {
+	uint32_t key;   /**< Bits of square distance to camera, inverted so ascending order is back-to-front */
+	uint32_t index; /**< Index of particle in storage */
+} de_particle_depth_t;
+
+typedef enum de_particle_system_blend_mode_t {
+	DE_PARTICLE_SYSTEM_BLEND_MODE_ALPHA,   /**< Alpha blending, particles are sorted back-to-front */
+	DE_PARTICLE_SYSTEM_BLEND_MODE_ADDITIVE /**< Additive blending, order independent so particles are not sorted */
+} de_particle_system_blend_mode_t;
+
 typedef enum de_particle_system_emitter_type_t {
 	DE_PARTICLE_SYSTEM_EMITTER_TYPE_POINT,
 	DE_PARTICLE_SYSTEM_EMITTER_TYPE_BOX,
@@ -81,18 +136,35 @@ typedef struct de_particle_system_emitter_t {
 	} s;
 } de_particle_system_emitter_t;
 
+/**
+ * @class de_particle_system_lod_t
+ * @brief Level of detail settings of particle system.
+ */
+typedef struct de_particle_system_lod_t {
+	float fade_start_distance;  /**< Distance to camera from which spawn rate starts to decrease */
+	float fade_end_distance;    /**< Distance to camera from which spawn rate is scaled by min_spawn_rate_scale. Spawn rate is not scaled if not greater than fade_start_distance */
+	float min_spawn_rate_scale; /**< Spawn rate multiplier for far particle systems, [0; 1] */
+	bool coarse_offscreen;      /**< Simulate particle system coarsely while it is off-screen */
+	float offscreen_step;       /**< Time step of coarse simulation in seconds */
+} de_particle_system_lod_t;
+
 typedef struct de_particle_system_t {
 	de_vec3_t acceleration; /**< Acceleration for each particle in m/s^2. For gravity use (0.0, -9.81, 0.0), default is (0.0) */
-	DE_ARRAY_DECLARE(de_particle_t, particles);
-	DE_ARRAY_DECLARE(int, free_particles);
+	de_particle_storage_t particles;
 	DE_ARRAY_DECLARE(de_particle_system_emitter_t*, emitters);
-	DE_ARRAY_DECLARE(de_particle_vertex_t, vertices);
-	DE_ARRAY_DECLARE(int, indices);
-	DE_ARRAY_DECLARE(de_particle_t*, sorted_particles); /**< Array of pointers to alive particles sorted in back-to-front order, valid only 1 frame! */
+	DE_ARRAY_DECLARE(de_particle_instance_t, instances); /**< Instances of alive particles in drawing order, valid only 1 frame! */
+	DE_ARRAY_DECLARE(de_particle_depth_t, sorted_particles); /**< Alive particles sorted in back-to-front order, valid only 1 frame! */
+	DE_ARRAY_DECLARE(de_particle_depth_t, sort_buffer);      /**< Private. Temporary buffer for radix sort. */
+	de_particle_system_blend_mode_t blend_mode;
+	de_particle_system_lod_t lod;
+	de_aabb_t bounds;      /**< Local bounds of particles and emitters, updated by simulation. Read-only. */
+	float offscreen_time;  /**< Private. Time which was not simulated yet while particle system was off-screen. */
 	de_color_gradient_t color_gradient_over_lifetime;
+	uint32_t color_lut[DE_PARTICLE_COLOR_LUT_SIZE]; /**< Private. Packed colors of gradient over lifetime sampled with uniform step. */
+	uint32_t color_lut_revision; /**< Private. Revision of gradient from which color_lut was built. */
+	bool color_lut_valid;        /**< Private. */
 	de_texture_t* texture;
-	unsigned int vertex_buffer;
-	unsigned int index_buffer;
+	unsigned int instance_buffer;
 	unsigned int vertex_array_object;
 } de_particle_system_t;
 
@@ -107,9 +179,31 @@ struct de_node_dispatch_table_t* de_particle_system_get_dispatch_table();
 void de_particle_system_update(de_particle_system_t* particle_system, float dt);
 
 /**
- * @brief Internal. Generates vertices and indices for particles for rendering.
+ * @brief Internal. Updates particle system taking into account its level of detail settings.
+ * @param camera camera node to measure distance and visibility, can be NULL
+ * @param frustum frustum of camera, not used if camera is NULL
+ */
+void de_particle_system_update_lod(de_particle_system_t* particle_system, float dt, const de_node_t* camera, const de_frustum_t* frustum);
+
+/**
+ * @brief Returns true if bounds of particle system intersect with frustum.
+ */
+bool de_particle_system_is_in_frustum(de_particle_system_t* particle_system, const de_frustum_t* frustum);
+
+/**
+ * @brief Sets level of detail settings.
+ */
+void de_particle_system_set_lod(de_particle_system_t* particle_system, const de_particle_system_lod_t* lod);
+
+/**
+ * @brief Internal. Generates instances of particles for rendering.
+ */
+void de_particle_system_generate_instances(de_particle_system_t* particle_system, const de_vec3_t* camera_pos);
+
+/**
+ * @brief Sets blend mode of particles. Additive particles are not sorted.
  */
-void de_particle_system_generate_vertices(de_particle_system_t* particle_system, const de_vec3_t* camera_pos);
+void de_particle_system_set_blend_mode(de_particle_system_t* particle_system, de_particle_system_blend_mode_t mode);
 
 /**
  * @brief Sets mask texture for particles. Only Red channel will be used as alpha value.
@@ -30,17 +30,26 @@ de_scene_t* de_scene_create(de_core_t* core)
 
 void de_scene_free(de_scene_t* s)
 {
+	/* free batches, they reference textures of nodes */
+	de_scene_clear_static_batches(s);
+
 /* free nodes */
 	while (s->nodes.head) {
 		de_node_free(s->nodes.head);
 	}
 
-	/* free bodies */
+	/* free bodies, there is no need to keep broadphase up-to-date */
+	if (s->broadphase) {
+		de_broadphase_free(s->broadphase);
+		s->broadphase = NULL;
+	}
 	while (s->bodies.head) {
 		de_body_free(s->bodies.head);
 	}
 
-	/* free geoms */
+	/* free geoms, tree is freed first so it is not rebuilt for every geometry */
+	de_static_geometry_tree_free(s->static_geometry_tree);
+	s->static_geometry_tree = NULL;
 	while (s->static_geometries.head) {
 		de_scene_free_static_geometry(s, s->static_geometries.head);
 	}
@@ -49,6 +58,7 @@ void de_scene_free(de_scene_t* s)
 	while (s->animations.head) {
 		de_animation_free(s->animations.head);
 	}
+	de_animation_pipeline_free(&s->animation_pipeline);
 
 	if (s->core) {
 		DE_LINKED_LIST_REMOVE(s->core->scenes, s);
@@ -64,15 +74,23 @@ de_static_geometry_t* de_scene_create_static_geometry(de_scene_t* s)
 	geom = DE_NEW(de_static_geometry_t);
 	DE_LINKED_LIST_APPEND(s->static_geometries, geom);
 	geom->scene = s;
+	geom->collision_layer = DE_COLLISION_LAYER_DEFAULT;
+	geom->collision_mask = DE_COLLISION_MASK_ALL;
+	geom->tree_index = DE_STATIC_GEOMETRY_NOT_IN_TREE;
 	return geom;
 }
 
 void de_scene_free_static_geometry(de_scene_t* s, de_static_geometry_t* geom)
 {
 	assert(s);
+	de_static_geometry_wake_bodies(geom);
 	DE_LINKED_LIST_REMOVE(s->static_geometries, geom);
+	if (s->static_geometry_tree && geom->tree_index != DE_STATIC_GEOMETRY_NOT_IN_TREE) {
+		de_static_geometry_tree_rebuild(s);
+	}
 	DE_ARRAY_FREE(geom->triangles);
-	de_octree_free(geom->octree);
+	de_bvh_free(geom->bvh);
+	de_free(geom->packs);
 	de_free(geom);
 }
 
@@ -91,6 +109,13 @@ void de_scene_remove_node(de_scene_t* s, de_node_t* node)
 		s->active_camera = NULL;
 	}
 
+	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, s->animations)
+	{
+		if (anim->lod_node == node) {
+			anim->lod_node = NULL;
+		}
+	}
+
 	node->scene = NULL;
 
 	DE_LINKED_LIST_REMOVE(s->nodes, node);
@@ -109,32 +134,19 @@ de_node_t* de_scene_find_node(const de_scene_t* s, const char* name)
 
 void de_scene_update(de_scene_t* s, double dt)
 {
-	/* Animations prepass - reset local transform of associated track nodes for blending */
-	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, s->animations)
-	{
-		if (de_animation_is_flags_set(anim, DE_ANIMATION_FLAG_ENABLED)) {
-			for (size_t i = 0; i < anim->tracks.size; ++i) {
-				de_animation_track_t* track = anim->tracks.data[i];
-				de_node_t* node = track->node;
-				if (node) {
-					node->position = (de_vec3_t) { 0, 0, 0 };
-					node->rotation = (de_quat_t) { 0, 0, 0, 1 };
-					node->scale = (de_vec3_t) { 1, 1, 1 };
-				}
-			}
-		}
-	}
-
-	/* Animation pass */
-	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, s->animations)
-	{
-		de_animation_update(anim, (float)dt);
+	/* Animation pass - sample, blend and write local transforms of animated nodes */
+	de_animation_pipeline_update(&s->animation_pipeline, s, (float)dt);
+
+	/* Particle systems pass - camera of previous frame is used for level of detail */
+	const de_node_t* camera = s->active_camera;
+	de_frustum_t frustum;
+	if (camera) {
+		de_frustum_from_matrix(&frustum, &camera->s.camera.view_projection_matrix);
 	}
-
 	DE_LINKED_LIST_FOR_EACH_T(de_node_t*, node, s->nodes)
 	{
 		if (node->type == DE_NODE_TYPE_PARTICLE_SYSTEM) {
-			de_particle_system_update(de_node_to_particle_system(node), (float)dt);
+			de_particle_system_update_lod(de_node_to_particle_system(node), (float)dt, camera, &frustum);
 		}
 	}
 
@@ -183,6 +195,13 @@ bool de_scene_visit(de_object_visitor_t* visitor, de_scene_t* scene)
 		}
 	}
 	result &= DE_OBJECT_VISITOR_VISIT_INTRUSIVE_LINKED_LIST(visitor, "Bodies", scene->bodies, de_body_t, de_body_visit);
+	if (visitor->is_reading) {
+		/* register loaded bodies in broadphase in order of list */
+		DE_LINKED_LIST_FOR_EACH_T(de_body_t*, body, scene->bodies)
+		{
+			de_body_update_broadphase(body);
+		}
+	}
 	result &= DE_OBJECT_VISITOR_VISIT_INTRUSIVE_LINKED_LIST(visitor, "Animations", scene->animations, de_animation_t, de_animation_visit);
 	if (visitor->is_reading) {
 		/* resolve animations */
@@ -26,7 +26,11 @@ struct de_scene_t {
 	DE_LINKED_LIST_DECLARE(de_body_t, bodies);
 	DE_LINKED_LIST_DECLARE(de_static_geometry_t, static_geometries);
 	DE_LINKED_LIST_DECLARE(de_animation_t, animations);
+	DE_LINKED_LIST_DECLARE(de_static_batch_t, static_batches);
+	de_broadphase_t* broadphase; /**< Private. Broadphase for bodies, created on demand. */
+	de_static_geometry_tree_t* static_geometry_tree; /**< Private. Top-level tree over static geometries, created on demand. */
 	de_node_t* active_camera;
+	de_animation_pipeline_t animation_pipeline;
 	DE_LINKED_LIST_ITEM(de_scene_t);
 };
 
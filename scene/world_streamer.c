@@ -0,0 +1,412 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+typedef struct de_world_load_job_t {
+	de_world_cell_t* cell;
+	uint32_t model;
+} de_world_load_job_t;
+
+typedef struct de_world_cell_candidate_t {
+	de_world_cell_t* cell;
+	float distance;
+} de_world_cell_candidate_t;
+
+struct de_world_streamer_t {
+	de_scene_t* scene;
+	de_world_streamer_config_t config;
+	DE_ARRAY_DECLARE(de_world_cell_t*, cells);
+	DE_ARRAY_DECLARE(de_world_cell_candidate_t, candidates); /**< Cells that should be loaded, reused between updates */
+	DE_ARRAY_DECLARE(de_thrd_t, threads);
+	de_mtx_t mutex;
+	de_cnd_t job_cnd; /**< Signalled when new jobs are added or streamer is shutting down */
+	DE_ARRAY_DECLARE(de_world_load_job_t, jobs); /**< Queue of parse jobs. Guarded by mutex */
+	bool shutdown;
+};
+
+static int de_world_streamer_loader(void* arg)
+{
+	de_world_streamer_t* streamer = (de_world_streamer_t*)arg;
+
+	de_mtx_lock(&streamer->mutex);
+	for (;;) {
+		while (!streamer->shutdown && !streamer->jobs.size) {
+			de_cnd_wait(&streamer->job_cnd, &streamer->mutex);
+		}
+		if (streamer->shutdown) {
+			break;
+		}
+		de_world_load_job_t job = streamer->jobs.data[0];
+		DE_ARRAY_REMOVE_AT(streamer->jobs, 0);
+		/* Models array of cell is not modified while cell is loading, so it is safe to
+		 * access it without lock. */
+		de_world_cell_model_t* model = &job.cell->models.data[job.model];
+		de_mtx_unlock(&streamer->mutex);
+
+		de_fbx_t* fbx = de_fbx_load_file(de_path_cstr(&model->path));
+
+		de_mtx_lock(&streamer->mutex);
+		model->fbx = fbx;
+		--job.cell->pending_jobs;
+	}
+	de_mtx_unlock(&streamer->mutex);
+
+	return 0;
+}
+
+de_world_streamer_t* de_world_streamer_create(de_scene_t* scene, const de_world_streamer_config_t* config)
+{
+	DE_ASSERT(scene);
+	DE_ASSERT(config);
+	DE_ASSERT(config->unload_radius >= config->load_radius);
+	de_world_streamer_t* streamer = DE_NEW(de_world_streamer_t);
+	streamer->scene = scene;
+	streamer->config = *config;
+	de_mtx_init(&streamer->mutex);
+	de_cnd_init(&streamer->job_cnd);
+	const size_t thread_count = config->loader_thread_count ? config->loader_thread_count : 1;
+	DE_ARRAY_GROW(streamer->threads, thread_count);
+	for (size_t i = 0; i < thread_count; ++i) {
+		de_thrd_create(&streamer->threads.data[i], de_world_streamer_loader, streamer);
+	}
+	return streamer;
+}
+
+static void de_world_cell_unload(de_world_cell_t* cell)
+{
+	de_scene_t* scene = cell->streamer->scene;
+	for (size_t i = 0; i < cell->static_geometries.size; ++i) {
+		de_scene_free_static_geometry(scene, cell->static_geometries.data[i]);
+	}
+	DE_ARRAY_CLEAR(cell->static_geometries);
+	for (size_t i = 0; i < cell->instances.size; ++i) {
+		de_world_instance_t* inst = &cell->instances.data[i];
+		if (inst->node) {
+			de_model_instance_free(inst->node);
+			inst->node = NULL;
+		}
+	}
+	/* Release models after instances, so last release will free resource */
+	for (size_t i = 0; i < cell->models.size; ++i) {
+		de_world_cell_model_t* model = &cell->models.data[i];
+		if (model->fbx) {
+			de_fbx_free(model->fbx);
+			model->fbx = NULL;
+		}
+		if (model->resource) {
+			de_resource_release(model->resource);
+			model->resource = NULL;
+		}
+	}
+	cell->integrated = 0;
+	cell->cancelled = false;
+	cell->state = DE_WORLD_CELL_STATE_UNLOADED;
+}
+
+void de_world_streamer_free(de_world_streamer_t* streamer)
+{
+	DE_ASSERT(streamer);
+	de_mtx_lock(&streamer->mutex);
+	streamer->shutdown = true;
+	de_cnd_broadcast(&streamer->job_cnd);
+	de_mtx_unlock(&streamer->mutex);
+	for (size_t i = 0; i < streamer->threads.size; ++i) {
+		de_thrd_join(&streamer->threads.data[i]);
+	}
+	/* Loader threads are stopped, so queued jobs can be just dropped */
+	for (size_t i = 0; i < streamer->cells.size; ++i) {
+		de_world_cell_t* cell = streamer->cells.data[i];
+		de_world_cell_unload(cell);
+		for (size_t k = 0; k < cell->models.size; ++k) {
+			de_path_free(&cell->models.data[k].path);
+		}
+		DE_ARRAY_FREE(cell->models);
+		DE_ARRAY_FREE(cell->instances);
+		DE_ARRAY_FREE(cell->static_geometries);
+		de_free(cell);
+	}
+	DE_ARRAY_FREE(streamer->cells);
+	DE_ARRAY_FREE(streamer->candidates);
+	DE_ARRAY_FREE(streamer->jobs);
+	DE_ARRAY_FREE(streamer->threads);
+	de_cnd_destroy(&streamer->job_cnd);
+	de_mtx_destroy(&streamer->mutex);
+	de_free(streamer);
+}
+
+de_world_cell_t* de_world_streamer_add_cell(de_world_streamer_t* streamer, const de_vec3_t* min, const de_vec3_t* max)
+{
+	DE_ASSERT(streamer);
+	DE_ASSERT(min);
+	DE_ASSERT(max);
+	de_world_cell_t* cell = DE_NEW(de_world_cell_t);
+	cell->streamer = streamer;
+	cell->min = *min;
+	cell->max = *max;
+	cell->state = DE_WORLD_CELL_STATE_UNLOADED;
+	DE_ARRAY_APPEND(streamer->cells, cell);
+	return cell;
+}
+
+size_t de_world_cell_add_instance(de_world_cell_t* cell, const char* model_path, const de_vec3_t* position,
+	const de_quat_t* rotation, const de_vec3_t* scale, uint32_t flags)
+{
+	DE_ASSERT(cell);
+	DE_ASSERT(model_path);
+	/* Loader threads access models array without lock */
+	DE_ASSERT(cell->state == DE_WORLD_CELL_STATE_UNLOADED);
+
+	de_path_t path;
+	de_path_from_cstr_as_view(&path, model_path);
+
+	uint32_t model_index;
+	for (model_index = 0; model_index < cell->models.size; ++model_index) {
+		if (de_path_eq(&cell->models.data[model_index].path, &path)) {
+			break;
+		}
+	}
+	if (model_index == cell->models.size) {
+		de_world_cell_model_t* model = DE_ARRAY_GROW(cell->models, 1);
+		de_path_init(&model->path);
+		de_path_copy(&path, &model->path);
+		model->resource = NULL;
+		model->fbx = NULL;
+	}
+
+	de_world_instance_t* inst = DE_ARRAY_GROW(cell->instances, 1);
+	inst->model = model_index;
+	inst->position = position ? *position : (de_vec3_t) { 0, 0, 0 };
+	inst->rotation = rotation ? *rotation : (de_quat_t) { 0, 0, 0, 1 };
+	inst->scale = scale ? *scale : (de_vec3_t) { 1, 1, 1 };
+	inst->flags = flags;
+	inst->node = NULL;
+	return cell->instances.size - 1;
+}
+
+de_world_cell_state_t de_world_cell_get_state(de_world_cell_t* cell)
+{
+	DE_ASSERT(cell);
+	return cell->state;
+}
+
+static float de_world_cell_distance(const de_world_cell_t* cell, const de_vec3_t* p)
+{
+	const float dx = de_maxf(de_maxf(cell->min.x - p->x, p->x - cell->max.x), 0.0f);
+	const float dy = de_maxf(de_maxf(cell->min.y - p->y, p->y - cell->max.y), 0.0f);
+	const float dz = de_maxf(de_maxf(cell->min.z - p->z, p->z - cell->max.z), 0.0f);
+	return (float)sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+static void de_world_cell_request_load(de_world_cell_t* cell)
+{
+	de_world_streamer_t* streamer = cell->streamer;
+	de_core_t* core = streamer->scene->core;
+
+	/* Models that are already loaded are just referenced, others are parsed on loader threads */
+	de_mtx_lock(&streamer->mutex);
+	for (uint32_t i = 0; i < cell->models.size; ++i) {
+		de_world_cell_model_t* model = &cell->models.data[i];
+		model->resource = de_core_find_resource_of_type(core, DE_RESOURCE_TYPE_MODEL, &model->path);
+		if (model->resource) {
+			de_resource_add_ref(model->resource);
+		} else {
+			de_world_load_job_t job = { cell, i };
+			DE_ARRAY_APPEND(streamer->jobs, job);
+			++cell->pending_jobs;
+		}
+	}
+	if (cell->pending_jobs) {
+		cell->state = DE_WORLD_CELL_STATE_LOADING;
+		de_cnd_broadcast(&streamer->job_cnd);
+	} else {
+		cell->state = DE_WORLD_CELL_STATE_INTEGRATING;
+	}
+	de_mtx_unlock(&streamer->mutex);
+}
+
+/**
+ * @brief Removes queued jobs of cell. Jobs that are already running will be finished.
+ * Returns amount of unfinished jobs.
+ */
+static size_t de_world_cell_cancel_load(de_world_cell_t* cell)
+{
+	de_world_streamer_t* streamer = cell->streamer;
+	de_mtx_lock(&streamer->mutex);
+	for (size_t i = streamer->jobs.size; i-- > 0; ) {
+		if (streamer->jobs.data[i].cell == cell) {
+			DE_ARRAY_REMOVE_AT(streamer->jobs, i);
+			--cell->pending_jobs;
+		}
+	}
+	const size_t pending = cell->pending_jobs;
+	de_mtx_unlock(&streamer->mutex);
+	cell->cancelled = true;
+	return pending;
+}
+
+static void de_world_cell_build_static_geometry(de_world_cell_t* cell, de_node_t* node)
+{
+	if (node->type == DE_NODE_TYPE_MESH) {
+		de_static_geometry_t* geom = de_scene_create_static_geometry(cell->streamer->scene);
+		de_static_geometry_fill(geom, de_node_to_mesh(node), node->global_matrix);
+		DE_ARRAY_APPEND(cell->static_geometries, geom);
+	}
+	for (size_t i = 0; i < node->children.size; ++i) {
+		de_world_cell_build_static_geometry(cell, node->children.data[i]);
+	}
+}
+
+static void de_world_instance_spawn(de_world_cell_t* cell, de_world_instance_t* inst)
+{
+	de_resource_t* res = cell->models.data[inst->model].resource;
+	if (!res) {
+		return;
+	}
+	inst->node = de_model_instantiate(de_resource_to_model(res), cell->streamer->scene);
+	if (!inst->node) {
+		return;
+	}
+	de_node_set_local_position(inst->node, &inst->position);
+	de_node_set_local_rotation(inst->node, &inst->rotation);
+	de_node_set_local_scale(inst->node, &inst->scale);
+	if (inst->flags & DE_WORLD_INSTANCE_FLAGS_STATIC_GEOMETRY) {
+		de_node_calculate_transforms_descending(inst->node);
+		de_world_cell_build_static_geometry(cell, inst->node);
+	}
+}
+
+/**
+ * @brief Performs one step of integration: converts one parsed model into resource or
+ * spawns one instance. Returns true when cell is fully integrated.
+ */
+static bool de_world_cell_integrate_step(de_world_cell_t* cell)
+{
+	if (cell->integrated < cell->models.size) {
+		de_world_cell_model_t* model = &cell->models.data[cell->integrated];
+		if (model->fbx) {
+			/* Other cell could load same model in the meantime, then it will be reused */
+			model->resource = de_model_create_from_fbx(cell->streamer->scene->core, &model->path, model->fbx);
+			if (model->resource) {
+				de_resource_add_ref(model->resource);
+			}
+			de_fbx_free(model->fbx);
+			model->fbx = NULL;
+		}
+		if (!model->resource) {
+			de_log("world streamer: unable to load model %s", de_path_cstr(&model->path));
+		}
+	} else {
+		de_world_instance_spawn(cell, &cell->instances.data[cell->integrated - cell->models.size]);
+	}
+	++cell->integrated;
+	return cell->integrated >= cell->models.size + cell->instances.size;
+}
+
+static int de_world_cell_candidate_compare(const void* a, const void* b)
+{
+	const float da = ((const de_world_cell_candidate_t*)a)->distance;
+	const float db = ((const de_world_cell_candidate_t*)b)->distance;
+	return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+void de_world_streamer_update(de_world_streamer_t* streamer, const de_vec3_t* observer)
+{
+	DE_ASSERT(streamer);
+
+	de_vec3_t position;
+	if (observer) {
+		position = *observer;
+	} else if (streamer->scene->active_camera) {
+		de_node_get_global_position(streamer->scene->active_camera, &position);
+	} else {
+		return;
+	}
+
+	DE_ARRAY_CLEAR(streamer->candidates);
+	for (size_t i = 0; i < streamer->cells.size; ++i) {
+		de_world_cell_t* cell = streamer->cells.data[i];
+		const float distance = de_world_cell_distance(cell, &position);
+		switch (cell->state) {
+			case DE_WORLD_CELL_STATE_UNLOADED:
+				if (distance <= streamer->config.load_radius) {
+					de_world_cell_candidate_t candidate = { cell, distance };
+					DE_ARRAY_APPEND(streamer->candidates, candidate);
+				}
+				break;
+			case DE_WORLD_CELL_STATE_LOADING: {
+				de_mtx_lock(&streamer->mutex);
+				size_t pending = cell->pending_jobs;
+				de_mtx_unlock(&streamer->mutex);
+				if (!cell->cancelled && distance > streamer->config.unload_radius) {
+					pending = de_world_cell_cancel_load(cell);
+				}
+				if (!pending) {
+					if (cell->cancelled) {
+						de_world_cell_unload(cell);
+					} else {
+						cell->state = DE_WORLD_CELL_STATE_INTEGRATING;
+					}
+				}
+				break;
+			}
+			case DE_WORLD_CELL_STATE_INTEGRATING:
+			case DE_WORLD_CELL_STATE_RESIDENT:
+				if (distance > streamer->config.unload_radius) {
+					de_world_cell_unload(cell);
+				}
+				break;
+		}
+	}
+
+	/* Nearest cells are queued first */
+	DE_ARRAY_QSORT(streamer->candidates, de_world_cell_candidate_compare);
+	for (size_t i = 0; i < streamer->candidates.size; ++i) {
+		de_world_cell_request_load(streamer->candidates.data[i].cell);
+	}
+
+	/* Integrate cells within time budget, at least one step is done per update so
+	 * integration will progress even with tiny budget. */
+	const double start_time = de_time_get_seconds();
+	bool any_step = false;
+	for (size_t i = 0; i < streamer->cells.size; ++i) {
+		de_world_cell_t* cell = streamer->cells.data[i];
+		while (cell->state == DE_WORLD_CELL_STATE_INTEGRATING) {
+			if (any_step && de_time_get_seconds() - start_time >= streamer->config.integration_budget) {
+				return;
+			}
+			if (de_world_cell_integrate_step(cell)) {
+				cell->state = DE_WORLD_CELL_STATE_RESIDENT;
+			}
+			any_step = true;
+		}
+	}
+}
+
+size_t de_world_streamer_get_cell_count(de_world_streamer_t* streamer, de_world_cell_state_t state)
+{
+	DE_ASSERT(streamer);
+	size_t count = 0;
+	for (size_t i = 0; i < streamer->cells.size; ++i) {
+		if (streamer->cells.data[i]->state == state) {
+			++count;
+		}
+	}
+	return count;
+}
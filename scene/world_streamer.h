@@ -0,0 +1,133 @@
+/* Copyright (c) 2017-2019 Dmitry Stepanov a.k.a mr.DIMAS
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be
+* included in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+* LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+* OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+* WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. */
+
+/**
+ * World streaming.
+ *
+ * Splits a big world into cells, each cell is a set of model instances placed in world.
+ * Cells are loaded when observer (normally active camera) comes closer than load radius
+ * and unloaded when it goes farther than unload radius, so only nearby part of world is
+ * kept in memory.
+ *
+ * Loading is done in two stages:
+ * 1) Model files which are not loaded yet are parsed on loader threads.
+ * 2) Parsed models are converted into resources, instantiated and static geometry is
+ *    built on main thread in de_world_streamer_update. This stage is split into small
+ *    steps and limited by time budget per frame, so there is no long hitches.
+ *
+ * Model resources are shared between cells, and released when last cell which uses
+ * them is unloaded.
+ */
+
+typedef struct de_world_streamer_t de_world_streamer_t;
+
+typedef enum de_world_cell_state_t {
+	DE_WORLD_CELL_STATE_UNLOADED,
+	DE_WORLD_CELL_STATE_LOADING,     /**< Model files are being parsed on loader threads */
+	DE_WORLD_CELL_STATE_INTEGRATING, /**< Nodes are being added to scene on main thread */
+	DE_WORLD_CELL_STATE_RESIDENT,    /**< Every instance of cell is in scene */
+} de_world_cell_state_t;
+
+typedef enum de_world_instance_flags_t {
+	/** Static collision geometry will be built from each mesh of instance */
+	DE_WORLD_INSTANCE_FLAGS_STATIC_GEOMETRY = DE_BIT(0),
+} de_world_instance_flags_t;
+
+/**
+ * @brief Model used by cell.
+ */
+typedef struct de_world_cell_model_t {
+	de_path_t path;
+	de_resource_t* resource; /**< Private. Referenced while cell is loaded */
+	de_fbx_t* fbx;           /**< Private. Parsed on loader thread, but not yet converted into resource */
+} de_world_cell_model_t;
+
+/**
+ * @brief Model instance placed in world.
+ */
+typedef struct de_world_instance_t {
+	uint32_t model; /**< Index of model in cell */
+	de_vec3_t position;
+	de_quat_t rotation;
+	de_vec3_t scale;
+	uint32_t flags; /**< Combination of de_world_instance_flags_t */
+	de_node_t* node; /**< Root of instance, NULL when instance is not in scene */
+} de_world_instance_t;
+
+typedef struct de_world_cell_t {
+	de_world_streamer_t* streamer;
+	de_vec3_t min;
+	de_vec3_t max;
+	de_world_cell_state_t state;
+	DE_ARRAY_DECLARE(de_world_cell_model_t, models);
+	DE_ARRAY_DECLARE(de_world_instance_t, instances);
+	DE_ARRAY_DECLARE(de_static_geometry_t*, static_geometries); /**< Private. Geometry built for instances */
+	size_t pending_jobs;    /**< Private. Amount of unfinished parse jobs. Guarded by streamer mutex */
+	size_t integrated;      /**< Private. Amount of finished integration steps */
+	bool cancelled;         /**< Private. Cell left unload radius while loading */
+} de_world_cell_t;
+
+typedef struct de_world_streamer_config_t {
+	float load_radius;           /**< Cells closer than this distance to observer are loaded */
+	float unload_radius;         /**< Cells farther than this distance to observer are unloaded. Must be >= load radius */
+	double integration_budget;   /**< Time in seconds per update that can be spent on integration */
+	size_t loader_thread_count;  /**< Amount of threads that parse model files. Zero means one */
+} de_world_streamer_config_t;
+
+/**
+ * @brief Creates streamer which will put cells into specified scene and starts loader threads.
+ */
+de_world_streamer_t* de_world_streamer_create(de_scene_t* scene, const de_world_streamer_config_t* config);
+
+/**
+ * @brief Stops loader threads, unloads every cell and frees streamer.
+ */
+void de_world_streamer_free(de_world_streamer_t* streamer);
+
+/**
+ * @brief Adds new empty cell with specified bounds.
+ */
+de_world_cell_t* de_world_streamer_add_cell(de_world_streamer_t* streamer, const de_vec3_t* min, const de_vec3_t* max);
+
+/**
+ * @brief Adds model instance to cell. Cell must be unloaded.
+ * @param flags combination of de_world_instance_flags_t
+ * @return index of instance in cell
+ */
+size_t de_world_cell_add_instance(de_world_cell_t* cell, const char* model_path, const de_vec3_t* position,
+	const de_quat_t* rotation, const de_vec3_t* scale, uint32_t flags);
+
+/**
+ * @brief Returns current state of cell.
+ */
+de_world_cell_state_t de_world_cell_get_state(de_world_cell_t* cell);
+
+/**
+ * @brief Loads and unloads cells according to observer position and integrates loaded cells
+ * into scene. Must be called every frame from main thread.
+ * @param observer position of observer, if NULL position of active camera of scene is used.
+ */
+void de_world_streamer_update(de_world_streamer_t* streamer, const de_vec3_t* observer);
+
+/**
+ * @brief Returns amount of cells in specified state.
+ */
+size_t de_world_streamer_get_cell_count(de_world_streamer_t* streamer, de_world_cell_state_t state);
@@ -0,0 +1,103 @@
+#include "de_main.h"
+
+#define BODY_COUNT (10000)
+#define GROUND_SIZE (120)
+#define ITERATION_COUNT (1000)
+
+/* Takes snapshot into new buffer, size of snapshot changes with count of contacts. */
+static void* take_snapshot(de_scene_t* scene, size_t* size)
+{
+	*size = de_physics_get_snapshot_size(scene);
+	void* buffer = malloc(*size);
+	de_physics_save_snapshot(scene, buffer, *size);
+	return buffer;
+}
+
+static void simulate(de_core_t* core, int step_count)
+{
+	for (int i = 0; i < step_count; ++i) {
+		de_physics_step(core, 1.0 / 60.0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	(void)argc;
+	(void)argv;
+
+	/* Fill config using designated initializer. */
+	const de_core_config_t config = {
+		.video_mode = {
+			.width = 800,
+			.height = 600,
+		}
+	};
+
+	/* Initialize core. */
+	de_core_t* core = de_core_init(&config);
+
+	de_scene_t* scene = de_scene_create(core);
+
+	/* Flat ground made of quads. */
+	de_static_geometry_t* ground = de_scene_create_static_geometry(scene);
+	for (int x = 0; x < GROUND_SIZE; ++x) {
+		for (int z = 0; z < GROUND_SIZE; ++z) {
+			const de_vec3_t a = { (float)x, 0.0f, (float)z };
+			const de_vec3_t b = { (float)x + 1.0f, 0.0f, (float)z };
+			const de_vec3_t c = { (float)x + 1.0f, 0.0f, (float)z + 1.0f };
+			const de_vec3_t d = { (float)x, 0.0f, (float)z + 1.0f };
+			de_static_geometry_add_triangle(ground, &a, &c, &b);
+			de_static_geometry_add_triangle(ground, &a, &d, &c);
+		}
+	}
+	de_static_geometry_build(ground);
+
+	/* Bodies dropped from different heights, some of them fall asleep quickly. */
+	srand(4);
+	for (int i = 0; i < BODY_COUNT; ++i) {
+		de_body_t* body = de_body_create(scene);
+		const de_vec3_t position = { 1.0f + (i % 100) * 1.15f, 1.0f + (rand() % 30) / 10.0f, 1.0f + (i / 100) * 1.15f };
+		de_body_set_position(body, &position);
+		de_body_set_radius(body, 0.5f);
+	}
+	simulate(core, 120);
+
+	/* Round trip: simulation continued from restored snapshot must produce the same state. */
+	size_t start_size;
+	void* start = take_snapshot(scene, &start_size);
+	simulate(core, 60);
+	size_t expected_size;
+	void* expected = take_snapshot(scene, &expected_size);
+	if (!de_physics_load_snapshot(scene, start, start_size)) {
+		de_fatal_error("snapshot was rejected");
+	}
+	simulate(core, 60);
+	size_t actual_size;
+	void* actual = take_snapshot(scene, &actual_size);
+	const bool identical = expected_size == actual_size && memcmp(expected, actual, actual_size) == 0;
+	printf("%d bodies, %d sleeping, snapshot is %d bytes, round trip is %s\n", BODY_COUNT,
+		(int)de_physics_get_sleeping_body_count(scene), (int)actual_size, identical ? "bit-identical" : "DIFFERENT");
+
+	/* Throughput, buffer is reused so nothing is allocated. */
+	double time = de_time_get_seconds();
+	for (int i = 0; i < ITERATION_COUNT; ++i) {
+		de_physics_save_snapshot(scene, actual, actual_size);
+	}
+	const double save_time = de_time_get_seconds() - time;
+	time = de_time_get_seconds();
+	for (int i = 0; i < ITERATION_COUNT; ++i) {
+		de_physics_load_snapshot(scene, actual, actual_size);
+	}
+	const double load_time = de_time_get_seconds() - time;
+	printf("save: %.0f snapshots per second\n", ITERATION_COUNT / save_time);
+	printf("load: %.0f snapshots per second\n", ITERATION_COUNT / load_time);
+
+	free(start);
+	free(expected);
+	free(actual);
+
+	/* Cleanup. */
+	de_core_shutdown(core);
+
+	return identical ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+#include "de_main.h"
+#include "octree.h"
+
+/* Side of terrain in quads, clutter adds half as many triangles on top */
+#define TERRAIN_SIZE (300)
+#define SPHERE_QUERY_COUNT (100000)
+#define RAY_QUERY_COUNT (20000)
+#define OCTREE_TRIANGLES_PER_NODE (64)
+#define BVH_TRIANGLES_PER_LEAF (8)
+
+typedef struct triangle_t {
+	de_vec3_t a;
+	de_vec3_t b;
+	de_vec3_t c;
+} triangle_t;
+
+static float random_float(float max)
+{
+	return max * (rand() % 1000) / 1000.0f;
+}
+
+/* Bumpy terrain plus randomly scattered small triangles, similar to level geometry. */
+static triangle_t* make_triangles(size_t* count)
+{
+	const size_t quad_count = TERRAIN_SIZE * TERRAIN_SIZE;
+	triangle_t* triangles = malloc((2 * quad_count + quad_count / 2) * sizeof(*triangles));
+	size_t n = 0;
+	for (int x = 0; x < TERRAIN_SIZE; ++x) {
+		for (int z = 0; z < TERRAIN_SIZE; ++z) {
+			const de_vec3_t a = { (float)x, random_float(1.0f), (float)z };
+			const de_vec3_t b = { (float)x + 1.0f, random_float(1.0f), (float)z };
+			const de_vec3_t c = { (float)x + 1.0f, random_float(1.0f), (float)z + 1.0f };
+			const de_vec3_t d = { (float)x, random_float(1.0f), (float)z + 1.0f };
+			triangles[n].a = a;
+			triangles[n].b = b;
+			triangles[n].c = c;
+			++n;
+			triangles[n].a = a;
+			triangles[n].b = c;
+			triangles[n].c = d;
+			++n;
+		}
+	}
+	for (size_t i = 0; i < quad_count / 2; ++i) {
+		const de_vec3_t a = { random_float(TERRAIN_SIZE), random_float(5.0f), random_float(TERRAIN_SIZE) };
+		triangles[n].a = a;
+		triangles[n].b = a;
+		triangles[n].b.x += 0.5f;
+		triangles[n].c = a;
+		triangles[n].c.y += 0.7f;
+		triangles[n].c.z += 0.2f;
+		++n;
+	}
+	*count = n;
+	return triangles;
+}
+
+/* Exact enough for comparison of structures: bounds of triangle intersect sphere. */
+static bool triangle_touches_sphere(const triangle_t* t, const de_vec3_t* position, float radius)
+{
+	de_vec3_t min = t->a, max = t->a;
+	de_vec3_min_max(&t->b, &min, &max);
+	de_vec3_min_max(&t->c, &min, &max);
+	float sqr_distance = 0.0f;
+	const float p[3] = { position->x, position->y, position->z };
+	const float lo[3] = { min.x, min.y, min.z };
+	const float hi[3] = { max.x, max.y, max.z };
+	for (int i = 0; i < 3; ++i) {
+		if (p[i] < lo[i]) {
+			sqr_distance += (lo[i] - p[i]) * (lo[i] - p[i]);
+		} else if (p[i] > hi[i]) {
+			sqr_distance += (p[i] - hi[i]) * (p[i] - hi[i]);
+		}
+	}
+	return sqr_distance <= radius * radius;
+}
+
+static void test_ray(const triangle_t* t, const de_ray_t* ray, float* closest)
+{
+	de_vec3_t point;
+	if (de_ray_triangle_intersection(ray, &t->a, &t->b, &t->c, &point)) {
+		const float sqr_distance = de_vec3_sqr_distance(&point, &ray->origin);
+		if (sqr_distance < *closest) {
+			*closest = sqr_distance;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	(void)argc;
+	(void)argv;
+
+	srand(3);
+	size_t count;
+	triangle_t* triangles = make_triangles(&count);
+	printf("%d triangles\n", (int)count);
+
+	/* Build */
+	double time = de_time_get_seconds();
+	de_octree_t* octree = de_octree_build(triangles, count, sizeof(triangle_t), OCTREE_TRIANGLES_PER_NODE);
+	const double octree_build_time = de_time_get_seconds() - time;
+	time = de_time_get_seconds();
+	de_bvh_t* bvh = de_bvh_build(triangles, count, sizeof(triangle_t), BVH_TRIANGLES_PER_LEAF, NULL);
+	const double bvh_build_time = de_time_get_seconds() - time;
+	de_thread_pool_t* pool = de_thread_pool_create(3);
+	time = de_time_get_seconds();
+	de_bvh_t* parallel_bvh = de_bvh_build(triangles, count, sizeof(triangle_t), BVH_TRIANGLES_PER_LEAF, pool);
+	const double parallel_bvh_build_time = de_time_get_seconds() - time;
+	const bool identical = bvh->node_count == parallel_bvh->node_count &&
+		memcmp(bvh->nodes, parallel_bvh->nodes, bvh->node_count * sizeof(*bvh->nodes)) == 0 &&
+		memcmp(bvh->indices, parallel_bvh->indices, count * sizeof(*bvh->indices)) == 0;
+	printf("build: octree %.3fs, bvh %.3fs, bvh on 4 threads %.3fs (%s)\n", octree_build_time,
+		bvh_build_time, parallel_bvh_build_time, identical ? "identical" : "DIFFERENT");
+	de_bvh_free(parallel_bvh);
+	de_thread_pool_free(pool);
+
+	de_octree_query_t octree_query;
+	de_octree_query_init(&octree_query);
+	de_octree_query_reserve(&octree_query, octree);
+	de_bvh_query_t bvh_query;
+	de_bvh_query_init(&bvh_query);
+	de_bvh_query_reserve(&bvh_query, bvh);
+
+	/* Sphere queries. Octree may list triangle in many nodes, so hits are counted once by marks. */
+	char* marks = calloc(count, 1);
+	long octree_tests = 0, bvh_tests = 0, mismatches = 0;
+	double octree_time = 0.0, bvh_time = 0.0;
+	for (int i = 0; i < SPHERE_QUERY_COUNT; ++i) {
+		const de_vec3_t position = { random_float(TERRAIN_SIZE), random_float(3.0f), random_float(TERRAIN_SIZE) };
+		const float radius = 0.5f;
+
+		time = de_time_get_seconds();
+		de_octree_query_sphere(octree, &octree_query, &position, radius);
+		for (int k = 0; k < octree_query.size; ++k) {
+			const de_octree_node_t* node = octree_query.nodes[k];
+			for (int j = 0; j < node->index_count; ++j) {
+				++octree_tests;
+				if (triangle_touches_sphere(triangles + node->triangle_indices[j], &position, radius)) {
+					marks[node->triangle_indices[j]] = 1;
+				}
+			}
+		}
+		octree_time += de_time_get_seconds() - time;
+
+		time = de_time_get_seconds();
+		de_bvh_query_sphere(bvh, &bvh_query, &position, radius);
+		for (uint32_t k = 0; k < bvh_query.size; ++k) {
+			const de_bvh_node_t* leaf = bvh->nodes + bvh_query.leafs[k];
+			for (uint32_t j = 0; j < leaf->count; ++j) {
+				const uint32_t index = bvh->indices[leaf->offset + j];
+				++bvh_tests;
+				if (triangle_touches_sphere(triangles + index, &position, radius)) {
+					if (marks[index]) {
+						marks[index] = 2;
+					} else {
+						++mismatches;
+					}
+				}
+			}
+		}
+		bvh_time += de_time_get_seconds() - time;
+
+		/* hits found by octree only are left marked with 1 */
+		for (int k = 0; k < octree_query.size; ++k) {
+			const de_octree_node_t* node = octree_query.nodes[k];
+			for (int j = 0; j < node->index_count; ++j) {
+				if (marks[node->triangle_indices[j]] == 1) {
+					++mismatches;
+				}
+				marks[node->triangle_indices[j]] = 0;
+			}
+		}
+	}
+	printf("%d sphere queries: octree %.3fs (%ld triangle tests), bvh %.3fs (%ld triangle tests), %ld mismatches\n",
+		SPHERE_QUERY_COUNT, octree_time, octree_tests, bvh_time, bvh_tests, mismatches);
+
+	/* Ray queries, closest hit */
+	const long sphere_mismatches = mismatches;
+	octree_tests = bvh_tests = mismatches = 0;
+	octree_time = bvh_time = 0.0;
+	for (int i = 0; i < RAY_QUERY_COUNT; ++i) {
+		const de_vec3_t begin = { random_float(TERRAIN_SIZE), 5.0f, random_float(TERRAIN_SIZE) };
+		const de_vec3_t end = { random_float(TERRAIN_SIZE), -1.0f, random_float(TERRAIN_SIZE) };
+		de_ray_t ray;
+		de_ray_by_two_points(&ray, &begin, &end);
+
+		time = de_time_get_seconds();
+		float octree_closest = FLT_MAX;
+		de_octree_query_ray(octree, &octree_query, &ray);
+		for (int k = 0; k < octree_query.size; ++k) {
+			const de_octree_node_t* node = octree_query.nodes[k];
+			for (int j = 0; j < node->index_count; ++j) {
+				++octree_tests;
+				test_ray(triangles + node->triangle_indices[j], &ray, &octree_closest);
+			}
+		}
+		octree_time += de_time_get_seconds() - time;
+
+		time = de_time_get_seconds();
+		float bvh_closest = FLT_MAX;
+		de_bvh_query_ray(bvh, &bvh_query, &ray);
+		for (uint32_t k = 0; k < bvh_query.size; ++k) {
+			const de_bvh_node_t* leaf = bvh->nodes + bvh_query.leafs[k];
+			for (uint32_t j = 0; j < leaf->count; ++j) {
+				++bvh_tests;
+				test_ray(triangles + bvh->indices[leaf->offset + j], &ray, &bvh_closest);
+			}
+		}
+		bvh_time += de_time_get_seconds() - time;
+
+		if (octree_closest != bvh_closest) {
+			++mismatches;
+		}
+	}
+	printf("%d ray queries: octree %.3fs (%ld triangle tests), bvh %.3fs (%ld triangle tests), %ld mismatches\n",
+		RAY_QUERY_COUNT, octree_time, octree_tests, bvh_time, bvh_tests, mismatches);
+
+	/* Cleanup. */
+	free(marks);
+	de_octree_query_free(&octree_query);
+	de_bvh_query_free(&bvh_query);
+	de_octree_free(octree);
+	de_bvh_free(bvh);
+	free(triangles);
+
+	return sphere_mismatches == 0 && mismatches == 0 && identical ? 0 : 1;
+}
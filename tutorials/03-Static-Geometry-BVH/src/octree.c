@@ -19,6 +19,9 @@
 * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.*/
 
+#include "de_main.h"
+#include "octree.h"
+
 typedef struct de_octree_triangle_t {
 	int index;
 	de_vec3_t min;
@@ -46,6 +49,7 @@ static int de_octree_count_leafs(de_octree_t* octree)
 static void de_octree_create_trace_buffers(de_octree_t* octree)
 {
 	int leafCount = de_octree_count_leafs(octree);
+	octree->leaf_count = leafCount;
 	octree->trace_buffer.nodes = (de_octree_node_t **)de_calloc(leafCount, sizeof(*octree->trace_buffer.nodes));
 	octree->trace_buffer.size = 0;
 }
@@ -87,11 +91,17 @@ static void de_octree_split_node(de_octree_node_t* node)
 }
 
 static void de_octree_build_recursive_internal(
+	de_octree_t* octree,
 	de_octree_node_t* node,
 	de_octree_triangle_t* triangles,
 	size_t triangle_count,
-	size_t max_triangles_per_node)
+	size_t max_triangles_per_node,
+	int depth)
 {
+	if (depth > octree->depth) {
+		octree->depth = depth;
+	}
+
 	if (triangle_count < max_triangles_per_node) {
 		node->index_count = triangle_count;
 		if (node->index_count > 0) {
@@ -134,7 +144,7 @@ static void de_octree_build_recursive_internal(
 				}
 			}
 
-			de_octree_build_recursive_internal(child, leaf_triangles.data, leaf_triangles.size, max_triangles_per_node);
+			de_octree_build_recursive_internal(octree, child, leaf_triangles.data, leaf_triangles.size, max_triangles_per_node, depth + 1);
 
 			DE_ARRAY_FREE(leaf_triangles);
 		}
@@ -178,7 +188,7 @@ de_octree_t* de_octree_build(const void* src_triangles, size_t triangle_count, i
 		de_vec3_min_max(v2, &triangle->min, &triangle->max);
 	}
 
-	de_octree_build_recursive_internal(octree->root, triangles, triangle_count, max_triangles_per_node);
+	de_octree_build_recursive_internal(octree, octree->root, triangles, triangle_count, max_triangles_per_node, 0);
 
 	de_octree_create_trace_buffers(octree);
 
@@ -281,3 +291,74 @@ void de_octree_trace_sphere(de_octree_t* octree, const de_vec3_t* position, floa
 	octree->trace_buffer.size = 0;
 	de_octree_trace_sphere_recursive(octree, octree->root, position, radius);
 }
+
+void de_octree_query_init(de_octree_query_t* query)
+{
+	DE_ASSERT(query);
+	memset(query, 0, sizeof(*query));
+}
+
+void de_octree_query_reserve(de_octree_query_t* query, const de_octree_t* octree)
+{
+	DE_ASSERT(query);
+	DE_ASSERT(octree);
+	if (query->capacity < octree->leaf_count) {
+		query->capacity = octree->leaf_count;
+		query->nodes = de_realloc(query->nodes, query->capacity * sizeof(*query->nodes));
+	}
+	/* each level of traversal leaves at most 7 siblings in stack, plus 8 children of last split node */
+	const int stack_capacity = 7 * octree->depth + 8;
+	if (query->stack_capacity < stack_capacity) {
+		query->stack_capacity = stack_capacity;
+		query->stack = de_realloc(query->stack, query->stack_capacity * sizeof(*query->stack));
+	}
+}
+
+void de_octree_query_free(de_octree_query_t* query)
+{
+	DE_ASSERT(query);
+	de_free(query->nodes);
+	de_free(query->stack);
+	de_octree_query_init(query);
+}
+
+void de_octree_query_sphere(const de_octree_t* octree, de_octree_query_t* query, const de_vec3_t* position, float radius)
+{
+	DE_ASSERT(query->capacity >= octree->leaf_count);
+	query->size = 0;
+	int top = 0;
+	query->stack[top++] = octree->root;
+	while (top) {
+		de_octree_node_t* node = query->stack[--top];
+		if (de_octree_node_is_intersect_sphere(node, position, radius)) {
+			if (node->split) {
+				/* push in reverse order to visit children in same order as recursive version */
+				for (int i = 7; i >= 0; --i) {
+					query->stack[top++] = node->children[i];
+				}
+			} else {
+				query->nodes[query->size++] = node;
+			}
+		}
+	}
+}
+
+void de_octree_query_ray(const de_octree_t* octree, de_octree_query_t* query, const de_ray_t* ray)
+{
+	DE_ASSERT(query->capacity >= octree->leaf_count);
+	query->size = 0;
+	int top = 0;
+	query->stack[top++] = octree->root;
+	while (top) {
+		de_octree_node_t* node = query->stack[--top];
+		if (de_ray_aabb_intersection(ray, &node->min, &node->max, NULL, NULL)) {
+			if (node->split) {
+				for (int i = 7; i >= 0; --i) {
+					query->stack[top++] = node->children[i];
+				}
+			} else {
+				query->nodes[query->size++] = node;
+			}
+		}
+	}
+}
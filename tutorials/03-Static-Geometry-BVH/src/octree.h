@@ -36,8 +36,22 @@ typedef struct de_trace_buffer {
 typedef struct de_octree_t {
 	de_trace_buffer trace_buffer;
 	de_octree_node_t* root;
+	int leaf_count; /**< Total count of leafs, max possible count of nodes in query result */
+	int depth;      /**< Max depth of tree, defines size of traversal stack */
 } de_octree_t;
 
+/**
+ * @brief Caller-owned context of octree query. Holds query results and traversal stack, so
+ * any number of threads can query same octree simultaneously using their own contexts.
+ */
+typedef struct de_octree_query_t {
+	de_octree_node_t** nodes; /**< Leafs found by last query */
+	int size;                 /**< Count of leafs found by last query */
+	int capacity;
+	de_octree_node_t** stack; /**< Private. Traversal stack */
+	int stack_capacity;
+} de_octree_query_t;
+
 /**
  * @brief Builds octree using a set of vertices and indices.
  * @param vertices Set of vertices
@@ -54,10 +68,44 @@ void de_octree_free(de_octree_t * octree);
 
 /**
  * @brief Fills trace buffer with octree nodes which intersects with sphere.
+ *
+ * Not thread-safe, trace buffer is shared by all users of octree. Use de_octree_query_sphere
+ * instead.
  */
 void de_octree_trace_sphere(de_octree_t * octree, const de_vec3_t* position, float radius);
 
 /**
  * @brief Fills trace buffer with octree nodes which itersects with ray.
+ *
+ * Not thread-safe, trace buffer is shared by all users of octree. Use de_octree_query_ray
+ * instead.
  */
 void de_octree_trace_ray(de_octree_t * octree, const de_ray_t * ray);
+
+/**
+ * @brief Initializes empty query context.
+ */
+void de_octree_query_init(de_octree_query_t* query);
+
+/**
+ * @brief Makes sure that query context is large enough for any query to octree. Call it once
+ * per octree (not per query), after that queries to this octree will not allocate memory.
+ */
+void de_octree_query_reserve(de_octree_query_t* query, const de_octree_t* octree);
+
+/**
+ * @brief Frees buffers of query context.
+ */
+void de_octree_query_free(de_octree_query_t* query);
+
+/**
+ * @brief Fills query context with leafs which intersects with sphere. Octree is not modified.
+ * Query must be reserved for octree. Result is in the same order as de_octree_trace_sphere gives.
+ */
+void de_octree_query_sphere(const de_octree_t* octree, de_octree_query_t* query, const de_vec3_t* position, float radius);
+
+/**
+ * @brief Fills query context with leafs which intersects with ray. Octree is not modified.
+ * Query must be reserved for octree. Result is in the same order as de_octree_trace_ray gives.
+ */
+void de_octree_query_ray(const de_octree_t* octree, de_octree_query_t* query, const de_ray_t* ray);
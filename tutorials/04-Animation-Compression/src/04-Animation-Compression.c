@@ -0,0 +1,137 @@
+#include "de_main.h"
+
+/* Count of bones of typical humanoid rig (body, head, fingers) */
+#define BONE_COUNT (65)
+#define FRAME_RATE (30.0f)
+#define CLIP_LENGTH (2.0f)
+/* Compressed clip is also compared with interpolated source at this rate */
+#define CHECK_RATE (240.0f)
+
+/* Walk cycle baked the way FBX importer does it: every channel of every bone has key on every
+ * frame, although most of bones only rotate and fingers barely move. */
+static void make_walk_cycle(de_scene_t* scene)
+{
+	de_animation_t* anim = de_animation_create(scene);
+	const int frame_count = (int)(CLIP_LENGTH * FRAME_RATE) + 1;
+	srand(7);
+	for (int bone = 0; bone < BONE_COUNT; ++bone) {
+		de_animation_track_t* track = de_animation_track_create(anim);
+		de_animation_add_track(anim, track);
+		const de_vec3_t offset = { 0.0f, 0.1f + (rand() % 100) / 500.0f, 0.0f };
+		/* fingers (last bones) have small amplitude */
+		const float amplitude = bone < 25 ? 0.2f + (rand() % 100) / 150.0f : 0.05f;
+		const float phase = (rand() % 628) / 100.0f;
+		for (int frame = 0; frame < frame_count; ++frame) {
+			const float time = frame / FRAME_RATE;
+			const float cycle = time / CLIP_LENGTH * 2.0f * (float)M_PI;
+			de_keyframe_t keyframe;
+			keyframe.time = time;
+			keyframe.position = offset;
+			if (bone == 0) {
+				/* hips bob and move forward */
+				keyframe.position.y = 1.0f + 0.03f * (float)sin(2.0f * cycle);
+				keyframe.position.z = 1.4f * time;
+			}
+			de_quat_t swing, twist;
+			const de_vec3_t x_axis = { 1.0f, 0.0f, 0.0f };
+			const de_vec3_t y_axis = { 0.0f, 1.0f, 0.0f };
+			de_quat_from_axis_angle(&swing, &x_axis, amplitude * (float)sin(cycle + phase));
+			de_quat_from_axis_angle(&twist, &y_axis, 0.3f * amplitude * (float)sin(2.0f * cycle + phase));
+			de_quat_mul(&keyframe.rotation, &swing, &twist);
+			keyframe.scale.x = 1.0f;
+			keyframe.scale.y = 1.0f;
+			keyframe.scale.z = 1.0f;
+			de_animation_track_add_keyframe(track, &keyframe);
+		}
+	}
+	de_animation_clamp_length(anim);
+}
+
+/* Angle between rotations, computed in double because acos of float is too coarse near 1. */
+static float rotation_error(const de_quat_t* a, const de_quat_t* b)
+{
+	const double dot = (double)a->x * b->x + (double)a->y * b->y + (double)a->z * b->z + (double)a->w * b->w;
+	const double length_a = sqrt((double)a->x * a->x + (double)a->y * a->y + (double)a->z * a->z + (double)a->w * a->w);
+	const double length_b = sqrt((double)b->x * b->x + (double)b->y * b->y + (double)b->z * b->z + (double)b->w * b->w);
+	const double d = fabs(dot) / (length_a * length_b);
+	return (float)(2.0 * acos(d < 1.0 ? d : 1.0));
+}
+
+int main(int argc, char** argv)
+{
+	/* Fill config using designated initializer. */
+	const de_core_config_t config = {
+		.video_mode = {
+			.width = 800,
+			.height = 600,
+		}
+	};
+
+	/* Initialize core. */
+	de_core_t* core = de_core_init(&config);
+
+	/* Clips are loaded twice, second copy stays uncompressed and is used as reference. */
+	de_scene_t* scene = de_scene_create(core);
+	de_scene_t* reference = de_scene_create(core);
+	if (argc > 1) {
+		if (!de_fbx_load_to_scene(scene, argv[1]) || !de_fbx_load_to_scene(reference, argv[1])) {
+			de_fatal_error("unable to load %s", argv[1]);
+		}
+	} else {
+		printf("no FBX file given, using generated walk cycle of %d bones\n", BONE_COUNT);
+		make_walk_cycle(scene);
+		make_walk_cycle(reference);
+	}
+
+	de_animation_compression_params_t params;
+	de_animation_compression_params_default(&params);
+
+	size_t total_before = 0, total_after = 0;
+	de_animation_t* ref_anim = reference->animations.head;
+	DE_LINKED_LIST_FOR_EACH_T(de_animation_t*, anim, scene->animations)
+	{
+		const size_t before = de_animation_get_keyframes_size_bytes(anim);
+		de_animation_compress(anim, &params);
+		const size_t after = de_animation_get_keyframes_size_bytes(anim);
+		total_before += before;
+		total_after += after;
+
+		/* Error limits are defined at source keys. */
+		float position_error = 0.0f, rotation_error_max = 0.0f, scale_error = 0.0f;
+		for (size_t i = 0; i < anim->tracks.size; ++i) {
+			const de_animation_track_data_t* data = ref_anim->tracks.data[i]->data;
+			for (size_t k = 0; data && k < data->keyframes.size; ++k) {
+				const de_keyframe_t* source = data->keyframes.data + k;
+				de_keyframe_t compressed;
+				de_animation_track_get_keyframe(anim->tracks.data[i], source->time, &compressed);
+				position_error = de_maxf(position_error, de_vec3_distance(&compressed.position, &source->position));
+				rotation_error_max = de_maxf(rotation_error_max, rotation_error(&compressed.rotation, &source->rotation));
+				scale_error = de_maxf(scale_error, de_vec3_distance(&compressed.scale, &source->scale));
+			}
+		}
+		/* Between keys source is interpolated too, so removed keys add a bit of difference. */
+		float rotation_difference = 0.0f;
+		for (float time = 0.0f; time <= anim->length; time += 1.0f / CHECK_RATE) {
+			for (size_t i = 0; i < anim->tracks.size; ++i) {
+				de_keyframe_t compressed, source;
+				de_animation_track_get_keyframe(anim->tracks.data[i], time, &compressed);
+				de_animation_track_get_keyframe(ref_anim->tracks.data[i], time, &source);
+				rotation_difference = de_maxf(rotation_difference, rotation_error(&compressed.rotation, &source.rotation));
+			}
+		}
+		printf("clip of %d tracks, %.2fs: %d -> %d bytes (%.1fx)\n", (int)anim->tracks.size, anim->length,
+			(int)before, (int)after, after ? (double)before / after : 1.0);
+		printf("  max error at keys: position %g, rotation %g, scale %g\n", position_error, rotation_error_max, scale_error);
+		printf("  max rotation difference at %.0f Hz: %g\n", CHECK_RATE, rotation_difference);
+
+		ref_anim = ref_anim->next;
+	}
+	if (total_after) {
+		printf("total: %d -> %d bytes (%.1fx)\n", (int)total_before, (int)total_after, (double)total_before / total_after);
+	}
+
+	/* Cleanup. */
+	de_core_shutdown(core);
+
+	return 0;
+}